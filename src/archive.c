@@ -0,0 +1,287 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2007-2014 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+/**
+ *************************************************************************
+ * @file archive.c
+ *
+ * @brief Streaming tar.gz writer.
+ *
+ * Files are written as ustar members of a gzip stream, reading them
+ * in blocks so memory use does not depend on the file sizes.  Members
+ * that are already gzip compressed are stored at level 0, so they are
+ * not compressed twice.
+ *
+ *************************************************************************
+ */
+
+#include "archive.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define TAR_BLOCK_SIZE      512
+
+/* read buffer, a multiple of TAR_BLOCK_SIZE */
+#define ARCHIVE_BUFFER_SIZE (32 * 1024)
+
+typedef struct
+{
+	char name[ 100 ];
+	char mode[ 8 ];
+	char uid[ 8 ];
+	char gid[ 8 ];
+	char size[ 12 ];
+	char mtime[ 12 ];
+	char chksum[ 8 ];
+	char typeflag;
+	char linkname[ 100 ];
+	char magic[ 6 ];
+	char version[ 2 ];
+	char uname[ 32 ];
+	char gname[ 32 ];
+	char devmajor[ 8 ];
+	char devminor[ 8 ];
+	char prefix[ 155 ];
+	char pad[ 12 ];
+}
+TarHeader_t;
+
+struct _PmLogArchive
+{
+	gzFile  gz;
+	char    buffer[ ARCHIVE_BUFFER_SIZE ];
+};
+
+/**
+ * @brief TarOctal
+ *
+ * Write value as a NUL terminated, zero padded octal number filling the
+ * field.
+ *
+ * @param field
+ * @param size size of the field, including the NUL
+ * @param value
+ */
+static void TarOctal(char *field, size_t size, unsigned long long value)
+{
+	snprintf(field, size, "%0*llo", (int) size - 1, value);
+}
+
+/**
+ * @brief ArchiveWrite
+ *
+ * @param archive
+ * @param data
+ * @param len
+ *
+ * @return true on success
+ */
+static bool ArchiveWrite(PmLogArchive_t *archive, const void *data,
+                         unsigned len)
+{
+	if (gzwrite(archive->gz, data, len) != (int) len)
+	{
+		ErrPrint("%s: gzwrite error: %s\n", __FUNCTION__,
+		         gzerror(archive->gz, NULL));
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief ArchiveOpen
+ *
+ * @param path the tar.gz file to create
+ *
+ * @return the archive, or NULL on error
+ */
+PmLogArchive_t *ArchiveOpen(const char *path)
+{
+	PmLogArchive_t *archive;
+
+	archive = g_new0(PmLogArchive_t, 1);
+	archive->gz = gzopen(path, "wb");
+
+	if (archive->gz == NULL)
+	{
+		ErrPrint("%s: failed to create %s: %s\n", __FUNCTION__, path,
+		         strerror(errno));
+		g_free(archive);
+		return NULL;
+	}
+
+	return archive;
+}
+
+/**
+ * @brief ArchiveAddFile
+ *
+ * Add length bytes of the file from offset as a member.  The file is
+ * read with pread, so the same fd may be used concurrently.  If the
+ * file is shorter than expected, the member is padded with zeros to
+ * keep the archive consistent.
+ *
+ * @param archive
+ * @param name member name, at most 99 characters
+ * @param fd
+ * @param offset
+ * @param length
+ * @param fileStat mode and mtime of the member
+ *
+ * @return true on success
+ */
+bool ArchiveAddFile(PmLogArchive_t *archive, const char *name, int fd,
+                    off_t offset, off_t length, const struct stat *fileStat)
+{
+	TarHeader_t    header;
+	unsigned char *p;
+	unsigned int   chksum = 0;
+	size_t         i;
+	off_t          left;
+	ssize_t        n;
+	size_t         chunk;
+	bool           stored;
+	bool           result = true;
+
+	if (strlen(name) >= sizeof(header.name))
+	{
+		ErrPrint("%s: name too long: %s\n", __FUNCTION__, name);
+		return false;
+	}
+
+	memset(&header, 0, sizeof(header));
+	strncpy(header.name, name, sizeof(header.name) - 1);
+	TarOctal(header.mode, sizeof(header.mode), fileStat->st_mode & 07777);
+	TarOctal(header.uid, sizeof(header.uid), 0);
+	TarOctal(header.gid, sizeof(header.gid), 0);
+	TarOctal(header.size, sizeof(header.size), (unsigned long long) length);
+	TarOctal(header.mtime, sizeof(header.mtime),
+	         (unsigned long long) fileStat->st_mtime);
+	header.typeflag = '0';
+	memcpy(header.magic, "ustar", 6);
+	memcpy(header.version, "00", 2);
+
+	/* the checksum is computed with the field set to spaces */
+	memset(header.chksum, ' ', sizeof(header.chksum));
+
+	for (p = (unsigned char *) &header, i = 0; i < sizeof(header); i++)
+	{
+		chksum += p[ i ];
+	}
+
+	snprintf(header.chksum, sizeof(header.chksum), "%06o", chksum);
+
+	if (!ArchiveWrite(archive, &header, sizeof(header)))
+	{
+		return false;
+	}
+
+	/* don't compress gzip files twice */
+	stored = g_str_has_suffix(name, ".gz");
+
+	if (stored)
+	{
+		(void) gzsetparams(archive->gz, Z_NO_COMPRESSION, Z_DEFAULT_STRATEGY);
+	}
+
+	for (left = length; left > 0; left -= chunk, offset += chunk)
+	{
+		chunk = (size_t) MIN(left, (off_t) sizeof(archive->buffer));
+		n = pread(fd, archive->buffer, chunk, offset);
+
+		if (n < 0)
+		{
+			ErrPrint("%s: read error on %s: %s\n", __FUNCTION__, name,
+			         strerror(errno));
+			n = 0;
+		}
+
+		if ((size_t) n < chunk)
+		{
+			memset(archive->buffer + n, 0, chunk - n);
+		}
+
+		if (!ArchiveWrite(archive, archive->buffer, chunk))
+		{
+			result = false;
+			break;
+		}
+	}
+
+	if (result && (length % TAR_BLOCK_SIZE))
+	{
+		memset(archive->buffer, 0, TAR_BLOCK_SIZE);
+		result = ArchiveWrite(archive, archive->buffer,
+		                      TAR_BLOCK_SIZE - (length % TAR_BLOCK_SIZE));
+	}
+
+	if (stored)
+	{
+		(void) gzsetparams(archive->gz, Z_DEFAULT_COMPRESSION, Z_DEFAULT_STRATEGY);
+	}
+
+	return result;
+}
+
+/**
+ * @brief ArchiveClose
+ *
+ * Write the end of archive marker and close the archive.
+ *
+ * @param archive
+ * @param sizeP set to the compressed size of the archive, may be NULL
+ *
+ * @return true if the archive is complete
+ */
+bool ArchiveClose(PmLogArchive_t *archive, off_t *sizeP)
+{
+	bool result;
+
+	if (archive == NULL)
+	{
+		return false;
+	}
+
+	/* two zero blocks mark the end of the archive */
+	memset(archive->buffer, 0, 2 * TAR_BLOCK_SIZE);
+	result = ArchiveWrite(archive, archive->buffer, 2 * TAR_BLOCK_SIZE);
+
+	if (gzflush(archive->gz, Z_FINISH) != Z_OK)
+	{
+		result = false;
+	}
+
+	if (sizeP)
+	{
+		*sizeP = (off_t) gzoffset(archive->gz);
+	}
+
+	if (gzclose(archive->gz) != Z_OK)
+	{
+		result = false;
+	}
+
+	g_free(archive);
+
+	return result;
+}
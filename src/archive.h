@@ -0,0 +1,46 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2007-2014 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+/**
+ ***********************************************************************
+ * @file archive.h
+ *
+ * @brief This file contains definition of the streaming tar.gz writer
+ * used to back up the logs.
+ *
+ ***********************************************************************
+ */
+
+
+#ifndef PMLOGDAEMON_ARCHIVE_H
+#define PMLOGDAEMON_ARCHIVE_H
+
+#include <stdbool.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <glib.h>
+#include "print.h"
+
+typedef struct _PmLogArchive PmLogArchive_t;
+
+PmLogArchive_t *ArchiveOpen(const char *path);
+bool ArchiveAddFile(PmLogArchive_t *archive, const char *name, int fd,
+                    off_t offset, off_t length, const struct stat *fileStat);
+bool ArchiveClose(PmLogArchive_t *archive, off_t *sizeP);
+
+#endif
@@ -0,0 +1,81 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2007-2014 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+/**
+ ***********************************************************************
+ * @file binmsg.h
+ *
+ * @brief This file contains definition of the binary messages PmLogLib
+ * may send instead of text, with the fields it already knows.
+ *
+ * A binary message starts with PMLOG_BIN_MAGIC, which text messages
+ * can't as they don't contain NUL characters.  It is sent as a datagram
+ * to /dev/log, or as a record of a shared memory ring.
+ *
+ * The header is followed by these fields, each a guint16 length then as
+ * many bytes, not NUL terminated:
+ *  - program name
+ *  - context name, always set: contextId only saves looking it up
+ *  - msgid
+ *  - message: key-value pairs and free text, as in text messages
+ *
+ * Context ids are looked up in the level page (see levelpage.h): they
+ * are valid as long as its epoch is.  A message with an outdated id,
+ * e.g. after the daemon restarted, is logged in the context it names.
+ *
+ * Integers are in host order.
+ *
+ ***********************************************************************
+ */
+
+
+#ifndef PMLOGDAEMON_BINMSG_H
+#define PMLOGDAEMON_BINMSG_H
+
+#include <glib.h>
+
+#define PMLOG_BIN_MAGIC         "\0PMB"
+#define PMLOG_BIN_MAGIC_LEN     4
+
+#define PMLOG_BIN_VERSION       1
+
+/* flags */
+#define PMLOG_BIN_HAS_PID       0x01
+#define PMLOG_BIN_HAS_TID       0x02
+
+#define PMLOG_BIN_NUM_FIELDS    4
+
+typedef struct
+{
+	char    magic[ PMLOG_BIN_MAGIC_LEN ];
+	guint8  version;
+	guint8  flags;
+
+	/* facility and level, as in "<pri>" */
+	guint16 pri;
+
+	guint32 pid;
+	guint32 tid;
+
+	/* from the level page, 0 if the context is named */
+	guint32 contextEpoch;
+	guint32 contextId;
+}
+PmLogBinHeader_t;
+
+#endif
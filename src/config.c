@@ -49,6 +49,17 @@ PmLogFile_t     g_outputConfs[ PMLOG_MAX_NUM_OUTPUTS ];
 int             g_numContexts;
 GTree           *g_contextConfs = NULL;
 
+int             g_rbPoolBudget;
+int             g_rbPoolChunkSize;
+
+GHashTable      *g_rdxBlacklist = NULL;
+int             g_rdxDedupWindow = RDX_DEFAULT_DEDUP_WINDOW;
+int             g_rdxReportsPerHour = RDX_DEFAULT_REPORTS_PER_HOUR;
+int             g_rdxContextLines = RDX_DEFAULT_CONTEXT_LINES;
+
+int             g_receiveBufferMin = RECEIVE_BUFFER_DEFAULT_MIN;
+int             g_receiveBufferMax = RECEIVE_BUFFER_DEFAULT_MAX;
+
 /***********************************************************************
  * OUTPUT section parsing
 
@@ -364,7 +375,9 @@ typedef struct
 	char              name[ PMLOG_MAX_CONTEXT_NAME_LEN + 1 ];
 	int               numRules;
 	int               bufferSize;
+	int               bufferMinSize;
 	int               flushLevel;
+	bool              compressBuffer;
 	PmLogParseRule_t  rules[ PMLOG_CONTEXT_MAX_NUM_RULES ];
 }
 PmLogParseContext_t;
@@ -511,6 +524,33 @@ static bool ParseContextData(
 }
 
 
+/**
+ * @brief DestroyContextConf
+ *
+ * Value destroy function for g_contextConfs.
+ *
+ * @param data the PmLogContextConf_t to free
+ */
+void DestroyContextConf(gpointer data)
+{
+	PmLogContextConf_t *contextConfP = data;
+	int                 i;
+
+	for (i = 0; i < PMLOG_CONTEXT_MAX_NUM_RULES; i++)
+	{
+		g_free(contextConfP->rules[ i ].program);
+	}
+
+	if (contextConfP->override.expireSource)
+	{
+		g_source_remove(contextConfP->override.expireSource);
+	}
+
+	RBFree(contextConfP->rb);
+	g_free(contextConfP);
+}
+
+
 static PmLogContextConf_t *CreateContext(const char *name)
 {
 	PmLogContextConf_t     *contextConfP;
@@ -526,7 +566,8 @@ static PmLogContextConf_t *CreateContext(const char *name)
 	// if SetDefaultConf() is called, ClearConf() will release g_contextConfs.
 	if (!g_contextConfs)
 	{
-		g_contextConfs = g_tree_new_full(char_array_comp_func, NULL, g_free, free);
+		g_contextConfs = g_tree_new_full(char_array_comp_func, NULL, g_free,
+		                                 DestroyContextConf);
 	}
 
 	contextConfP->contextName = gName;
@@ -590,7 +631,10 @@ static bool MakeContextConf(PmLogParseContext_t *parseContextP)
 	}
 
 	/* copy buffer info */
-	contextConfP->rb = RBNew(parseContextP->bufferSize, parseContextP->flushLevel);
+	RBFree(contextConfP->rb);
+	contextConfP->rb = RBNew(parseContextP->bufferSize,
+	                         parseContextP->bufferMinSize, parseContextP->flushLevel,
+	                         parseContextP->compressBuffer);
 
 	return true;
 }
@@ -852,6 +896,7 @@ bool ParseJsonContexts(const char *file_name)
 				jvalue_ref  value;
 				raw_buffer  name;
 				int         buffer = 1;
+				bool        compress = false;
 				raw_buffer  flush;
 
 				memset(&name, 0x00, sizeof(name));
@@ -1009,6 +1054,22 @@ bool ParseJsonContexts(const char *file_name)
 						}
 					} // no else, It is a optional field.
 
+					optional_ret = jobject_get_exists(context, j_cstr_to_buffer("bufferMinSize"),
+					                                  &value);
+
+					if (optional_ret)   // found bufferMinSize
+					{
+						if (jnumber_get_i32(value, &buffer) != CONV_OK)
+						{
+							DbgPrint("jstring_get() failed for context %d in configuration file %s for bufferMinSize\n",
+							         contextsIter, file_name);
+						}
+						else
+						{
+							parseContext.bufferMinSize = buffer * 1024;
+						}
+					} // no else, It is a optional field.
+
 					optional_ret = jobject_get_exists(context, j_cstr_to_buffer("flushLevel"),
 					                                  &value);
 
@@ -1030,6 +1091,22 @@ bool ParseJsonContexts(const char *file_name)
 						}
 					}
 
+					optional_ret = jobject_get_exists(context, j_cstr_to_buffer("compressBuffer"),
+					                                  &value);
+
+					if (optional_ret)   // found compressBuffer
+					{
+						if (jboolean_get(value, &compress) != CONV_OK)
+						{
+							DbgPrint("jboolean_get() failed for context %d in configuration file %s for compressBuffer\n",
+							         contextsIter, file_name);
+						}
+						else
+						{
+							parseContext.compressBuffer = compress;
+						}
+					} // no else, It is a optional field.
+
 					/* create new PmLogContextConf_t object */
 					if (ret)
 					{
@@ -1073,6 +1150,242 @@ bool ParseJsonContexts(const char *file_name)
 	return ret;
 }
 
+/**
+ * @brief ParseJsonBufferPool
+ * Parse the value of "bufferPool" which is represented in configuration
+ * file.  It is optional; a later file overrides an earlier one.
+ *
+ *     "bufferPool" : { "size" : 512, "chunkSize" : 4 }
+ *
+ * size is the global budget in KB for all context ring buffers (0 for
+ * unlimited), chunkSize is the KB drawn by a ring buffer at a time.
+ *
+ * @param file_name file name for configuration file.
+ */
+bool ParseJsonBufferPool(const char *file_name)
+{
+	jvalue_ref           pool;
+	jvalue_ref           value;
+	jvalue_ref           parsed;
+	JSchemaInfo          schemainfo;
+	int                  size;
+
+	jschema_info_init(&schemainfo, jschema_all(), NULL, NULL);
+	parsed = jdom_parse_file(file_name, &schemainfo, DOMOPT_INPUT_NOCHANGE);
+
+	if (jis_null(parsed))
+	{
+		DbgPrint("unable to parse %s\n", file_name);
+		j_release(&parsed);
+		return false;
+	}
+
+	if (jobject_get_exists(parsed, j_cstr_to_buffer("bufferPool"), &pool))
+	{
+		if (jobject_get_exists(pool, j_cstr_to_buffer("size"), &value))
+		{
+			if (jnumber_get_i32(value, &size) != CONV_OK)
+			{
+				DbgPrint("jnumber_get_i32() failed in configuration file %s for bufferPool size\n",
+				         file_name);
+			}
+			else
+			{
+				g_rbPoolBudget = size * 1024; // Kilobytes
+			}
+		}
+
+		if (jobject_get_exists(pool, j_cstr_to_buffer("chunkSize"), &value))
+		{
+			if (jnumber_get_i32(value, &size) != CONV_OK)
+			{
+				DbgPrint("jnumber_get_i32() failed in configuration file %s for bufferPool chunkSize\n",
+				         file_name);
+			}
+			else
+			{
+				g_rbPoolChunkSize = size * 1024; // Kilobytes
+			}
+		}
+	}
+
+	j_release(&parsed);
+
+	return true;
+}
+
+/**
+ * @brief ParseJsonRdxReporting
+ * Parse the value of "rdxReporting" which is represented in configuration
+ * file.  It is optional; a later file overrides an earlier one.
+ *
+ *     "rdxReporting" : {
+ *         "blacklist" : [ "rdxd", "uploadd", "pmsyslogd", "upstart" ],
+ *         "dedupWindow" : 600,
+ *         "reportsPerHour" : 10,
+ *         "contextLines" : 20
+ *     }
+ *
+ * blacklist lists the programs never reported.  A message is reported
+ * once per dedupWindow seconds, and at most reportsPerHour reports are
+ * made.  Each report includes the last contextLines messages.
+ *
+ * @param file_name file name for configuration file.
+ */
+bool ParseJsonRdxReporting(const char *file_name)
+{
+	jvalue_ref           rdx;
+	jvalue_ref           value;
+	jvalue_ref           parsed;
+	JSchemaInfo          schemainfo;
+	raw_buffer           program;
+	int                  n;
+	int                  i;
+
+	jschema_info_init(&schemainfo, jschema_all(), NULL, NULL);
+	parsed = jdom_parse_file(file_name, &schemainfo, DOMOPT_INPUT_NOCHANGE);
+
+	if (jis_null(parsed))
+	{
+		DbgPrint("unable to parse %s\n", file_name);
+		j_release(&parsed);
+		return false;
+	}
+
+	if (jobject_get_exists(parsed, j_cstr_to_buffer("rdxReporting"), &rdx))
+	{
+		if (jobject_get_exists(rdx, j_cstr_to_buffer("blacklist"), &value))
+		{
+			if (g_rdxBlacklist)
+			{
+				g_hash_table_destroy(g_rdxBlacklist);
+			}
+
+			g_rdxBlacklist = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			                                       NULL);
+
+			for (i = 0; i < jarray_size(value); i++)
+			{
+				program = jstring_get_fast(jarray_get(value, i));
+
+				if (program.m_str)
+				{
+					g_hash_table_add(g_rdxBlacklist,
+					                 g_strndup(program.m_str, program.m_len));
+				}
+			}
+		}
+
+		if (jobject_get_exists(rdx, j_cstr_to_buffer("dedupWindow"), &value))
+		{
+			if (jnumber_get_i32(value, &n) != CONV_OK)
+			{
+				DbgPrint("jnumber_get_i32() failed in configuration file %s for rdxReporting dedupWindow\n",
+				         file_name);
+			}
+			else
+			{
+				g_rdxDedupWindow = MAX(n, 0);
+			}
+		}
+
+		if (jobject_get_exists(rdx, j_cstr_to_buffer("reportsPerHour"), &value))
+		{
+			if (jnumber_get_i32(value, &n) != CONV_OK)
+			{
+				DbgPrint("jnumber_get_i32() failed in configuration file %s for rdxReporting reportsPerHour\n",
+				         file_name);
+			}
+			else
+			{
+				g_rdxReportsPerHour = MAX(n, 0);
+			}
+		}
+
+		if (jobject_get_exists(rdx, j_cstr_to_buffer("contextLines"), &value))
+		{
+			if (jnumber_get_i32(value, &n) != CONV_OK)
+			{
+				DbgPrint("jnumber_get_i32() failed in configuration file %s for rdxReporting contextLines\n",
+				         file_name);
+			}
+			else
+			{
+				g_rdxContextLines = MAX(n, 0);
+			}
+		}
+	}
+
+	j_release(&parsed);
+
+	return true;
+}
+
+/**
+ * @brief ParseJsonReceiveBuffer
+ * Parse the value of "receiveBuffer" which is represented in configuration
+ * file.  It is optional; a later file overrides an earlier one.
+ *
+ *     "receiveBuffer" : { "min" : 256, "max" : 4096 }
+ *
+ * The receive buffer of the log socket grows with the bursts and the
+ * drops seen, and shrinks when they are small, between min and max KB.
+ * A max of 0 leaves the buffer alone.
+ *
+ * @param file_name file name for configuration file.
+ */
+bool ParseJsonReceiveBuffer(const char *file_name)
+{
+	jvalue_ref           buffer;
+	jvalue_ref           value;
+	jvalue_ref           parsed;
+	JSchemaInfo          schemainfo;
+	int                  size;
+
+	jschema_info_init(&schemainfo, jschema_all(), NULL, NULL);
+	parsed = jdom_parse_file(file_name, &schemainfo, DOMOPT_INPUT_NOCHANGE);
+
+	if (jis_null(parsed))
+	{
+		DbgPrint("unable to parse %s\n", file_name);
+		j_release(&parsed);
+		return false;
+	}
+
+	if (jobject_get_exists(parsed, j_cstr_to_buffer("receiveBuffer"), &buffer))
+	{
+		if (jobject_get_exists(buffer, j_cstr_to_buffer("min"), &value))
+		{
+			if (jnumber_get_i32(value, &size) != CONV_OK)
+			{
+				DbgPrint("jnumber_get_i32() failed in configuration file %s for receiveBuffer min\n",
+				         file_name);
+			}
+			else
+			{
+				g_receiveBufferMin = MAX(size, 0) * 1024; // Kilobytes
+			}
+		}
+
+		if (jobject_get_exists(buffer, j_cstr_to_buffer("max"), &value))
+		{
+			if (jnumber_get_i32(value, &size) != CONV_OK)
+			{
+				DbgPrint("jnumber_get_i32() failed in configuration file %s for receiveBuffer max\n",
+				         file_name);
+			}
+			else
+			{
+				g_receiveBufferMax = MAX(size, 0) * 1024; // Kilobytes
+			}
+		}
+	}
+
+	j_release(&parsed);
+
+	return true;
+}
+
 /**
  * @brief SetDefaultConf
  */
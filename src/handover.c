@@ -0,0 +1,479 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2007-2014 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+/**
+ *************************************************************************
+ * @file handover.c
+ *
+ * @brief Both sides of the handover to a new instance.
+ *
+ * Sends time out, so that a new instance hanging doesn't keep the
+ * daemon from exiting; what could not be sent is then written to the
+ * outputs by the daemon.
+ *
+ *************************************************************************
+ */
+
+#define _GNU_SOURCE
+
+#include "handover.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/* how long a send may block, in ms */
+#define HANDOVER_SEND_TIMEOUT   5000
+
+/* how long the new instance waits for the sockets, in ms */
+#define HANDOVER_HELLO_TIMEOUT  5000
+
+/* ring buffer records are shorter than 64K */
+#define HANDOVER_MAX_MESSAGE    (sizeof(PmLogHandoverRecord_t) + 3 * G_MAXUINT16)
+
+/**
+ * @brief HandoverAddress
+ *
+ * @param path
+ * @param sunx
+ */
+static void HandoverAddress(const char *path, struct sockaddr_un *sunx)
+{
+	memset(sunx, 0, sizeof(*sunx));
+	sunx->sun_family = AF_UNIX;
+	(void) strncpy(sunx->sun_path, path, sizeof(sunx->sun_path) - 1);
+}
+
+/**
+ * @brief HandoverPeerTrusted
+ *
+ * @param fd connected socket
+ *
+ * @return true if the peer runs as our user
+ */
+static bool HandoverPeerTrusted(int fd)
+{
+	struct ucred    cred;
+	socklen_t       len = sizeof(cred);
+
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0)
+	{
+		ErrPrint("%s: getsockopt error: %s\n", __FUNCTION__, strerror(errno));
+		return false;
+	}
+
+	if (cred.uid != geteuid())
+	{
+		ErrPrint("%s: rejecting pid %d of uid %d\n", __FUNCTION__, (int) cred.pid,
+		         (int) cred.uid);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief HandoverWait
+ *
+ * @param fd
+ * @param timeoutMs
+ *
+ * @return true if fd is readable before the timeout
+ */
+static bool HandoverWait(int fd, int timeoutMs)
+{
+	struct pollfd   pfd = { fd, POLLIN, 0 };
+	int             n;
+
+	do
+	{
+		n = poll(&pfd, 1, timeoutMs);
+	}
+	while ((n < 0) && (errno == EINTR));
+
+	return (n > 0);
+}
+
+/**
+ * @brief HandoverListen
+ *
+ * @param path
+ *
+ * @return the listening socket, -1 on failure
+ */
+int HandoverListen(const char *path)
+{
+	struct sockaddr_un  sunx;
+	int                 fd;
+
+	HandoverAddress(path, &sunx);
+	(void) unlink(path);
+
+	fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+
+	if (fd < 0)
+	{
+		ErrPrint("%s: socket error: %s\n", __FUNCTION__, strerror(errno));
+		return -1;
+	}
+
+	if ((bind(fd, (struct sockaddr *) &sunx, sizeof(sunx)) < 0) ||
+	        (chmod(path, 0600) < 0) || (listen(fd, 1) < 0))
+	{
+		ErrPrint("%s: error: %s\n", __FUNCTION__, strerror(errno));
+		close(fd);
+		(void) unlink(path);
+		return -1;
+	}
+
+	return fd;
+}
+
+/**
+ * @brief HandoverAccept
+ *
+ * @param listenFd
+ *
+ * @return the connection of a new instance, -1 if none or not trusted
+ */
+int HandoverAccept(int listenFd)
+{
+	struct timeval  timeout = { HANDOVER_SEND_TIMEOUT / 1000, 0 };
+	int             fd;
+
+	fd = accept4(listenFd, NULL, NULL, SOCK_CLOEXEC);
+
+	if (fd < 0)
+	{
+		ErrPrint("%s: accept error: %s\n", __FUNCTION__, strerror(errno));
+		return -1;
+	}
+
+	if (!HandoverPeerTrusted(fd))
+	{
+		close(fd);
+		return -1;
+	}
+
+	(void) setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+	return fd;
+}
+
+/**
+ * @brief HandoverSendFds
+ *
+ * @param connFd
+ * @param fds PMLOG_HANDOVER_NUM_FDS sockets, -1 if missing
+ *
+ * @return true on success
+ */
+bool HandoverSendFds(int connFd, const int *fds)
+{
+	PmLogHandoverHello_t    hello;
+	char                    control[ CMSG_SPACE(PMLOG_HANDOVER_NUM_FDS * sizeof(int)) ];
+	struct msghdr           msg;
+	struct iovec            iov;
+	struct cmsghdr         *cmsg;
+	int                     passed[ PMLOG_HANDOVER_NUM_FDS ];
+	int                     numPassed = 0;
+	int                     i;
+
+	memset(&hello, 0, sizeof(hello));
+	hello.magic = PMLOG_HANDOVER_MAGIC;
+	hello.version = PMLOG_HANDOVER_VERSION;
+
+	for (i = 0; i < PMLOG_HANDOVER_NUM_FDS; i++)
+	{
+		if (fds[ i ] >= 0)
+		{
+			hello.fdMask |= 1U << i;
+			passed[ numPassed++ ] = fds[ i ];
+		}
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = &hello;
+	iov.iov_len = sizeof(hello);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	if (numPassed > 0)
+	{
+		memset(control, 0, sizeof(control));
+		msg.msg_control = control;
+		msg.msg_controllen = CMSG_SPACE(numPassed * sizeof(int));
+
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(numPassed * sizeof(int));
+		memcpy(CMSG_DATA(cmsg), passed, numPassed * sizeof(int));
+	}
+
+	if (sendmsg(connFd, &msg, MSG_NOSIGNAL) != (ssize_t) sizeof(hello))
+	{
+		ErrPrint("%s: sendmsg error: %s\n", __FUNCTION__, strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief HandoverSendRecord
+ *
+ * @param connFd
+ * @param contextName
+ * @param time
+ * @param pri
+ * @param programName
+ * @param msg
+ *
+ * @return true on success
+ */
+bool HandoverSendRecord(int connFd, const char *contextName, gint64 time,
+                        int pri, const char *programName, const char *msg)
+{
+	PmLogHandoverRecord_t   rec;
+	struct msghdr           hdr;
+	struct iovec            iov[ 4 ];
+	size_t                  msgLen = strlen(msg);
+	ssize_t                 total;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.time = time;
+	rec.pri = pri;
+	rec.contextLen = (guint16) MIN(strlen(contextName), G_MAXUINT16);
+	rec.programLen = (guint16) MIN(strlen(programName), G_MAXUINT16);
+	msgLen = MIN(msgLen, G_MAXUINT16);
+
+	iov[ 0 ].iov_base = &rec;
+	iov[ 0 ].iov_len = sizeof(rec);
+	iov[ 1 ].iov_base = (void *) contextName;
+	iov[ 1 ].iov_len = rec.contextLen;
+	iov[ 2 ].iov_base = (void *) programName;
+	iov[ 2 ].iov_len = rec.programLen;
+	iov[ 3 ].iov_base = (void *) msg;
+	iov[ 3 ].iov_len = msgLen;
+	total = (ssize_t)(sizeof(rec) + rec.contextLen + rec.programLen + msgLen);
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.msg_iov = iov;
+	hdr.msg_iovlen = 4;
+
+	if (sendmsg(connFd, &hdr, MSG_NOSIGNAL) != total)
+	{
+		ErrPrint("%s: sendmsg error: %s\n", __FUNCTION__, strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief HandoverConnect
+ *
+ * Ask the running daemon to hand over, and get its sockets.
+ *
+ * @param path
+ * @param fds set to the PMLOG_HANDOVER_NUM_FDS sockets, -1 if missing
+ *
+ * @return the connection to pass to HandoverReceive, -1 if there was
+ * nothing to take over
+ */
+int HandoverConnect(const char *path, int *fds)
+{
+	PmLogHandoverHello_t    hello;
+	struct sockaddr_un      sunx;
+	char                    control[ CMSG_SPACE(PMLOG_HANDOVER_NUM_FDS * sizeof(int)) ];
+	int                     passed[ PMLOG_HANDOVER_NUM_FDS ];
+	struct msghdr           msg;
+	struct iovec            iov;
+	struct cmsghdr         *cmsg;
+	ssize_t                 bytes;
+	int                     numPassed = 0;
+	int                     next = 0;
+	int                     fd;
+	int                     i;
+
+	for (i = 0; i < PMLOG_HANDOVER_NUM_FDS; i++)
+	{
+		fds[ i ] = -1;
+	}
+
+	HandoverAddress(path, &sunx);
+
+	fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+
+	if (fd < 0)
+	{
+		ErrPrint("%s: socket error: %s\n", __FUNCTION__, strerror(errno));
+		return -1;
+	}
+
+	if (connect(fd, (struct sockaddr *) &sunx, sizeof(sunx)) < 0)
+	{
+		DbgPrint("%s: no daemon to take over from: %s\n", __FUNCTION__, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	if (!HandoverPeerTrusted(fd) || !HandoverWait(fd, HANDOVER_HELLO_TIMEOUT))
+	{
+		close(fd);
+		return -1;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = &hello;
+	iov.iov_len = sizeof(hello);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	bytes = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+	{
+		if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_RIGHTS))
+		{
+			numPassed = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+			memcpy(passed, CMSG_DATA(cmsg), numPassed * sizeof(int));
+		}
+	}
+
+	if ((bytes != (ssize_t) sizeof(hello)) || (msg.msg_flags & MSG_CTRUNC) ||
+	        (hello.magic != PMLOG_HANDOVER_MAGIC) ||
+	        (hello.version != PMLOG_HANDOVER_VERSION))
+	{
+		ErrPrint("%s: bad handover from the daemon\n", __FUNCTION__);
+
+		for (i = 0; i < numPassed; i++)
+		{
+			close(passed[ i ]);
+		}
+
+		close(fd);
+		return -1;
+	}
+
+	for (i = 0; (i < PMLOG_HANDOVER_NUM_FDS) && (next < numPassed); i++)
+	{
+		if (hello.fdMask & (1U << i))
+		{
+			fds[ i ] = passed[ next++ ];
+		}
+	}
+
+	/* more than announced */
+	for (; next < numPassed; next++)
+	{
+		close(passed[ next ]);
+	}
+
+	return fd;
+}
+
+/**
+ * @brief HandoverReceive
+ *
+ * Pass the records of the ring buffers to func, until the daemon exits.
+ *
+ * @param connFd from HandoverConnect, left open
+ * @param timeoutMs how long the daemon may take to exit
+ * @param func
+ * @param data
+ *
+ * @return false if the daemon didn't exit in time
+ */
+bool HandoverReceive(int connFd, int timeoutMs, HandoverRecordFunc func,
+                     gpointer data)
+{
+	PmLogHandoverRecord_t   rec;
+	gint64                  deadline;
+	gint64                  left;
+	char                   *buff = g_malloc(HANDOVER_MAX_MESSAGE + 1);
+	gchar                  *contextName;
+	gchar                  *programName;
+	const char             *msg;
+	ssize_t                 bytes;
+	gsize                   msgLen;
+	bool                    done = false;
+
+	deadline = g_get_monotonic_time() + (gint64) timeoutMs * 1000;
+
+	for (;;)
+	{
+		left = (deadline - g_get_monotonic_time()) / 1000;
+
+		if ((left <= 0) || !HandoverWait(connFd, (int) left))
+		{
+			ErrPrint("%s: daemon did not exit in time\n", __FUNCTION__);
+			break;
+		}
+
+		bytes = recv(connFd, buff, HANDOVER_MAX_MESSAGE, MSG_TRUNC);
+
+		if ((bytes < 0) && (errno == EINTR))
+		{
+			continue;
+		}
+
+		if (bytes <= 0)
+		{
+			/* closed as the daemon exited */
+			done = true;
+			break;
+		}
+
+		if (bytes < (ssize_t) sizeof(rec))
+		{
+			continue;
+		}
+
+		memcpy(&rec, buff, sizeof(rec));
+
+		if (((gsize) bytes > HANDOVER_MAX_MESSAGE) ||
+		        (sizeof(rec) + rec.contextLen + rec.programLen > (gsize) bytes))
+		{
+			continue;
+		}
+
+		msg = buff + sizeof(rec) + rec.contextLen + rec.programLen;
+		msgLen = (gsize) bytes - sizeof(rec) - rec.contextLen - rec.programLen;
+		buff[ bytes ] = '\0';
+
+		contextName = g_strndup(buff + sizeof(rec), rec.contextLen);
+		programName = g_strndup(buff + sizeof(rec) + rec.contextLen, rec.programLen);
+
+		func(contextName, rec.time, rec.pri, programName, msg, (int) msgLen, data);
+
+		g_free(contextName);
+		g_free(programName);
+	}
+
+	g_free(buff);
+
+	return done;
+}
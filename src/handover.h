@@ -0,0 +1,103 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2007-2014 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+/**
+ ***********************************************************************
+ * @file handover.h
+ *
+ * @brief This file contains definition of the handover of a running
+ * daemon to a new instance taking over from it, e.g. on upgrades.
+ *
+ * The daemon listens on PMLOG_HANDOVER_SOCKET_PATH (SOCK_SEQPACKET),
+ * for processes of its own user only.  A new instance connects and
+ * receives, in this order:
+ *  - one message carrying a PmLogHandoverHello_t and, as SCM_RIGHTS,
+ *    the sockets it should read instead of binding its own, sent as
+ *    soon as the daemon accepts the connection
+ *  - one message per record of the ring buffers: a
+ *    PmLogHandoverRecord_t followed by the context name, the program
+ *    name and the message, not NUL terminated
+ *
+ * The connection is closed once the daemon has written everything it
+ * read and exited: the new instance then reads what is left in the
+ * sockets, which were never unbound meanwhile.  Once it has the
+ * sockets, the new instance waits for the daemon to exit however long
+ * it takes, since nobody else will read them.
+ *
+ * Integers are in host order.
+ *
+ ***********************************************************************
+ */
+
+
+#ifndef PMLOGDAEMON_HANDOVER_H
+#define PMLOGDAEMON_HANDOVER_H
+
+#include <stdbool.h>
+#include <glib.h>
+#include "print.h"
+
+#define PMLOG_HANDOVER_SOCKET_PATH  "/var/run/pmlogd-handover"
+
+#define PMLOG_HANDOVER_MAGIC        0x484c4d50      /* "PMLH" */
+#define PMLOG_HANDOVER_VERSION      1
+
+/* sockets handed over, -1 for those the daemon didn't have */
+typedef enum
+{
+	PMLOG_HANDOVER_FD_LOG,          /* /dev/log */
+	PMLOG_HANDOVER_FD_SHM,          /* see shmring.h */
+	PMLOG_HANDOVER_NUM_FDS
+} PmLogHandoverFd_t;
+
+typedef struct
+{
+	guint32 magic;
+	guint32 version;
+
+	/* bit i set if fd i of PmLogHandoverFd_t is passed */
+	guint32 fdMask;
+}
+PmLogHandoverHello_t;
+
+typedef struct
+{
+	/* microseconds since the epoch, as in ring buffers */
+	gint64  time;
+	gint32  pri;
+
+	guint16 contextLen;
+	guint16 programLen;
+}
+PmLogHandoverRecord_t;
+
+typedef void (*HandoverRecordFunc)(const char *contextName, gint64 time,
+                                   int pri, const char *programName,
+                                   const char *msg, int msgLen, gpointer data);
+
+int HandoverListen(const char *path);
+int HandoverAccept(int listenFd);
+bool HandoverSendFds(int connFd, const int *fds);
+bool HandoverSendRecord(int connFd, const char *contextName, gint64 time,
+                        int pri, const char *programName, const char *msg);
+
+int HandoverConnect(const char *path, int *fds);
+bool HandoverReceive(int connFd, int timeoutMs, HandoverRecordFunc func,
+                     gpointer data);
+
+#endif
@@ -0,0 +1,250 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2007-2014 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+/**
+ *************************************************************************
+ * @file levelpage.c
+ *
+ * @brief Daemon side of the level page.
+ *
+ * The page is a file on tmpfs, writable by the daemon only.  It is
+ * updated in place while the entries fit, else a larger file is written
+ * and renamed over it, and the old one is marked replaced.
+ *
+ *************************************************************************
+ */
+
+#include "levelpage.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+struct _PmLogLevelPage
+{
+	gchar                  *path;
+	PmLogLevelPageHeader_t *header;
+	PmLogLevelEntry_t      *entries;
+	gsize                   mapLen;
+	guint32                 epoch;
+};
+
+/**
+ * @brief LevelPageUnmap
+ *
+ * Tell the clients of the current file to map it again, and unmap it.
+ *
+ * @param page
+ */
+static void LevelPageUnmap(PmLogLevelPage_t *page)
+{
+	if (page->header)
+	{
+		g_atomic_int_set(&page->header->replaced, 1);
+		(void) munmap(page->header, page->mapLen);
+		page->header = NULL;
+		page->entries = NULL;
+	}
+}
+
+/**
+ * @brief LevelPageWrite
+ *
+ * @param page
+ * @param entries
+ * @param numEntries
+ * @param defaultLevel
+ */
+static void LevelPageWrite(PmLogLevelPage_t *page, const PmLogLevelEntry_t *entries,
+                           int numEntries, int defaultLevel)
+{
+	PmLogLevelPageHeader_t *header = page->header;
+
+	/* odd: readers retry */
+	g_atomic_int_inc(&header->generation);
+
+	memcpy(page->entries, entries, (gsize) numEntries * sizeof(PmLogLevelEntry_t));
+	header->numEntries = numEntries;
+	header->defaultLevel = defaultLevel;
+
+	g_atomic_int_inc(&header->generation);
+}
+
+/**
+ * @brief LevelPageReplace
+ *
+ * Write the entries to a new file large enough and rename it over the
+ * current one.
+ *
+ * @param page
+ * @param entries
+ * @param numEntries
+ * @param defaultLevel
+ *
+ * @return true on success
+ */
+static bool LevelPageReplace(PmLogLevelPage_t *page, const PmLogLevelEntry_t *entries,
+                             int numEntries, int defaultLevel)
+{
+	PmLogLevelPageHeader_t *header;
+	gchar                  *tmpPath = g_strdup_printf("%s.tmp", page->path);
+	gsize                   pageSize = (gsize) sysconf(_SC_PAGESIZE);
+	gsize                   mapLen;
+	void                   *map = MAP_FAILED;
+	int                     maxEntries;
+	int                     fd;
+
+	/* leave room to grow */
+	maxEntries = MAX(numEntries * 2, 64);
+	mapLen = sizeof(PmLogLevelPageHeader_t) + (gsize) maxEntries * sizeof(PmLogLevelEntry_t);
+	mapLen = (mapLen + pageSize - 1) / pageSize * pageSize;
+	maxEntries = (int)((mapLen - sizeof(PmLogLevelPageHeader_t)) / sizeof(PmLogLevelEntry_t));
+
+	fd = open(tmpPath, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+	if ((fd < 0) || (fchmod(fd, 0644) != 0) || (ftruncate(fd, (off_t) mapLen) != 0) ||
+	        ((map = mmap(NULL, mapLen, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) ==
+	         MAP_FAILED))
+	{
+		ErrPrint("%s: failed to create %s: %s\n", __FUNCTION__, tmpPath, strerror(errno));
+
+		if (fd >= 0)
+		{
+			close(fd);
+			(void) unlink(tmpPath);
+		}
+
+		g_free(tmpPath);
+		return false;
+	}
+
+	close(fd);
+
+	/* not published yet, no need to lock */
+	header = map;
+	header->magic = PMLOG_LEVEL_PAGE_MAGIC;
+	header->version = PMLOG_LEVEL_PAGE_VERSION;
+	header->maxEntries = maxEntries;
+	header->epoch = page->epoch;
+	header->numEntries = numEntries;
+	header->defaultLevel = defaultLevel;
+	memcpy(header + 1, entries, (gsize) numEntries * sizeof(PmLogLevelEntry_t));
+
+	if (rename(tmpPath, page->path) != 0)
+	{
+		/* clients keep using the current file */
+		ErrPrint("%s: rename error: %s\n", __FUNCTION__, strerror(errno));
+		(void) munmap(map, mapLen);
+		(void) unlink(tmpPath);
+		g_free(tmpPath);
+		return false;
+	}
+
+	/* only once clients reopening the path find the new file */
+	LevelPageUnmap(page);
+
+	page->header = header;
+	page->entries = (PmLogLevelEntry_t *)(header + 1);
+	page->mapLen = mapLen;
+
+	g_free(tmpPath);
+
+	return true;
+}
+
+/**
+ * @brief LevelPageNew
+ *
+ * @param path
+ * @param epoch of the context ids
+ *
+ * @return the page, published on the first call to LevelPagePublish
+ */
+PmLogLevelPage_t *LevelPageNew(const char *path, guint32 epoch)
+{
+	PmLogLevelPage_t       *page = g_new0(PmLogLevelPage_t, 1);
+	PmLogLevelPageHeader_t *stale;
+	int                     fd;
+
+	page->path = g_strdup(path);
+	page->epoch = epoch;
+
+	/* clients of a previous instance may still be mapping it */
+	fd = open(path, O_RDWR | O_CLOEXEC);
+
+	if (fd >= 0)
+	{
+		stale = mmap(NULL, sizeof(PmLogLevelPageHeader_t), PROT_READ | PROT_WRITE,
+		             MAP_SHARED, fd, 0);
+
+		if (stale != MAP_FAILED)
+		{
+			g_atomic_int_set(&stale->replaced, 1);
+			(void) munmap(stale, sizeof(PmLogLevelPageHeader_t));
+		}
+
+		close(fd);
+	}
+
+	return page;
+}
+
+/**
+ * @brief LevelPagePublish
+ *
+ * @param page
+ * @param entries sorted by name
+ * @param numEntries
+ * @param defaultLevel
+ *
+ * @return true on success
+ */
+bool LevelPagePublish(PmLogLevelPage_t *page, const PmLogLevelEntry_t *entries,
+                      int numEntries, int defaultLevel)
+{
+	if (!page->header || (numEntries > page->header->maxEntries))
+	{
+		return LevelPageReplace(page, entries, numEntries, defaultLevel);
+	}
+
+	LevelPageWrite(page, entries, numEntries, defaultLevel);
+
+	return true;
+}
+
+/**
+ * @brief LevelPageFree
+ *
+ * Remove the page, clients then send every message.
+ *
+ * @param page
+ */
+void LevelPageFree(PmLogLevelPage_t *page)
+{
+	if (page->header)
+	{
+		(void) unlink(page->path);
+	}
+
+	LevelPageUnmap(page);
+	g_free(page->path);
+	g_free(page);
+}
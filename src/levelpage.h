@@ -0,0 +1,102 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2007-2014 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+/**
+ ***********************************************************************
+ * @file levelpage.h
+ *
+ * @brief This file contains definition of the page publishing to
+ * clients the least severe level each context accepts.
+ *
+ * Clients map PMLOG_LEVEL_PAGE_PATH read-only, and may skip formatting
+ * and sending the messages of a context less severe than its level:
+ * they would be dropped by the daemon anyway.
+ *
+ * The page is updated in place under a sequence lock:
+ *  - read generation, retry if odd
+ *  - look up the context (entries are sorted by strcmp of their names;
+ *    contexts not listed use defaultLevel)
+ *  - read generation again, retry if it changed
+ *
+ * If replaced is set, the file was replaced or the daemon stopped: the
+ * client should map the file again, or send everything if it is gone.
+ *
+ * Entries also give the id of their context for binary messages (see
+ * binmsg.h), valid along with the epoch of the page.
+ *
+ ***********************************************************************
+ */
+
+
+#ifndef PMLOGDAEMON_LEVELPAGE_H
+#define PMLOGDAEMON_LEVELPAGE_H
+
+#include <stdbool.h>
+#include <glib.h>
+#include "PmLogLib.h"
+#include "print.h"
+
+#define PMLOG_LEVEL_PAGE_PATH       "/var/run/pmlogd-levels"
+
+#define PMLOG_LEVEL_PAGE_MAGIC      0x564c4d50      /* "PMLV" */
+#define PMLOG_LEVEL_PAGE_VERSION    2
+
+/* level of a context dropping every message */
+#define PMLOG_LEVEL_PAGE_NONE       -1
+
+typedef struct
+{
+	guint32 magic;
+	guint32 version;
+
+	/* odd while the entries are being updated */
+	volatile gint generation;
+
+	/* set once the file is replaced or the daemon is stopped */
+	volatile gint replaced;
+
+	gint32  maxEntries;
+	gint32  numEntries;
+
+	/* level of the contexts not listed */
+	gint32  defaultLevel;
+
+	/* changes when the daemon restarts, with the context ids */
+	guint32 epoch;
+}
+PmLogLevelPageHeader_t;
+
+typedef struct
+{
+	char    name[ PMLOG_MAX_CONTEXT_NAME_LEN + 1 ];
+
+	/* least severe syslog level accepted, or PMLOG_LEVEL_PAGE_NONE */
+	gint32  level;
+
+	guint32 id;
+}
+PmLogLevelEntry_t;
+
+typedef struct _PmLogLevelPage PmLogLevelPage_t;
+
+PmLogLevelPage_t *LevelPageNew(const char *path, guint32 epoch);
+bool LevelPagePublish(PmLogLevelPage_t *page, const PmLogLevelEntry_t *entries,
+                      int numEntries, int defaultLevel);
+void LevelPageFree(PmLogLevelPage_t *page);
+
+#endif
@@ -40,7 +40,16 @@
  ***********************************************************************
  */
 
+#define _GNU_SOURCE
+
 #include "main.h"
+#include "archive.h"
+#include "receiver.h"
+#include "shmring.h"
+#include "levelpage.h"
+#include "binmsg.h"
+#include "sockfilter.h"
+#include "handover.h"
 
 #include <ctype.h>
 #include <errno.h>
@@ -52,7 +61,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
 #include <sys/param.h>
+#include <sys/signalfd.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/syslog.h>
@@ -65,12 +77,17 @@
 #include <zlib.h>
 #include <glib.h>
 #include <glib/gstdio.h>
+#include <glib-unix.h>
 #include <rdx.h>
 
 #include <sys/wait.h>
 #include <time.h>
+#include <linux/sockios.h>
 
 #include <luna-service2/lunaservice.h>
+#ifdef HAVE_IO_URING
+#include <liburing.h>
+#endif
 
 /***********************************************************************
  * status codes
@@ -120,6 +137,16 @@ static int          g_timeStampFracSecDigits;
 /* 0 for no monotonic seconds, 1 to include monotonic seconds */
 static int          g_timeStampMonotonic;
 
+/* 0 to parse messages on the main thread, else number of worker threads */
+static int          g_ingestWorkers;
+
+/* 0 to log messages in the order received, 1 to only keep the order of
+ * the messages of each program */
+static int          g_ingestRelaxedOrder;
+
+/* 1 to take over from the running daemon, see handover.h */
+static int          g_takeOver;
+
 #ifdef PMLOGDAEMON_FEATURE_REMOTE_LOG
 /* UDP socket port number, i.e. 514 */
 static int          g_port;
@@ -132,11 +159,96 @@ static char         g_pathLog[ PATH_MAX ];
  * globals
  ***********************************************************************/
 
-/* counter for rotation subscriptions. Subscriber manage rotated log file
- * by himself, so we allow ony 1 or none subscribers. */
-static int          g_haveRotSubscription;
+/* seconds a rotated log is kept for its subscribers to acknowledge */
+#define ROTATION_ACK_TIMEOUT    600
+
+/* a subscribeOnRotations caller */
+typedef struct _RotationSubscriber
+{
+	LSMessage  *lsMessage;
+
+	/* output to be notified of, NULL for all */
+	gchar      *outputName;
+} RotationSubscriber;
+
+/* a rotated log handed over to the rotation subscribers */
+typedef struct _RotatedFile
+{
+	PmLogFile_t *logFileP;
+	gchar       *path;
+
+	/* senders that have not acknowledged the file yet, one per reference */
+	GSList      *pending;
+
+	/* true if a subscriber went away or timed out without acknowledging */
+	bool         abandoned;
+
+	guint        timeoutSource;
+} RotatedFile;
+
+/* rotation subscribers and the files they hold, guarded by g_rotationLock */
+static GMutex       g_rotationLock;
+static GSList      *g_rotationSubscribers;
+static GSList      *g_rotatedFiles;
 
 static PmLogFile_t  g_logFiles[ PMLOG_MAX_NUM_OUTPUTS ];
+
+/* reads the log sockets, off the main loop */
+static PmLogReceiver_t *g_receiver;
+
+/* how often datagrams dropped by the kernel may be logged, in seconds */
+#define KERNEL_DROPS_LOG_INTERVAL   10
+
+static struct
+{
+	guint   logged;
+	time_t  lastLog;
+} g_kernelDrops;
+
+/* levels of the contexts published to the clients */
+static PmLogLevelPage_t *g_levelPage;
+
+/* kernel filter of the /dev/log socket, dropping the levels no context
+ * logs; level and instructions also read by getStats */
+static struct
+{
+	int             sockFd;
+	volatile gint   level;
+	volatile gint   instructions;
+} g_logFilter = { -1, LOG_DEBUG, 0 };
+
+/* how long the log socket may be drained on exit, and how often it is
+ * checked meanwhile, in ms */
+#define SHUTDOWN_DRAIN_TIMEOUT      2000
+#define SHUTDOWN_DRAIN_INTERVAL     20
+
+/* how long the running daemon may take to exit on a handover, in ms */
+#define HANDOVER_EXIT_TIMEOUT       30000
+
+/* SIGINT, SIGTERM and SIGQUIT are read by the main loop; deadline of
+ * the drain, 0 until asked to exit */
+static struct
+{
+	int     signalFd;
+	gint64  deadline;
+} g_shutdown = { -1, 0 };
+
+/* sockets read, bound or taken over, and connection of the instance
+ * taking over, -1 if none, kept open until exiting; whether the sockets
+ * were sent to it and records may still be */
+static struct
+{
+	int     listenFd;
+	int     connFd;
+	int     fds[ PMLOG_HANDOVER_NUM_FDS ];
+	bool    handedOver;
+	bool    sending;
+} g_handover = { -1, -1, { -1, -1 }, false, false };
+
+/* contexts by id, for binary messages; fixed once assigned */
+static PmLogContextConf_t **g_contextsById;
+static int          g_numContextIds;
+static guint32      g_contextEpoch;
 static GHashTable          *whitelist_table = NULL;
 PmLogContext g_context;
 static bool register_luna_service(GMainLoop *mainLoop);
@@ -145,19 +257,67 @@ static bool register_luna_service(GMainLoop *mainLoop);
  *  Heavy operation management
  **********************************************************************/
 
+/* interval of the probe measuring how late a thread runs its sources */
+#define LOOP_LAG_PROBE_INTERVAL     1000
+
 typedef struct _HeavyOperationThread
 {
 	GThread *thrd;
 	GMainLoop *loop;
 	GMainContext *context;
+
+	/* lateness of the loop, last and maximum, in ms */
+	gint lastLag;
+	gint maxLag;
+	gint64 nextProbe;
 } HeavyOperationThread;
 
 HeavyOperationThread heavyOperationThread;
 
+/* runs the Luna service, so calls are not held up by heavy operations */
+HeavyOperationThread lunaServiceThread;
+
+/**
+ * @brief LoopLagProbe
+ *
+ * Periodic source measuring how late the loop of a thread gets to it,
+ * i.e. how long a request arriving at that time would have waited.
+ *
+ * @param user_data the HeavyOperationThread
+ *
+ * @return TRUE to keep probing
+ */
+static gboolean LoopLagProbe(gpointer user_data)
+{
+	HeavyOperationThread *ptr = (HeavyOperationThread *)user_data;
+	gint64 now = g_get_monotonic_time();
+	gint lag = (gint)(MAX(now - ptr->nextProbe, 0) / 1000);
+
+	g_atomic_int_set(&ptr->lastLag, lag);
+
+	if (lag > g_atomic_int_get(&ptr->maxLag))
+	{
+		g_atomic_int_set(&ptr->maxLag, lag);
+	}
+
+	ptr->nextProbe = now + LOOP_LAG_PROBE_INTERVAL * 1000;
+
+	return TRUE;
+}
+
 gpointer HeavyOperationThreadFunc(gpointer user_data)
 {
 	HeavyOperationThread *ptr = (HeavyOperationThread *)user_data;
 
+	g_main_loop_run(ptr->loop);
+
+	return 0;
+}
+
+gpointer LunaServiceThreadFunc(gpointer user_data)
+{
+	HeavyOperationThread *ptr = (HeavyOperationThread *)user_data;
+
 	int lsResult = register_luna_service(ptr->loop);
 	PmLogDebug(g_context, "LSRESITER_SERVICE result : %s", lsResult ? "true" : "false");
 
@@ -218,15 +378,36 @@ void DestroyHeavyOperationThread(HeavyOperationThread *ptr)
 	}
 }
 
-gboolean CreateHeavyOperationThread(HeavyOperationThread *ptr)
+/**
+ * @brief StartLoopThread
+ *
+ * Start a thread running a main loop on its own context, with a probe
+ * of its lateness.
+ *
+ * @param ptr
+ * @param name
+ * @param func thread function, running ptr->loop
+ *
+ * @return TRUE on success
+ */
+static gboolean StartLoopThread(HeavyOperationThread *ptr, const char *name,
+                                GThreadFunc func)
 {
+	GSource *probe;
+
 	ptr->context = g_main_context_new();
 
 	ptr->loop = g_main_loop_new(ptr->context, FALSE);
 
-	ptr->thrd = g_thread_try_new("HeavyOpThrd", HeavyOperationThreadFunc, ptr, NULL);
+	ptr->nextProbe = g_get_monotonic_time() + LOOP_LAG_PROBE_INTERVAL * 1000;
+	probe = g_timeout_source_new(LOOP_LAG_PROBE_INTERVAL);
+	g_source_set_callback(probe, LoopLagProbe, ptr, NULL);
+	g_source_attach(probe, ptr->context);
+	g_source_unref(probe);
+
+	ptr->thrd = g_thread_try_new(name, func, ptr, NULL);
 	if (!ptr->thrd) {
-		ErrPrint("Failed to create Heavy Operation Thread");
+		ErrPrint("Failed to create %s", name);
 		DestroyHeavyOperationThread(ptr);
 		return FALSE;
 	}
@@ -234,6 +415,16 @@ gboolean CreateHeavyOperationThread(HeavyOperationThread *ptr)
 	return TRUE;
 }
 
+gboolean CreateHeavyOperationThread(HeavyOperationThread *ptr)
+{
+	return StartLoopThread(ptr, "HeavyOpThrd", HeavyOperationThreadFunc);
+}
+
+gboolean CreateLunaServiceThread(HeavyOperationThread *ptr)
+{
+	return StartLoopThread(ptr, "LunaSrvThrd", LunaServiceThreadFunc);
+}
+
 /**********************************************************************
  *  Function declarations
  **********************************************************************/
@@ -528,37 +719,329 @@ Error:
 	return result;
 }
 
+/* Forward Declaration */
+static void OutputRenames(const PmLogFile_t *logFileP, const char **from,
+                          const char **to, int *errs, int n);
+
+/**
+ * @brief ArchiveRotation
+ *
+ * Shift the compressed rotations of the log file set and compress the
+ * given file as the newest one.  If rotatedPathP is given, compressing
+ * is left to the caller and the path to compress is returned in it.
+ *
+ * @param logFileP
+ * @param path file to archive, the log itself or a rotated copy
+ * @param startTaskInNewThread
+ * @param rotatedPathP NULL, or set to the rotated file to compress
+ *
+ * @return true if the file was archived
+ */
+static bool ArchiveRotation(PmLogFile_t *logFileP, const char *path,
+                            bool startTaskInNewThread, gchar **rotatedPathP)
+{
+	gchar          *from[ PMLOG_MAX_NUM_ROTATIONS + 1 ];
+	gchar          *to[ PMLOG_MAX_NUM_ROTATIONS + 1 ];
+	int             errs[ PMLOG_MAX_NUM_ROTATIONS + 1 ];
+	int             n = 0;
+	int             i;
+	bool            result = true;
+
+	if (logFileP->rotations <= 0)
+	{
+		/* we require rotations >= 1 */
+		ErrPrint("ROTATE_LOG ROTATION %d invalid number of rotations",logFileP->rotations);
+		return false;
+	}
+
+	/* rotate the log file set
+	   rotations = 1 then { log, log.0.gz }
+	   rotations = 2 then { log, log.0.gz, log.1.gz }
+	   ... */
+	for (i = MIN(logFileP->rotations, PMLOG_MAX_NUM_ROTATIONS) - 1; i > 0; i--)
+	{
+		from[ n ] = g_strdup_printf(PMLOGDAEMON_FILE_ROTATION_PATTERN,
+		                            logFileP->path, i - 1);
+		to[ n ] = g_strdup_printf(PMLOGDAEMON_FILE_ROTATION_PATTERN,
+		                          logFileP->path, i);
+		n++;
+	}
+
+	/* the assumption is that the current file is flushed by the rename */
+	from[ n ] = g_strdup(path);
+	to[ n ] = g_strdup_printf("%s.%d", logFileP->path, 0);
+	n++;
+
+	/* note that rename will replace the old file if present */
+	OutputRenames(logFileP, (const char **) from, (const char **) to, errs, n);
+
+	for (i = 0; i < n; i++)
+	{
+		if (errs[ i ] && ((errs[ i ] != ENOENT) || (i == n - 1)))
+		{
+			ErrPrint("RotateLogFile: rename error: %s\n", strerror(errs[ i ]));
+		}
+	}
+
+	if (errs[ n - 1 ])
+	{
+		result = false;
+	}
+	else if (rotatedPathP)
+	{
+		*rotatedPathP = g_strdup(to[ n - 1 ]);
+	}
+	else if (startTaskInNewThread)
+	{
+		AddHeavyOperationTask(&heavyOperationThread, &CompressFile, g_strdup(to[ n - 1 ]));
+	}
+	else
+	{
+		CompressFile(g_strdup(to[ n - 1 ]));
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		g_free(from[ i ]);
+		g_free(to[ i ]);
+	}
+
+	return result;
+}
+
+/**
+ * @brief RotationSubscriberMatches
+ *
+ * @param sub
+ * @param logFileP
+ *
+ * @return true if the subscriber wants to be notified of rotations of
+ * the log file
+ */
+static bool RotationSubscriberMatches(const RotationSubscriber *sub,
+                                      const PmLogFile_t *logFileP)
+{
+	return (sub->outputName == NULL) ||
+	       (strcmp(sub->outputName, logFileP->outputName) == 0);
+}
+
+/**
+ * @brief HaveRotationSubscribers
+ *
+ * @param logFileP
+ *
+ * @return true if anyone subscribed to rotations of the log file
+ */
+static bool HaveRotationSubscribers(const PmLogFile_t *logFileP)
+{
+	GSList *l;
+	bool    result = false;
+
+	g_mutex_lock(&g_rotationLock);
+
+	for (l = g_rotationSubscribers; l != NULL; l = l->next)
+	{
+		if (RotationSubscriberMatches(l->data, logFileP))
+		{
+			result = true;
+			break;
+		}
+	}
+
+	g_mutex_unlock(&g_rotationLock);
+
+	return result;
+}
+
+/* Forward Declaration */
+static void OutputArchive(PmLogFile_t *logFileP, gchar *path);
+
+/**
+ * @brief RotatedFileFinish
+ *
+ * Runs on the main thread once every subscriber has released the
+ * rotated file.  If they all acknowledged it, it has been handed off
+ * and is deleted; otherwise it goes into the compressed rotations like
+ * any other rotated log, so it cannot pile up.
+ *
+ * @param userdata the RotatedFile, already out of g_rotatedFiles
+ *
+ * @return FALSE
+ */
+static gboolean RotatedFileFinish(gpointer userdata)
+{
+	RotatedFile *file = userdata;
+
+	/* subscribers may have moved or removed the file themselves */
+	if (g_file_test(file->path, G_FILE_TEST_EXISTS))
+	{
+		if (file->abandoned)
+		{
+			PmLogInfo(g_context, "ROTATION_UNACKED", 1,
+			          PMLOGKS("Path", file->path), "");
+			OutputArchive(file->logFileP, file->path);
+			file->path = NULL;
+		}
+		else
+		{
+			(void) myremove(file->path);
+		}
+	}
+
+	g_free(file->path);
+	g_free(file);
+
+	return FALSE;
+}
+
+/**
+ * @brief RotatedFileRelease
+ *
+ * Drop the reference of a subscriber on a rotated file, finishing it
+ * when it was the last one.  Must be called with g_rotationLock held.
+ *
+ * @param file
+ * @param link the element of file->pending to drop
+ * @param acked false if the subscriber went away without acknowledging
+ */
+static void RotatedFileRelease(RotatedFile *file, GSList *link, bool acked)
+{
+	g_free(link->data);
+	file->pending = g_slist_delete_link(file->pending, link);
+
+	if (!acked)
+	{
+		file->abandoned = true;
+	}
+
+	if (file->pending == NULL)
+	{
+		if (file->timeoutSource)
+		{
+			g_source_remove(file->timeoutSource);
+			file->timeoutSource = 0;
+		}
+
+		g_rotatedFiles = g_slist_remove(g_rotatedFiles, file);
+		g_main_context_invoke(NULL, RotatedFileFinish, file);
+	}
+}
+
+/**
+ * @brief RotatedFileTimeout
+ *
+ * Subscribers that did not acknowledge the rotated file in time lose
+ * their reference on it.
+ *
+ * @param userdata the RotatedFile
+ *
+ * @return FALSE to remove the source
+ */
+static gboolean RotatedFileTimeout(gpointer userdata)
+{
+	RotatedFile *file = userdata;
+	guint        n;
+
+	g_mutex_lock(&g_rotationLock);
+
+	/*
+	 * The last reference may have been released on the Luna thread
+	 * while we waited for the lock; RotatedFileFinish is then queued
+	 * behind us and the file is still valid, but no longer ours.
+	 */
+	if (file->pending == NULL)
+	{
+		g_mutex_unlock(&g_rotationLock);
+		return FALSE;
+	}
+
+	/* the source is removed by returning FALSE */
+	file->timeoutSource = 0;
+
+	/* the file may be finished, and freed, with the last reference */
+	for (n = g_slist_length(file->pending); n > 0; n--)
+	{
+		RotatedFileRelease(file, file->pending, false);
+	}
+
+	g_mutex_unlock(&g_rotationLock);
+
+	return FALSE;
+}
+
 /**
  * @brief DoNotifySubscribers
  *
- * Notify rotation subscribers with log 'filename' in payload.
+ * Hand the rotated log over to the subscribers of its output, with the
+ * log 'filepath' in the payload.  Each of them holds a reference on the
+ * file until it acknowledges it with ackRotation, cancels its
+ * subscription or ROTATION_ACK_TIMEOUT expires.
  *
- * @param userdata
+ * @param logFileP
+ * @param path the rotated log
  *
  * @return true if succeeded, else false
  */
-
-static bool DoNotifySubscribers(gpointer userdata)
+static bool DoNotifySubscribers(PmLogFile_t *logFileP, const char *path)
 {
-	bool result = true;
-	gchar *newPath = (gchar*)userdata;
+	bool                result = true;
+	RotatedFile        *file;
+	RotationSubscriber *sub;
+	GSList             *l;
+	jvalue_ref          payload;
+	LSError             lserror;
 
-	LSError lserror;
 	LSErrorInit(&lserror);
 
-	gchar *payload = g_strdup_printf("{\"filepath\":\"%s\"}", newPath);
+	payload = jobject_create();
+	jobject_put(payload, J_CSTR_TO_JVAL("filepath"), jstring_create(path));
+	jobject_put(payload, J_CSTR_TO_JVAL("output"),
+	            jstring_create(logFileP->outputName));
+
+	file = g_new0(RotatedFile, 1);
+	file->logFileP = logFileP;
+	file->path = g_strdup(path);
 
-	if (!LSSubscriptionReply(g_lsServiceHandle, ROTATION_SUBSCRIPTION_KEY,
-	                         payload, &lserror))
+	g_mutex_lock(&g_rotationLock);
+
+	for (l = g_rotationSubscribers; l != NULL; l = l->next)
 	{
+		sub = l->data;
 
-		LSErrorLog(g_context, "LSSUBREPLY_ERROR", &lserror);
-		LSErrorFree(&lserror);
-		result = false;
+		if (!RotationSubscriberMatches(sub, logFileP))
+		{
+			continue;
+		}
+
+		if (!LSMessageReply(g_lsServiceHandle, sub->lsMessage,
+		                    jvalue_tostring_simple(payload), &lserror))
+		{
+			LSErrorLog(g_context, "LSSUBREPLY_ERROR", &lserror);
+			LSErrorFree(&lserror);
+			result = false;
+			continue;
+		}
+
+		file->pending = g_slist_prepend(file->pending,
+		                                g_strdup(LSMessageGetSender(sub->lsMessage)));
+	}
+
+	if (file->pending)
+	{
+		file->timeoutSource = g_timeout_add_seconds(ROTATION_ACK_TIMEOUT,
+		                                            RotatedFileTimeout, file);
+		g_rotatedFiles = g_slist_prepend(g_rotatedFiles, file);
+	}
+	else
+	{
+		/* nobody took it */
+		file->abandoned = true;
+		g_main_context_invoke(NULL, RotatedFileFinish, file);
 	}
 
-	g_free(payload);
-	g_free(newPath);
+	g_mutex_unlock(&g_rotationLock);
+
+	j_release(&payload);
 
 	return result;
 }
@@ -570,22 +1053,27 @@ static bool DoNotifySubscribers(gpointer userdata)
  * that the base log exists. If startTaskInNewThread is true, add a new
  * task for heavy operation thread, to prevent syslog locking.
  *
+ * If rotatedPathP is given, it is set to the rotated file and nothing is
+ * compressed: either the file still has to be compressed by the caller,
+ * or it was handed over to rotation subscribers (*handedOffP is true).
+ *
  * @param logFileP
  * @param startTaskInNewThread
+ * @param rotatedPathP NULL, or set to the rotated file
+ * @param handedOffP NULL, or set to true if subscribers took the file
  *
  * @return 1 if the rotation was performed, else 0.
  */
-static int DoRotateLogFile(PmLogFile_t *logFileP, bool startTaskInNewThread)
+static int DoRotateLogFile(PmLogFile_t *logFileP, bool startTaskInNewThread,
+                           gchar **rotatedPathP, bool *handedOffP)
 {
 	int             result;
-	char            oldPath[ PATH_MAX ];
 	char            newPath[ PATH_MAX ];
-	int             i;
 
-	/* If daemon has no rotation subscribers, just compress
+	/* If the output has no rotation subscribers, just compress
 	 * the file, else notify subscribers and let them manage
 	 * rotated log file. */
-	if (g_atomic_int_get(&g_haveRotSubscription) == 0)
+	if (!HaveRotationSubscribers(logFileP))
 	{
 		if (logFileP->rotations <= 0)
 		{
@@ -594,47 +1082,14 @@ static int DoRotateLogFile(PmLogFile_t *logFileP, bool startTaskInNewThread)
 			return 0;
 		}
 
-		/* rotate the log file set
-		   rotations = 1 then { log, log.0.gz }
-		   rotations = 2 then { log, log.0.gz, log.1.gz }
-		   ... */
-		for (i = logFileP->rotations - 1; i > 0; i--)
-		{
-			snprintf(oldPath, sizeof(oldPath), PMLOGDAEMON_FILE_ROTATION_PATTERN,
-			         logFileP->path, i - 1);
-			snprintf(newPath, sizeof(newPath), PMLOGDAEMON_FILE_ROTATION_PATTERN,
-			         logFileP->path, i);
-			/* note that rename will replace the old file if present */
-			result = rename(oldPath, newPath);
-
-			if (result < 0)
-			{
-				if (errno != ENOENT)
-				{
-					ErrPrint("RotateLogFile: rename error: %s\n", strerror(errno));
-				}
-			}
-		}
-
-		/* the assumption is that the current file is flushed by the rename */
-		snprintf(newPath, sizeof(newPath), "%s.%d", logFileP->path, 0);
-		result = rename(logFileP->path, newPath);
-
-		if (result < 0)
+		if (handedOffP)
 		{
-			ErrPrint("RotateLogFile: rename error: %s\n", strerror(errno));
+			*handedOffP = false;
 		}
 
-		if (startTaskInNewThread)
-		{
-			AddHeavyOperationTask(&heavyOperationThread, &CompressFile, g_strdup(newPath));
-		}
-		else
-		{
-			CompressFile(g_strdup(newPath));
-		}
+		(void) ArchiveRotation(logFileP, logFileP->path, startTaskInNewThread,
+		                       rotatedPathP);
 	}
-	/* Else we have rotation subscribers, i.e. g_rotSubCount > 0 */
 	else
 	{
 		snprintf(newPath, sizeof(newPath), "%s.XXXXXX", logFileP->path);
@@ -658,13 +1113,16 @@ static int DoRotateLogFile(PmLogFile_t *logFileP, bool startTaskInNewThread)
 			}
 			else
 			{
-				if (startTaskInNewThread)
+				DoNotifySubscribers(logFileP, newPath);
+
+				if (rotatedPathP)
 				{
-					AddHeavyOperationTask(&heavyOperationThread, &DoNotifySubscribers, g_strdup(newPath));
+					*rotatedPathP = g_strdup(newPath);
 				}
-				else
+
+				if (handedOffP)
 				{
-					DoNotifySubscribers(g_strdup(newPath));
+					*handedOffP = true;
 				}
 			}
 		}
@@ -674,1654 +1132,6814 @@ static int DoRotateLogFile(PmLogFile_t *logFileP, bool startTaskInNewThread)
 }
 
 /**
- * @brief RotateLogFile
- *
- * If the specified file is too big to add the specified amount of data
- * according to the maximum size limit, then rotate the file set.
+ * @brief ForceRotateLogFile
  *
  * @param logFileP
- * @param fd
- * @param numToWrite
+ * @param startTaskInNewThread
+ * @param rotatedPathP see DoRotateLogFile
+ * @param handedOffP see DoRotateLogFile
  *
- * @return 1 if the rotation was performed, else 0.
+ * @return 0 on success else err code.
  */
-static int RotateLogFile(PmLogFile_t *logFileP, int fd, size_t numToWrite)
+static int ForceRotateLogFile(PmLogFile_t *logFileP, bool startTaskInNewThread,
+                              gchar **rotatedPathP, bool *handedOffP)
 {
 	int             result;
-	struct stat     fdStat;
-	size_t          fileLen;
-
-	if (logFileP->rotations <= 0)
-	{
-		/* we require rotations >= 1 */
-		DbgPrint("RotateLogFile: invalid number of rotations: %d\n",
-		         logFileP->rotations);
-		return 0;
-	}
+	struct stat     fileStat;
 
-	result = fstat(fd, &fdStat);
+	result = stat(logFileP->path, &fileStat);
 
 	if (result != 0)
 	{
-		DbgPrint("RotateLogFile: fstat error: %s\n", strerror(errno));
+		ErrPrint("ForceRotateLogFile: stat error for the path %s: %s\n", logFileP->path, strerror(errno));
 		return 0;
 	}
 
-	if (!S_ISREG(fdStat.st_mode))
+	if (!S_ISREG(fileStat.st_mode))
 	{
-		DbgPrint("RotateLogFile: not regular file\n");
+		ErrPrint("ForceRotateLogFile: not regular file\n");
 		return 0;
 	}
 
-	fileLen = (size_t) fdStat.st_size;
-
-	if (fileLen + numToWrite <= logFileP->maxSize)
-	{
-		return 0;
-	}
-
-	result = DoRotateLogFile(logFileP, true);
+	result = DoRotateLogFile(logFileP, startTaskInNewThread, rotatedPathP,
+	                         handedOffP);
 
 	return result;
 }
 
-/**
- * @brief WriteToLogFile
+/**********************************************************************
+ *  Output executors
  *
- * @param logFileP
- * @param p
- * @param n
+ *  Each output is owned by an executor thread, the only one to write,
+ *  rotate or delete its files.  Everybody else sends it commands through
+ *  its queue, so they take effect at a precise point of its stream.
  *
- * @return 0 on success else err code.
- */
-static int WriteToLogFile(PmLogFile_t *logFileP, const char *p, size_t n)
+ *  Messages are queued in two lanes: warnings and worse overtake the
+ *  backlog of the others, though not the commands posted before them.
+ **********************************************************************/
+
+/* messages batched before handing them over to the executor */
+#define OUTPUT_BATCH_SIZE       (64 * 1024)
+
+/* batches queued meanwhile are appended up to this size, to be written
+ * at once */
+#define OUTPUT_COALESCE_SIZE    (256 * 1024)
+
+/* least severe level of the urgent lane */
+#define OUTPUT_URGENT_LEVEL     LOG_WARNING
+
+/* bytes of messages queued to an executor before dropping more; the
+ * last OUTPUT_QUEUE_RESERVED bytes only take urgent messages */
+#define OUTPUT_QUEUE_MAX        (8 * 1024 * 1024)
+#define OUTPUT_QUEUE_RESERVED   (1024 * 1024)
+
+/* how often messages dropped by a full queue may be logged, in seconds */
+#define OUTPUT_DROPS_LOG_INTERVAL   10
+
+#ifdef HAVE_IO_URING
+#define OUTPUT_URING_ENTRIES    32
+#endif
+
+typedef enum
 {
-	int             fd;
-	int             err;
-	struct flock    fl;
-	int             result;
-	int             nWritten;
-	int             writeErr;
-	int             didRotate;
+	OUTPUT_LANE_URGENT,             /* messages up to OUTPUT_URGENT_LEVEL */
+	OUTPUT_LANE_BULK,               /* other messages, and the commands */
+	OUTPUT_NUM_LANES
+} OutputLaneType;
 
-	if ((p == NULL) || (n <= 0))
-	{
-		/* shouldn't happen, but check anyway */
-		ErrPrint("%s: invalid parameter", __FUNCTION__);
-		return 0;
-	}
+typedef enum
+{
+	OUTPUT_CMD_WRITE,               /* append a batch of messages */
+	OUTPUT_CMD_ROTATE,              /* rotate whatever the size */
+	OUTPUT_CMD_ARCHIVE,             /* add a file as the newest rotation */
+	OUTPUT_CMD_TRUNCATE,            /* empty the live log */
+	OUTPUT_CMD_KILL_ROTATIONS,      /* delete rotations, see LogFileKillRotations */
+	OUTPUT_CMD_BARRIER,             /* see OutputBarrier */
+	OUTPUT_CMD_QUIT
+} OutputCommandType;
+
+/* shared by the commands of one barrier */
+typedef struct _OutputBarrierSync
+{
+	gint        remaining;
+	GSourceFunc func;
+	gpointer    data;
+} OutputBarrierSync;
 
-	didRotate = 0;
+typedef struct _OutputCommand
+{
+	OutputCommandType   type;
 
-Retry:
+	/* OUTPUT_CMD_WRITE */
+	GString            *batch;
 
-	fd = open(logFileP->path, O_WRONLY | O_CREAT | O_NOCTTY |
-	          O_APPEND | O_NONBLOCK, 0644);
+	/* urgent OUTPUT_CMD_WRITE, commands to take before it */
+	guint               afterCommands;
 
-	if (fd < 0)
-	{
-		err = errno;
-		ErrPrint("OPEN_FILE ErrorText %s open error", strerror(err));
-		return err;
-	}
+	/* OUTPUT_CMD_ROTATE, see DoRotateLogFile; NULL to compress in the
+	 * background */
+	gchar             **rotatedPathP;
+	bool               *handedOffP;
 
-	/* get advisory file lock (write => exclusive lock) */
-	memset(&fl, 0, sizeof(fl));
-	fl.l_type = F_WRLCK;
-	result = fcntl(fd, F_SETLKW, &fl);
+	/* OUTPUT_CMD_ARCHIVE */
+	gchar              *path;
 
-	if (result != 0)
-	{
-		err = errno;
-		ErrPrint("GET_FILE_ADVISORY ErrorText %s fcntl F_SETLKW F_WRLCK error", strerror(err));
-	}
+	/* OUTPUT_CMD_KILL_ROTATIONS */
+	int                 start;
 
-	if (didRotate)
-	{
-		didRotate = 0;
-	}
-	else
-	{
-		didRotate = RotateLogFile(logFileP, fd, n);
-	}
+	/* OUTPUT_CMD_BARRIER */
+	OutputBarrierSync  *barrier;
+} OutputCommand;
 
-	writeErr = 0;
+typedef struct _OutputLane
+{
+	/* commands queued, under the lock of the executor */
+	GQueue          queue;
 
-	if (!didRotate)
-	{
-		errno = 0;
-		nWritten = write(fd, p, n);
+	/* messages not handed over yet, only used by the main thread */
+	GString        *pending;
+	guint           numPending;
 
-		if (nWritten != n)
-		{
-			err = errno;
+	/* messages dropped as the queue was full, also read by getStats */
+	volatile gint   dropped;
+} OutputLane;
 
-			if (err)
-			{
-				ErrPrint("WRITE_FILE ErrorText %s write error", strerror(err));
-				writeErr = err;
-			}
-			else
-			{
-				ErrPrint("WRITE_FILE LogFilePath %s write did not complete", logFileP->path);
-			}
-		}
-	}
+typedef struct _OutputExecutor
+{
+	PmLogFile_t  *logFileP;
+	GThread      *thrd;
+
+	/* see OutputExecutorTake */
+	GMutex        lock;
+	GCond         cond;
+	OutputLane    lanes[ OUTPUT_NUM_LANES ];
+	guint         numPosted;
+	guint         numTaken;
+	gsize         queuedBytes;
+
+	/* live log, only used by the executor thread */
+	int           fd;
+	off_t         size;
+
+	/* drops already logged, only used by the main thread */
+	guint         droppedLogged;
+	time_t        lastDropLog;
+
+#ifdef HAVE_IO_URING
+	/* renames the rotations, only used by the executor thread */
+	bool              uring;
+	struct io_uring   ring;
+#endif
+} OutputExecutor;
 
-	/* release advisory file lock */
-	memset(&fl, 0, sizeof(fl));
-	fl.l_type = F_UNLCK;
-	result = fcntl(fd, F_SETLKW, &fl);
+static OutputExecutor   g_outputExecutors[ PMLOG_MAX_NUM_OUTPUTS ];
+static int              g_numOutputExecutors;
+static guint            g_outputFlushSource;
 
-	if (result != 0)
-	{
-		err = errno;
-		ErrPrint("WRITE_FILE ErrorText %s fcntl F_SETLKW F_UNLCK error",strerror(err));
-	}
+/* lane of every message while set, see OutputForceLane */
+static OutputLaneType   g_outputForcedLane = OUTPUT_NUM_LANES;
 
-	/* close the file, which will sync (flush) it */
-	close(fd);
+/* Forward Declaration */
+static void LogFileKillRotations(PmLogFile_t *logFileP, int start);
+static gboolean FreeDiskSpace(gpointer userdata);
+static __time_t getMonotonicTime();
+
+/**
+ * @brief OutputExecutorOf
+ *
+ * @param logFileP
+ *
+ * @return the executor owning the output
+ */
+static OutputExecutor *OutputExecutorOf(const PmLogFile_t *logFileP)
+{
+	return &g_outputExecutors[ logFileP - g_logFiles ];
+}
 
-	if (didRotate)
+/**
+ * @brief OutputExecutorClose
+ *
+ * @param exec
+ */
+static void OutputExecutorClose(OutputExecutor *exec)
+{
+	if (exec->fd >= 0)
 	{
-		goto Retry;
+		close(exec->fd);
+		exec->fd = -1;
 	}
-
-	return writeErr;
 }
 
-
 /**
- * @brief ForceRotateLogFile
+ * @brief OutputExecutorOpen
  *
- * @param logFileP
- * @param startTaskInNewThread
+ * Make sure the live log is open, reopening it if it was removed or
+ * rotated behind our back.
+ *
+ * @param exec
  *
  * @return 0 on success else err code.
  */
-static int ForceRotateLogFile(PmLogFile_t *logFileP, bool startTaskInNewThread)
+static int OutputExecutorOpen(OutputExecutor *exec)
 {
-	int             result;
-	struct stat     fileStat;
-
-	result = stat(logFileP->path, &fileStat);
+	struct stat     fdStat;
+	int             err;
 
-	if (result != 0)
+	if ((exec->fd >= 0) && (fstat(exec->fd, &fdStat) == 0) &&
+	        (fdStat.st_nlink > 0))
 	{
-		ErrPrint("ForceRotateLogFile: stat error for the path %s: %s\n", logFileP->path, strerror(errno));
+		exec->size = S_ISREG(fdStat.st_mode) ? fdStat.st_size : -1;
 		return 0;
 	}
 
-	if (!S_ISREG(fileStat.st_mode))
+	OutputExecutorClose(exec);
+
+	exec->fd = open(exec->logFileP->path, O_WRONLY | O_CREAT | O_NOCTTY |
+	                O_APPEND | O_NONBLOCK, 0644);
+
+	if (exec->fd < 0)
 	{
-		ErrPrint("ForceRotateLogFile: not regular file\n");
-		return 0;
+		err = errno;
+		ErrPrint("OPEN_FILE ErrorText %s open error", strerror(err));
+		return err;
 	}
 
-	result = DoRotateLogFile(logFileP, startTaskInNewThread);
+	exec->size = 0;
 
-	return result;
+	if (fstat(exec->fd, &fdStat) == 0)
+	{
+		/* never rotate a device or a pipe */
+		exec->size = S_ISREG(fdStat.st_mode) ? fdStat.st_size : -1;
+	}
+
+	return 0;
 }
 
+/**
+ * @brief OutputExecutorRotate
+ *
+ * @param exec
+ * @param startTaskInNewThread
+ * @param rotatedPathP see DoRotateLogFile
+ * @param handedOffP see DoRotateLogFile
+ */
+static void OutputExecutorRotate(OutputExecutor *exec, bool startTaskInNewThread,
+                                 gchar **rotatedPathP, bool *handedOffP)
+{
+	(void) ForceRotateLogFile(exec->logFileP, startTaskInNewThread,
+	                          rotatedPathP, handedOffP);
+
+	/* the live log now has another name */
+	OutputExecutorClose(exec);
+}
 
 /**
- * @brief MatchOutputRule
+ * @brief OutputExecutorFit
  *
- * @param ruleP
- * @param pri
- * @param programName
+ * @param exec
+ * @param p
+ * @param n
  *
- * @return true if the specified message attributes match the specified
- * rule.
+ * @return how much of the batch, in whole messages, can be written
+ * before the log must be rotated
  */
-static bool MatchOutputRule(const PmLogRule_t *ruleP, int pri,
-                            const char *programName)
+static size_t OutputExecutorFit(const OutputExecutor *exec, const char *p,
+                                size_t n)
 {
-	int     fac;
-	int     lvl;
+	const PmLogFile_t *logFileP = exec->logFileP;
+	size_t             room;
+	size_t             i;
 
-	fac = pri & LOG_FACMASK;
-	lvl = pri & LOG_PRIMASK;
+	if ((logFileP->rotations <= 0) || (exec->size < 0) ||
+	        (exec->size + n <= logFileP->maxSize))
+	{
+		return n;
+	}
 
-	if (ruleP->facility != -1)
+	room = (exec->size < logFileP->maxSize) ?
+	       (size_t)(logFileP->maxSize - exec->size) : 0;
+
+	for (i = MIN(room, n); i > 0; i--)
 	{
-		if (ruleP->facility != fac)
+		if (p[ i - 1 ] == '\n')
 		{
-			return false;
+			return i;
 		}
 	}
 
-	if (ruleP->level == -1)
+	/* a message bigger than the limit still goes to a fresh log */
+	if (exec->size == 0)
 	{
-		if (ruleP->levelInvert)
+		for (i = 0; i < n; i++)
 		{
-			return false;
+			if (p[ i ] == '\n')
+			{
+				return i + 1;
+			}
 		}
+
+		return n;
 	}
-	else
+
+	return 0;
+}
+
+/**
+ * @brief OutputExecutorWrite
+ *
+ * Append a batch of messages to the live log, rotating it whenever it
+ * reaches its maximum size.
+ *
+ * @param exec
+ * @param p
+ * @param n
+ *
+ * @return 0 on success else err code.
+ */
+static int OutputExecutorWrite(OutputExecutor *exec, const char *p, size_t n)
+{
+	int             err;
+	size_t          chunk;
+	ssize_t         nWritten;
+
+	while (n > 0)
 	{
-		if (ruleP->levelInvert)
+		err = OutputExecutorOpen(exec);
+
+		if (err)
 		{
-			if (ruleP->level >= lvl)
-			{
-				return false;
-			}
+			return err;
 		}
-		else
+
+		chunk = OutputExecutorFit(exec, p, n);
+
+		if (chunk == 0)
 		{
-			/*
-			 * If the rule specified a level, it means match
-			 * that level or higher priority. But remember that
-			 * higher priority means lower numeric value.
-			 */
-			if (ruleP->level < lvl)
-			{
-				return false;
-			}
+			OutputExecutorRotate(exec, true, NULL, NULL);
+			continue;
 		}
-	}
 
-	if (ruleP->program != NULL)
-	{
-		if (programName == NULL)
+		errno = 0;
+		nWritten = write(exec->fd, p, chunk);
+
+		if (nWritten != chunk)
 		{
-			return false;
+			err = errno;
+
+			if (err)
+			{
+				ErrPrint("WRITE_FILE ErrorText %s write error", strerror(err));
+				return err;
+			}
+
+			ErrPrint("WRITE_FILE LogFilePath %s write did not complete",
+			         exec->logFileP->path);
+			return 0;
 		}
 
-		if (strcmp(ruleP->program, programName) != 0)
+		if (exec->size >= 0)
 		{
-			return false;
+			exec->size += chunk;
 		}
+
+		p += chunk;
+		n -= chunk;
 	}
 
-	return true;
+	return 0;
 }
 
-/* Forward Declaration */
-static void LogFileKillRotations(PmLogFile_t *logFileP, int start);
+/**
+ * @brief OutputCommandFree
+ *
+ * @param cmd
+ */
+static void OutputCommandFree(OutputCommand *cmd)
+{
+	if (cmd->batch)
+	{
+		g_string_free(cmd->batch, TRUE);
+	}
 
+	g_free(cmd->path);
+	g_free(cmd);
+}
 
-static gboolean FreeDiskSpace(gpointer userdata)
+/**
+ * @brief OutputExecutorTake
+ *
+ * Take the next command of the executor: the oldest urgent batch if the
+ * commands posted before it were taken, else the oldest of the bulk
+ * lane.
+ *
+ * @param exec
+ * @param wait for a command if none is queued
+ *
+ * @return the command, NULL if none and not waiting
+ */
+static OutputCommand *OutputExecutorTake(OutputExecutor *exec, bool wait)
 {
+	GQueue         *urgent = &exec->lanes[ OUTPUT_LANE_URGENT ].queue;
+	GQueue         *bulk = &exec->lanes[ OUTPUT_LANE_BULK ].queue;
+	OutputCommand  *cmd;
 
-	gchar *file_name = NULL;
-	GError *gerr = NULL;
+	g_mutex_lock(&exec->lock);
 
-	if (!g_spawn_command_line_sync(WEBOS_INSTALL_DATADIR "/PmLogDaemon/show_disk_usage.sh " WEBOS_INSTALL_LOGDIR, &file_name, NULL, NULL, &gerr))
-	{
-		ErrPrint("SPAWN_FAILED ErrorText %s", gerr->message);
-		g_error_free(gerr);
-	}
-	else
+	for (;;)
 	{
-		g_return_val_if_fail(file_name, false);
-		g_strstrip(file_name);
-
-		/* clear some space */
-		int j;
+		cmd = g_queue_peek_head(urgent);
 
-		for (j = 0; j < g_numOutputs; j++)
+		if (cmd && ((gint)(exec->numTaken - cmd->afterCommands) >= 0))
 		{
-			LogFileKillRotations(&g_logFiles[j], 0);
+			(void) g_queue_pop_head(urgent);
+			break;
 		}
 
-		RdxReportMetadata md = create_rdx_report_metadata();
-		rdx_report_metadata_set_component(md, "syslog");
-		rdx_report_metadata_set_cause(md, WEBOS_INSTALL_LOGDIR " full");
-		rdx_report_metadata_set_detail(md, WEBOS_INSTALL_LOGDIR " full");
+		cmd = g_queue_pop_head(bulk);
 
-		if (!rdx_make_report_from_file(md, file_name))
+		if (cmd || !wait)
 		{
-			/* more aggressive cleanup */
-			PmLogDebug(g_context, "%s: couldn't create low disk space report after clearing logs.. Kill 'em all!\n", __func__);
-			system("/bin/rm -rf " WEBOS_INSTALL_LOGDIR "/* " WEBOS_INSTALL_LOGDIR "/.*");
-			system("/usr/bin/pkill -SIGHUP rdxd"); /* restart rdxd */
-
-			if (!rdx_make_report_from_file(md, file_name))
-			{
-				PmLogDebug(g_context, "%s: still couldnt make report after nuking " WEBOS_INSTALL_LOGDIR "!\n", __func__);
-			}
+			break;
 		}
 
-		destroy_rdx_report_metadata(md);
+		g_cond_wait(&exec->cond, &exec->lock);
 	}
 
-	g_remove(file_name);
-	g_free(file_name);
+	if (cmd && (cmd->type == OUTPUT_CMD_WRITE))
+	{
+		exec->queuedBytes -= cmd->batch->len;
+	}
+	else if (cmd)
+	{
+		exec->numTaken++;
+	}
 
-	return false;
-};
+	g_mutex_unlock(&exec->lock);
+
+	return cmd;
+}
 
 /**
- * @brief OutputMessage
+ * @brief OutputExecutorThreadFunc
  *
- * @param contextName
- * @param pri
- * @param programName
- * @param msg
+ * @param user_data the OutputExecutor
+ *
+ * @return NULL
  */
-static void OutputMessage(
-    const PmLogContextConf_t *contextConfP, int pri,
-    const char *programName, const char *msg)
+static gpointer OutputExecutorThreadFunc(gpointer user_data)
 {
-	bool                        wantOutput[ g_numOutputs ];
-	int                         i;
-	const PmLogRule_t          *ruleP;
-	PmLogFile_t                *logFileP;
-
-	if (contextConfP == NULL)
-	{
-		ErrPrint("INVALID_PARAMETER. ErrorText contextConfP is null");
-		return;
-	}
+	OutputExecutor *exec = user_data;
+	OutputCommand  *cmd;
+	OutputCommand  *next = NULL;
+	bool            quit = false;
+
+#ifdef HAVE_IO_URING
+	/* else rotations are renamed one by one */
+	exec->uring = (io_uring_queue_init(OUTPUT_URING_ENTRIES, &exec->ring, 0) == 0);
+#endif
 
-	for (i = 0; i < g_numOutputs; i++)
+	while (!quit)
 	{
-		wantOutput[ i ] = false;
-	}
+		cmd = next ? next : OutputExecutorTake(exec, true);
+		next = NULL;
 
-	/* determine which outputs to target based on the context rules */
-	for (i = 0; i < contextConfP->numRules; i++)
-	{
-		ruleP = &contextConfP->rules[ i ];
+		/* coalesce the batches queued meanwhile into one write */
+		while ((cmd->type == OUTPUT_CMD_WRITE) &&
+		        (cmd->batch->len < OUTPUT_COALESCE_SIZE) &&
+		        ((next = OutputExecutorTake(exec, false)) != NULL) &&
+		        (next->type == OUTPUT_CMD_WRITE))
+		{
+			g_string_append_len(cmd->batch, next->batch->str, next->batch->len);
+			OutputCommandFree(next);
+			next = NULL;
+		}
 
-		if (MatchOutputRule(ruleP, pri, programName))
+		switch (cmd->type)
 		{
-			g_assert(ruleP->outputIndex >= 0);
-			g_assert(ruleP->outputIndex < g_numOutputs);
+			case OUTPUT_CMD_WRITE:
+				if (OutputExecutorWrite(exec, cmd->batch->str, cmd->batch->len) == ENOSPC)
+				{
+					/* out of space.. clear it and report it */
+					ErrPrint("OUTOFSPACE ErrorCode %d", ENOSPC);
+					AddHeavyOperationTask(&heavyOperationThread, &FreeDiskSpace, NULL);
+				}
 
-			if (ruleP->omitOutput)
-			{
-				wantOutput[ ruleP->outputIndex ] = false;
-			}
-			else
-			{
-				wantOutput[ ruleP->outputIndex ] = true;
-			}
+				break;
+
+			case OUTPUT_CMD_ROTATE:
+				OutputExecutorRotate(exec, (cmd->rotatedPathP == NULL),
+				                     cmd->rotatedPathP, cmd->handedOffP);
+				break;
+
+			case OUTPUT_CMD_ARCHIVE:
+				(void) ArchiveRotation(exec->logFileP, cmd->path, true, NULL);
+				break;
+
+			case OUTPUT_CMD_TRUNCATE:
+				if ((OutputExecutorOpen(exec) == 0) && (exec->size > 0))
+				{
+					if (ftruncate(exec->fd, 0) != 0)
+					{
+						ErrPrint("TRUNCATE_FILE ErrorText %s", strerror(errno));
+					}
+				}
+
+				break;
+
+			case OUTPUT_CMD_KILL_ROTATIONS:
+				if (cmd->start == 0)
+				{
+					OutputExecutorClose(exec);
+				}
+
+				LogFileKillRotations(exec->logFileP, cmd->start);
+				break;
+
+			case OUTPUT_CMD_BARRIER:
+				if (g_atomic_int_dec_and_test(&cmd->barrier->remaining))
+				{
+					g_main_context_invoke(NULL, cmd->barrier->func, cmd->barrier->data);
+					g_free(cmd->barrier);
+				}
+
+				break;
+
+			case OUTPUT_CMD_QUIT:
+				quit = true;
+				break;
 		}
+
+		OutputCommandFree(cmd);
 	}
 
-	/* output to the specified targets */
-	for (i = 0; i < g_numOutputs; i++)
-	{
-		logFileP = &g_logFiles[ i ];
+	OutputExecutorClose(exec);
 
-		if (wantOutput[ i ])
-		{
-			int err_code = WriteToLogFile(logFileP, msg, strlen(msg));
-			if (err_code == ENOSPC)
-			{
-				ErrPrint("OUTOFSPACE ErrorCode %d", err_code);
-				AddHeavyOperationTask(&heavyOperationThread, &FreeDiskSpace, NULL);
-				/* out of space.. clear it and report it */
-				FreeDiskSpace(NULL);
-			}
-		}
+#ifdef HAVE_IO_URING
+	if (exec->uring)
+	{
+		io_uring_queue_exit(&exec->ring);
+		exec->uring = false;
 	}
-}
+#endif
 
+	return NULL;
+}
 
+#ifdef HAVE_IO_URING
 /**
- * @brief ParseMsgProgram
- *
- * If the message came from a syslog call, it should be of the form:
- *  <progname>: [ '[' <pid> ']' ] ' '
+ * @brief OutputUringRenames
  *
- * If this is matched, return the address of the character past the ' ',
- * else return NULL.
+ * Submit the renames as one chain, in order, each one whether the
+ * previous one failed or not.
  *
- * @param msg the message to parse
- * @param programFull
- * @param programFullBuffSize
- * @param nameLenP
- * @param programName
- * @param programNameBuffSize
+ * @param exec
+ * @param from
+ * @param to
+ * @param errs
+ * @param n
  *
- * @return if a match was made, the program name is returned in programName,
- * otherwise it should be left empty.
+ * @return false if the kernel can't rename through io_uring
  */
-static const char *ParseMsgProgram(const char *msg,
-                                   char *programFull, size_t programFullBuffSize, size_t *nameLenP,
-                                   char *programName, size_t programNameBuffSize)
+static bool OutputUringRenames(OutputExecutor *exec, const char **from,
+                               const char **to, int *errs, int n)
 {
-	const char *s;
-	size_t      nameLen;
-	size_t      fullLen;
-	int         index_colon = -1;
-	int         index_first_space = -1;
-
-	programFull[ 0 ] = '\0';
-	programName[ 0 ] = '\0';
-	*nameLenP = 0;
-
-	s = msg;
+	struct io_uring_sqe *sqe;
+	struct io_uring_cqe *cqe;
+	bool                 supported = true;
+	int                  ret;
+	int                  i;
 
-	/* span characters not including ':' and whitespace */
-	nameLen = 0;
+	if (n > OUTPUT_URING_ENTRIES)
+	{
+		return false;
+	}
 
-	while ((*s != 0) && (*s != ':'))
+	for (i = 0; i < n; i++)
 	{
-		// Case of long process name which includes parameter
-		// e.g. "chrome --in-render-process ... : [pid:tid]"
-		if (isspace(*s) && index_first_space == -1)
+		sqe = io_uring_get_sqe(&exec->ring);
+		io_uring_prep_renameat(sqe, AT_FDCWD, from[ i ], AT_FDCWD, to[ i ], 0);
+		io_uring_sqe_set_data64(sqe, (uint64_t) i);
+
+		if (i < n - 1)
 		{
-			index_first_space = s - msg;
+			sqe->flags |= IOSQE_IO_HARDLINK;
 		}
-		nameLen++;
-		s++;
 	}
 
-	if (nameLen == 0)
-	{
-		return NULL;
-	}
+	ret = io_uring_submit_and_wait(&exec->ring, (unsigned) n);
 
-	if (*s != ':')
+	if (ret < 0)
 	{
-		return NULL;
+		ErrPrint("%s: io_uring_submit_and_wait error: %s\n", __FUNCTION__,
+		         strerror(-ret));
+		return false;
 	}
-	else
+
+	for (i = 0; i < n; i++)
 	{
-		// Remember index of colon to remove the colon
-		index_colon = s - msg;
-	}
+		if (io_uring_wait_cqe(&exec->ring, &cqe) < 0)
+		{
+			return false;
+		}
 
-	s++;
+		errs[ io_uring_cqe_get_data64(cqe) ] = (cqe->res < 0) ? -cqe->res : 0;
 
-	if (*s != ' ')
-	{
-		return NULL;
+		/* renameat needs Linux 5.11 */
+		if (cqe->res == -EINVAL)
+		{
+			supported = false;
+		}
+
+		io_uring_cqe_seen(&exec->ring, cqe);
 	}
 
-	s++;
+	return supported;
+}
+#endif
 
-	//
-	if (index_first_space > -1)
-	{
-		nameLen = (size_t)index_first_space;
-		index_colon = index_first_space;
-	}
+/**
+ * @brief OutputRenames
+ *
+ * Rename files in order, on the executor thread of the output.
+ *
+ * @param logFileP
+ * @param from
+ * @param to
+ * @param errs set to the errno of each rename, 0 if it succeeded
+ * @param n
+ */
+static void OutputRenames(const PmLogFile_t *logFileP, const char **from,
+                          const char **to, int *errs, int n)
+{
+	int i;
 
-	fullLen = (size_t)(s - msg);
+#ifdef HAVE_IO_URING
+	OutputExecutor *exec = OutputExecutorOf(logFileP);
 
-	if (fullLen >= programFullBuffSize)
+	if (exec->uring)
 	{
-		/* overflow */
-		fullLen = programFullBuffSize - 1;
-	}
+		if (OutputUringRenames(exec, from, to, errs, n))
+		{
+			return;
+		}
 
-	memcpy(programFull, msg, fullLen);
+		/* nothing was renamed, do it the usual way from now on */
+		io_uring_queue_exit(&exec->ring);
+		exec->uring = false;
+	}
+#endif
 
-	if (index_colon > -1)
+	for (i = 0; i < n; i++)
 	{
-		programFull[ index_colon ] = ' ';  // Remove the colon and replace with space
-		programFull[ index_colon + 1 ] = '\0'; // Replace with next of the colon with NUL
+		errs[ i ] = (rename(from[ i ], to[ i ]) < 0) ? errno : 0;
 	}
+}
 
-	programFull[ fullLen ] = '\0';
+/**
+ * @brief OutputPost
+ *
+ * Queue a command other than a write to the executor of an output, in
+ * the bulk lane.  May be called from any thread; commands from the main
+ * thread that must follow the messages logged so far are posted after
+ * OutputFlush.
+ *
+ * @param logFileP
+ * @param cmd taken over
+ */
+static void OutputPost(PmLogFile_t *logFileP, OutputCommand *cmd)
+{
+	OutputExecutor *exec = OutputExecutorOf(logFileP);
 
-	*nameLenP = nameLen;
+	g_mutex_lock(&exec->lock);
 
-	if (nameLen >= programNameBuffSize)
-	{
-		/* name buff overflow! */
-		nameLen = programNameBuffSize - 1;
-	}
+	exec->numPosted++;
+	g_queue_push_tail(&exec->lanes[ OUTPUT_LANE_BULK ].queue, cmd);
+	g_cond_signal(&exec->cond);
+	g_mutex_unlock(&exec->lock);
+}
 
-	memcpy(programName, msg, nameLen);
-	programName[ nameLen ] = 0;
+/**
+ * @brief OutputCommandNew
+ *
+ * @param type
+ *
+ * @return a new command
+ */
+static OutputCommand *OutputCommandNew(OutputCommandType type)
+{
+	OutputCommand *cmd = g_new0(OutputCommand, 1);
 
-	return s;
-}
+	cmd->type = type;
 
+	return cmd;
+}
 
 /**
- * @brief ParseMsgPidTid
+ * @brief OutputFlushLane
  *
- * If PmLogLib is set to log process/thread IDs, it should be of the form:
- *  '[' <pid> [ ':' <tid> ] ']' ' '
- *
- * @param msg the message to parse
+ * Hand the batched messages of a lane over to the executor, or drop
+ * them if its queue is full.  Main thread only.
  *
- * @return if this is matched, return the address of the character past the ' ',
- * else return NULL.
+ * @param exec
+ * @param type of the lane
  */
-static const char *ParseMsgPidTid(const char *msg)
+static void OutputFlushLane(OutputExecutor *exec, OutputLaneType type)
 {
-	const char *s;
+	OutputLane     *lane = &exec->lanes[ type ];
+	OutputCommand  *cmd;
+	gsize           limit = OUTPUT_QUEUE_MAX;
 
-	s = msg;
+	if (lane->pending->len == 0)
+	{
+		return;
+	}
 
-	if (*s != '[')
+	if (type != OUTPUT_LANE_URGENT)
 	{
-		return NULL;
+		limit -= OUTPUT_QUEUE_RESERVED;
 	}
 
-	s++;
+	g_mutex_lock(&exec->lock);
 
-	if (']' == *s)  // If "[Pid:Tid]" is empty, it will come as "[]".
+	if (exec->queuedBytes + lane->pending->len > limit)
 	{
-		if (*++s != ' ')
-		{
-			return NULL;
-		}
+		g_mutex_unlock(&exec->lock);
 
-		return ++s;
+		/* the output can't keep up, rather than growing without bound */
+		g_atomic_int_add(&lane->dropped, (gint) lane->numPending);
+		g_string_truncate(lane->pending, 0);
+		lane->numPending = 0;
+		return;
 	}
 
-	if (!isdigit(*s))
-	{
-		return NULL;
-	}
+	cmd = OutputCommandNew(OUTPUT_CMD_WRITE);
+	cmd->batch = lane->pending;
+	cmd->afterCommands = exec->numPosted;
+	exec->queuedBytes += cmd->batch->len;
 
-	s++;
+	g_queue_push_tail(&lane->queue, cmd);
+	g_cond_signal(&exec->cond);
+	g_mutex_unlock(&exec->lock);
 
-	while (isdigit(*s))
-	{
-		s++;
-	}
+	lane->pending = g_string_sized_new(OUTPUT_BATCH_SIZE);
+	lane->numPending = 0;
+}
 
-	if (*s == ':')
-	{
-		s++;
+/**
+ * @brief OutputFlush
+ *
+ * Hand the batched messages of an output over to its executor.  Main
+ * thread only.
+ *
+ * @param logFileP
+ */
+static void OutputFlush(PmLogFile_t *logFileP)
+{
+	OutputExecutor *exec = OutputExecutorOf(logFileP);
 
-		if (!isdigit(*s))
-		{
-			return NULL;
-		}
+	OutputFlushLane(exec, OUTPUT_LANE_URGENT);
+	OutputFlushLane(exec, OUTPUT_LANE_BULK);
+}
 
-		s++;
+/**
+ * @brief ReportOutputDrops
+ *
+ * Log how many messages an output dropped, at most once per
+ * OUTPUT_DROPS_LOG_INTERVAL.  Main thread only.
+ *
+ * @param exec
+ */
+static void ReportOutputDrops(OutputExecutor *exec)
+{
+	guint   dropped = 0;
+	time_t  now;
+	int     i;
 
-		while (isdigit(*s))
-		{
-			s++;
-		}
+	for (i = 0; i < OUTPUT_NUM_LANES; i++)
+	{
+		dropped += (guint) g_atomic_int_get(&exec->lanes[ i ].dropped);
 	}
 
-	if (*s != ']')
+	if (dropped == exec->droppedLogged)
 	{
-		return NULL;
+		return;
 	}
 
-	s++;
+	now = getMonotonicTime();
 
-	if (*s != ' ')
+	if (exec->lastDropLog && (now - exec->lastDropLog < OUTPUT_DROPS_LOG_INTERVAL))
 	{
-		return NULL;
+		return;
 	}
 
-	s++;
+	PmLogWarning(g_context, "OUTPUT_DROPS", 2,
+	             PMLOGKS("Output", exec->logFileP->outputName),
+	             PMLOGKFV("Dropped", "%u", dropped - exec->droppedLogged),
+	             "%u messages dropped, output too slow", dropped - exec->droppedLogged);
 
-	return s;
+	exec->droppedLogged = dropped;
+	exec->lastDropLog = now;
 }
 
-
 /**
- * @brief ParseMsgContext
- *
- * If the message came from a PmLogLib call that specified a context,
- * it should be of the form:
- *  contextName msgid
+ * @brief OutputFlushAll
  *
- * If a match was made, the context name is returned in contextName,
- * otherwise it should be left empty.
+ * Idle source, so messages are batched while there are more to read.
  *
- * @param msg the message
- * @param contextName  the context name to write
- * @param contextNameBuffSize  the size of the context name buffer
+ * @param userdata
  *
- * @return the address of the character past the ' ' if this is matched, otherwise return NULL.
+ * @return FALSE
  */
-static const char *ParseMsgContext(const char *msg, char *contextName,
-                                   size_t contextNameBuffSize)
+static gboolean OutputFlushAll(gpointer userdata)
 {
-	const char *s;
-	size_t      i;
-
-	contextName[ 0 ] = 0;
-
-	s = msg;
+	int i;
 
-	/* span characters that are allowed for context names
-	 * see PmLogLib for definition */
-	i = 0;
+	g_outputFlushSource = 0;
 
-	while (!isspace(*s))
+	for (i = 0; i < g_numOutputExecutors; i++)
 	{
-		i++;
-		s++;
+		OutputFlush(&g_logFiles[ i ]);
+		ReportOutputDrops(&g_outputExecutors[ i ]);
 	}
 
-	if (i == 0)
-	{
-		return NULL;
-	}
+	return FALSE;
+}
 
-	if (i >= contextNameBuffSize)
+/**
+ * @brief OutputLaneOf
+ *
+ * @param pri
+ *
+ * @return the lane messages of this priority are queued in
+ */
+static OutputLaneType OutputLaneOf(int pri)
+{
+	if (g_outputForcedLane != OUTPUT_NUM_LANES)
 	{
-		/* context buff overflow! */
-		i = contextNameBuffSize - 1;
+		return g_outputForcedLane;
 	}
 
-	memcpy(contextName, msg, i);
-	contextName[ i ] = 0;
-
-	return s;
+	return (LOG_PRI(pri) <= OUTPUT_URGENT_LEVEL) ? OUTPUT_LANE_URGENT : OUTPUT_LANE_BULK;
 }
 
-static const char *ParseMsgID(const char *msg, char *msgid,
-                                   size_t msgIDSize)
+/**
+ * @brief OutputForceLane
+ *
+ * Queue every message in one lane, whatever its level, so that a
+ * sequence such as a ring buffer flush and its markers stays in order.
+ * Main thread only.
+ *
+ * @param type of the lane, OUTPUT_NUM_LANES to go back to the level of
+ * each message
+ */
+static void OutputForceLane(OutputLaneType type)
 {
-        const char *s;
-        size_t      i;
-
-        msgid[ 0 ] = 0;
-
-        s = msg;
-
-        /* span characters that are allowed for context names
-         * see PmLogLib for definition */
-        i = 0;
-
-	DbgPrint("In %s, msg is %s\n", __func__, msg);
-        while (!isspace(*s))
-        {
-                i++;
-                s++;
-        }
-
-        if (i == 0)
-        {
-		DbgPrint("In %s, returning NULL\n", __func__);
-                return NULL;
-        }
+	g_outputForcedLane = type;
+}
 
-        if (i >= msgIDSize)
-        {
-                /* context buff overflow! */
-                i = msgIDSize - 1;
-        }
+/**
+ * @brief OutputWrite
+ *
+ * Queue a message to an output, in the lane of its level.  Main thread
+ * only.
+ *
+ * @param logFileP
+ * @param pri
+ * @param msg
+ */
+static void OutputWrite(PmLogFile_t *logFileP, int pri, const char *msg)
+{
+	OutputExecutor *exec = OutputExecutorOf(logFileP);
+	OutputLaneType  type = OutputLaneOf(pri);
+	OutputLane     *lane = &exec->lanes[ type ];
 
-        memcpy(msgid, msg, i);
-        msgid[ i ] = 0;
+	g_string_append(lane->pending, msg);
+	lane->numPending++;
 
-	DbgPrint("In %s, msgid is %s\n", __func__, msgid);
-        return s;
+	if (lane->pending->len >= OUTPUT_BATCH_SIZE)
+	{
+		OutputFlushLane(exec, type);
+	}
+	else if (!g_outputFlushSource)
+	{
+		g_outputFlushSource = g_idle_add(OutputFlushAll, NULL);
+	}
 }
 
 /**
- * @brief HandleLogCommand
- * A command handler used to handle internal log commands (like rotate and dump).
+ * @brief OutputRotate
  *
- * @param msg the message
+ * Rotate an output after the messages logged so far.  Main thread only.
  *
- * @return true iff the message was a command and it was handled.
+ * @param logFileP
+ * @param rotatedPathP NULL, or set to the rotated file, see DoRotateLogFile
+ * @param handedOffP NULL, or set as in DoRotateLogFile
  */
-static bool HandleLogCommand(const char *msg)
+static void OutputRotate(PmLogFile_t *logFileP, gchar **rotatedPathP,
+                         bool *handedOffP)
 {
-	const char  *kLogCmdPrefix    = "!log ";
-	const size_t kLogCmdPrefixLen = 5;
-	PmLogFile_t *logFileP;
+	OutputCommand *cmd = OutputCommandNew(OUTPUT_CMD_ROTATE);
 
-	if (strncmp(msg, kLogCmdPrefix, kLogCmdPrefixLen) != 0)
-	{
-		return false;
-	}
+	cmd->rotatedPathP = rotatedPathP;
+	cmd->handedOffP = handedOffP;
 
-	msg += kLogCmdPrefixLen;
+	OutputFlush(logFileP);
+	OutputPost(logFileP, cmd);
+}
 
-	if (strcmp(msg, "rotate") == 0)
-	{
-		DbgPrint("HandleLogCommand: forcing rotation of main log\n");
-		logFileP = &g_logFiles[ 0 ];
-		(void) ForceRotateLogFile(logFileP, true);
-		return true;
-	}
+/**
+ * @brief OutputArchive
+ *
+ * Have the executor add a file to the rotations of its output.
+ *
+ * @param logFileP
+ * @param path taken over
+ */
+static void OutputArchive(PmLogFile_t *logFileP, gchar *path)
+{
+	OutputCommand *cmd = OutputCommandNew(OUTPUT_CMD_ARCHIVE);
 
-	return false;
+	cmd->path = path;
+	OutputPost(logFileP, cmd);
 }
 
 /**
- * @brief getMonotonicTime
+ * @brief OutputClear
  *
- * Get the current monotonic time in seconds
+ * Have the executor empty the live log and delete the rotations of its
+ * output, to free disk space.
  *
- * @return -1 on error, the monotonic time otherwise
+ * @param logFileP
  */
-static __time_t getMonotonicTime()
+static void OutputClear(PmLogFile_t *logFileP)
 {
-	int result = 0;
-	struct timespec ts;
-	result = clock_gettime(CLOCK_MONOTONIC, &ts);
+	OutputCommand *cmd;
 
-	if (result != 0)
-	{
-		DbgPrint("%s: Problem reading time", __FUNCTION__);
-		return -1;
-	}
+	OutputPost(logFileP, OutputCommandNew(OUTPUT_CMD_TRUNCATE));
 
-	return ts.tv_sec;
+	cmd = OutputCommandNew(OUTPUT_CMD_KILL_ROTATIONS);
+	cmd->start = 1;
+	OutputPost(logFileP, cmd);
 }
 
 /**
- * @brief FlushMessage
+ * @brief OutputBarrier
  *
- * Flush the given message.  This just calls OutputMessage
+ * Call func on the main thread once the executors have processed the
+ * messages and commands queued so far.  Main thread only.
  *
- * @param msg The message to flush
- * @param data the context to flush under
+ * @param logFileP output to wait for, NULL for all of them
+ * @param func
+ * @param data
  */
-void FlushMessage(const char *msg, gpointer data)
+static void OutputBarrier(PmLogFile_t *logFileP, GSourceFunc func,
+                          gpointer data)
 {
-	DbgPrint("%s: called with msg=%s\n", __FUNCTION__, msg);
-	const PmLogContextConf_t   *contextConfP = data;
-	gchar **tokens      = g_strsplit(msg, "/", 3);
+	OutputBarrierSync *barrier;
+	OutputCommand     *cmd;
+	int                i;
 
-	/* TODO: report corrupted buff msg, or print err msg */
-	if (tokens == NULL)
+	if (!logFileP && (g_numOutputExecutors == 0))
 	{
-		/* no buffer message */
-		DbgPrint("%s: No buffer message\n", __FUNCTION__);
+		g_main_context_invoke(NULL, func, data);
+		return;
 	}
-	else if (tokens[0] && tokens[1] && tokens[2])
-	{
-		/* TODO: check size of tokens */
-		char *p;
-		errno = 0;
-		int pri = strtol(tokens[0], &p, 10);
-
-		if ((errno != 0) || ((*p) != '\0'))
-		{
-			DbgPrint("%s: parse error on pri token\n", __FUNCTION__);
-			goto error;
-		}
 
-		gchar *programName  = tokens[1];
-		gchar *outMsg       = tokens[2];
+	barrier = g_new0(OutputBarrierSync, 1);
+	barrier->remaining = logFileP ? 1 : g_numOutputExecutors;
+	barrier->func = func;
+	barrier->data = data;
 
-		OutputMessage(contextConfP, pri, programName, outMsg);
-	}
-	else
+	for (i = 0; i < g_numOutputExecutors; i++)
 	{
-		/* corrupted buffer message */
-		DbgPrint("%s: Corrupted buffer message\n", __FUNCTION__);
-	}
+		if (logFileP && (logFileP != &g_logFiles[ i ]))
+		{
+			continue;
+		}
 
-error:
+		cmd = OutputCommandNew(OUTPUT_CMD_BARRIER);
+		cmd->barrier = barrier;
 
-	if (tokens)
-	{
-		g_strfreev(tokens);
+		OutputFlush(&g_logFiles[ i ]);
+		OutputPost(&g_logFiles[ i ], cmd);
 	}
-
 }
 
 /**
- * @brief MakeMessageTimestamp
- *
- * Creates the timestamp string that is the prefix to output messages.
+ * @brief StartOutputExecutors
  *
- * @return pointer to new gchar* containing timestamp
+ * @return true if every output got its executor
  */
-static gchar *MakeMessageTimestamp()
+static bool StartOutputExecutors(void)
 {
+	OutputExecutor *exec;
+	GError         *gerr = NULL;
+	int             i;
+	int             j;
 
-	struct timeval  nowTv;
-	time_t          now;
-	struct tm       nowTm;
-	char            fracSecStr[ 16 ];
-	GString        *timeStamp = NULL;
-	__time_t mono = -1;
-
-	memset(&nowTv, 0, sizeof(nowTv));
-	(void) gettimeofday(&nowTv, NULL);
-	now = nowTv.tv_sec;
-
-	if (g_useFullTimeStamps)
+	for (i = 0; i < g_numOutputs; i++)
 	{
-		/*  Generate the timestamp => "1985-04-12T23:20:50.52Z" */
-		memset(&nowTm, 0, sizeof(nowTm));
-		(void) gmtime_r(&now, &nowTm);
-
-		fracSecStr[ 0 ] = 0;
+		exec = &g_outputExecutors[ i ];
+		exec->logFileP = &g_logFiles[ i ];
+		exec->fd = -1;
+		g_mutex_init(&exec->lock);
+		g_cond_init(&exec->cond);
 
-		if (g_timeStampFracSecDigits > 0)
+		for (j = 0; j < OUTPUT_NUM_LANES; j++)
 		{
-			snprintf(fracSecStr, sizeof(fracSecStr),
-			         ".%06ld", nowTv.tv_usec);
-			fracSecStr[ 1 + g_timeStampFracSecDigits ] = 0;
+			g_queue_init(&exec->lanes[ j ].queue);
+			exec->lanes[ j ].pending = g_string_sized_new(OUTPUT_BATCH_SIZE);
 		}
 
+		exec->thrd = g_thread_try_new("OutputExec", OutputExecutorThreadFunc,
+		                              exec, &gerr);
 
-		timeStamp = g_string_sized_new(40);
-		g_string_printf(timeStamp,
-		                "%04d-%02d-%02dT%02d:%02d:%02d%sZ",
-		                1900 + nowTm.tm_year, 1 + nowTm.tm_mon, nowTm.tm_mday,
-		                nowTm.tm_hour, nowTm.tm_min, nowTm.tm_sec, fracSecStr);
+		if (!exec->thrd)
+		{
+			ErrPrint("Failed to create output executor: %s", gerr->message);
+			g_error_free(gerr);
+			return false;
+		}
+
+		g_numOutputExecutors++;
 	}
-	else
+
+	return true;
+}
+
+/**
+ * @brief StopOutputExecutors
+ *
+ * Write what is left and wait for the executors.  Their lanes are kept,
+ * the heavy operation thread may still post to them.
+ */
+static void StopOutputExecutors(void)
+{
+	OutputExecutor *exec;
+	int             i;
+
+	if (g_outputFlushSource)
 	{
-		/*
-		 * Generate the timestamp. ctime => "Wed Jun 30 21:49:08 1993\n"
-		 * Note: glibc uses strftime "%h %e %T" using C locale
-		 */
-		timeStamp = g_string_new_len(ctime(&now) + 4, 15);
+		g_source_remove(g_outputFlushSource);
+		g_outputFlushSource = 0;
 	}
 
-	/* append the monotonic time */
-	if (g_timeStampMonotonic)
+	for (i = 0; i < g_numOutputExecutors; i++)
 	{
-		mono = getMonotonicTime();
-
-		if (mono != -1)
-		{
-			g_string_append_printf(timeStamp, " [%ld]", mono);
-		}
+		exec = &g_outputExecutors[ i ];
+		OutputFlush(exec->logFileP);
+		OutputPost(exec->logFileP, OutputCommandNew(OUTPUT_CMD_QUIT));
+		g_thread_join(exec->thrd);
+		exec->thrd = NULL;
 	}
 
-	return g_string_free(timeStamp, FALSE);
+	g_numOutputExecutors = 0;
 }
 
+
 /**
- * @brief FlushNotMe
- *
- * This flushes the RB if the context is not me.  The point of this
- * is that it is called on every contexts when a flush is to be done.
- * We exclude "me" since it will be done last.
+ * @brief MatchOutputRule
  *
- * @param value pointer to a context that may be flushed
- * @param data pointer to the context that is not to be flushed, aka "me"
- * @param key unused
+ * @param ruleP
+ * @param pri
+ * @param programName
  *
- * @return
+ * @return true if the specified message attributes match the specified
+ * rule.
  */
-gboolean FlushNotMe(gpointer key, gpointer value, gpointer data)
+static bool MatchOutputRule(const PmLogRule_t *ruleP, int pri,
+                            const char *programName)
 {
-	PmLogContextConf_t *keyContextP = value;
-	const PmLogContextConf_t   *me = data;
+	int     fac;
+	int     lvl;
 
-	if (keyContextP == me)
+	fac = pri & LOG_FACMASK;
+	lvl = pri & LOG_PRIMASK;
+
+	if (ruleP->facility != -1)
 	{
-		/* Don't flush me. It will be done last so I show up recently in log */
-		DbgPrint("%s: %s will be flushing last, skipping", __FUNCTION__, keyContextP->contextName);
+		if (ruleP->facility != fac)
+		{
+			return false;
+		}
 	}
-	else if (keyContextP->rb)
-	{
-		/* have RB, need to flush */
-		DbgPrint("%s: %s is now flushing...", __FUNCTION__, keyContextP->contextName);
 
-		if (!(keyContextP->rb->isEmpty))
-		{
+	if (ruleP->level == -1)
+	{
+		if (ruleP->levelInvert)
+		{
+			return false;
+		}
+	}
+	else
+	{
+		if (ruleP->levelInvert)
+		{
+			if (ruleP->level >= lvl)
+			{
+				return false;
+			}
+		}
+		else
+		{
+			/*
+			 * If the rule specified a level, it means match
+			 * that level or higher priority. But remember that
+			 * higher priority means lower numeric value.
+			 */
+			if (ruleP->level < lvl)
+			{
+				return false;
+			}
+		}
+	}
+
+	if (ruleP->program != NULL)
+	{
+		if (programName == NULL)
+		{
+			return false;
+		}
+
+		if (strcmp(ruleP->program, programName) != 0)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static gboolean FreeDiskSpace(gpointer userdata)
+{
+
+	gchar *file_name = NULL;
+	GError *gerr = NULL;
+
+	if (!g_spawn_command_line_sync(WEBOS_INSTALL_DATADIR "/PmLogDaemon/show_disk_usage.sh " WEBOS_INSTALL_LOGDIR, &file_name, NULL, NULL, &gerr))
+	{
+		ErrPrint("SPAWN_FAILED ErrorText %s", gerr->message);
+		g_error_free(gerr);
+	}
+	else
+	{
+		g_return_val_if_fail(file_name, false);
+		g_strstrip(file_name);
+
+		/* clear some space */
+		int j;
+
+		for (j = 0; j < g_numOutputs; j++)
+		{
+			OutputClear(&g_logFiles[j]);
+		}
+
+		RdxReportMetadata md = create_rdx_report_metadata();
+		rdx_report_metadata_set_component(md, "syslog");
+		rdx_report_metadata_set_cause(md, WEBOS_INSTALL_LOGDIR " full");
+		rdx_report_metadata_set_detail(md, WEBOS_INSTALL_LOGDIR " full");
+
+		if (!rdx_make_report_from_file(md, file_name))
+		{
+			/* more aggressive cleanup */
+			PmLogDebug(g_context, "%s: couldn't create low disk space report after clearing logs.. Kill 'em all!\n", __func__);
+			system("/bin/rm -rf " WEBOS_INSTALL_LOGDIR "/* " WEBOS_INSTALL_LOGDIR "/.*");
+			system("/usr/bin/pkill -SIGHUP rdxd"); /* restart rdxd */
+
+			if (!rdx_make_report_from_file(md, file_name))
+			{
+				PmLogDebug(g_context, "%s: still couldnt make report after nuking " WEBOS_INSTALL_LOGDIR "!\n", __func__);
+			}
+		}
+
+		destroy_rdx_report_metadata(md);
+	}
+
+	g_remove(file_name);
+	g_free(file_name);
+
+	return false;
+};
+
+/**
+ * @brief SelectOutputs
+ *
+ * @param contextConfP
+ * @param pri
+ * @param programName
+ * @param wantOutput set for each of the g_numOutputs outputs
+ *
+ * @return true if any output is selected
+ */
+static bool SelectOutputs(const PmLogContextConf_t *contextConfP, int pri,
+                          const char *programName, bool *wantOutput)
+{
+	int                         i;
+	const PmLogRule_t          *ruleP;
+	PmLogRule_t                 rule;
+	bool                        any = false;
+
+	for (i = 0; i < g_numOutputs; i++)
+	{
+		wantOutput[ i ] = false;
+	}
+
+	/* determine which outputs to target based on the context rules */
+	for (i = 0; i < contextConfP->numRules; i++)
+	{
+		ruleP = &contextConfP->rules[ i ];
+
+		/* a runtime level replaces the level of the including rules */
+		if (contextConfP->override.hasLevel && (contextConfP->override.level >= 0) &&
+		        !ruleP->levelInvert && !ruleP->omitOutput && (ruleP->level != -1))
+		{
+			rule = *ruleP;
+			rule.level = contextConfP->override.level;
+			ruleP = &rule;
+		}
+
+		if (MatchOutputRule(ruleP, pri, programName))
+		{
+			g_assert(ruleP->outputIndex >= 0);
+			g_assert(ruleP->outputIndex < g_numOutputs);
+
+			if (ruleP->omitOutput)
+			{
+				wantOutput[ ruleP->outputIndex ] = false;
+			}
+			else
+			{
+				wantOutput[ ruleP->outputIndex ] = true;
+			}
+		}
+	}
+
+	for (i = 0; i < g_numOutputs; i++)
+	{
+		any = any || wantOutput[ i ];
+	}
+
+	return any;
+}
+
+/**
+ * @brief OutputMessage
+ *
+ * @param contextName
+ * @param pri
+ * @param programName
+ * @param msg
+ */
+static void OutputMessage(
+    const PmLogContextConf_t *contextConfP, int pri,
+    const char *programName, const char *msg)
+{
+	bool                        wantOutput[ g_numOutputs ];
+	int                         i;
+	PmLogFile_t                *logFileP;
+
+	if (contextConfP == NULL)
+	{
+		ErrPrint("INVALID_PARAMETER. ErrorText contextConfP is null");
+		return;
+	}
+
+	if (!SelectOutputs(contextConfP, pri, programName, wantOutput))
+	{
+		return;
+	}
+
+	/* output to the specified targets */
+	for (i = 0; i < g_numOutputs; i++)
+	{
+		logFileP = &g_logFiles[ i ];
+
+		if (wantOutput[ i ])
+		{
+			OutputWrite(logFileP, pri, msg);
+		}
+	}
+}
+
+
+/**
+ * @brief ContextMinLevel
+ *
+ * Least severe level a context may keep, following RouteLogRecord and
+ * OutputMessage.  Rules restricted to a facility or a program count as
+ * matching, and omitting rules are ignored: the level may be lower than
+ * needed, never higher.
+ *
+ * @param contextConfP
+ *
+ * @return a syslog level, or PMLOG_LEVEL_PAGE_NONE if every message is
+ * dropped
+ */
+static int ContextMinLevel(const PmLogContextConf_t *contextConfP)
+{
+	const PmLogContextOverride_t   *ov = &contextConfP->override;
+	const PmLogRule_t              *ruleP;
+	int                             level = PMLOG_LEVEL_PAGE_NONE;
+	int                             ruleLevel;
+	int                             i;
+
+	for (i = 0; i < contextConfP->numRules; i++)
+	{
+		ruleP = &contextConfP->rules[ i ];
+
+		if (ruleP->omitOutput)
+		{
+			continue;
+		}
+
+		if (ruleP->levelInvert)
+		{
+			/* matches the levels less severe than its own */
+			ruleLevel = ((ruleP->level == -1) || (ruleP->level >= LOG_DEBUG)) ?
+			            PMLOG_LEVEL_PAGE_NONE : LOG_DEBUG;
+		}
+		else if (ruleP->level == -1)
+		{
+			ruleLevel = LOG_DEBUG;
+		}
+		else if (ov->hasLevel && (ov->level >= 0))
+		{
+			ruleLevel = ov->level;
+		}
+		else
+		{
+			ruleLevel = ruleP->level;
+		}
+
+		level = MAX(level, ruleLevel);
+	}
+
+	/* everything is buffered, to be flushed or dumped */
+	if (contextConfP->rb && !ov->bypassRB)
+	{
+		level = LOG_DEBUG;
+	}
+
+#ifdef RDX_LOG_REPORTING
+	/* critical messages are reported, along with the recent lines */
+	level = MAX(level, (g_rdxContextLines > 0) ? LOG_DEBUG : LOG_CRIT);
+#endif
+
+	if (ov->hasLevel)
+	{
+		level = MIN(level, ov->level);
+	}
+
+	return level;
+}
+
+
+/**
+ * @brief AssignContextId
+ *
+ * @param key
+ * @param value the PmLogContextConf_t
+ * @param data
+ *
+ * @return FALSE to go on
+ */
+static gboolean AssignContextId(gpointer key, gpointer value, gpointer data)
+{
+	PmLogContextConf_t *contextConfP = value;
+
+	g_contextsById[ g_numContextIds++ ] = contextConfP;
+	contextConfP->id = g_numContextIds;
+
+	return FALSE;
+}
+
+
+/**
+ * @brief AssignContextIds
+ *
+ * Number the contexts from 1, in the order of their names, under a new
+ * epoch.  Contexts are only added when loading the configuration, so
+ * ids are assigned once, before messages are parsed.
+ */
+static void AssignContextIds(void)
+{
+	g_contextsById = g_new0(PmLogContextConf_t *, g_tree_nnodes(g_contextConfs));
+	g_numContextIds = 0;
+	g_tree_foreach(g_contextConfs, AssignContextId, NULL);
+
+	/* 0 is never valid */
+	do
+	{
+		g_contextEpoch = g_random_int();
+	}
+	while (g_contextEpoch == 0);
+}
+
+
+/**
+ * @brief CollectContextLevel
+ *
+ * @param key
+ * @param value the PmLogContextConf_t
+ * @param data the GArray of PmLogLevelEntry_t
+ *
+ * @return FALSE to go on
+ */
+static gboolean CollectContextLevel(gpointer key, gpointer value, gpointer data)
+{
+	const PmLogContextConf_t   *contextConfP = value;
+	GArray                     *entries = data;
+	PmLogLevelEntry_t           entry;
+
+	memset(&entry, 0, sizeof(entry));
+	entry.level = ContextMinLevel(contextConfP);
+	entry.id = (guint32) contextConfP->id;
+
+	/* too long to be looked up, the default level covers it */
+	if (g_strlcpy(entry.name, contextConfP->contextName, sizeof(entry.name)) >=
+	        sizeof(entry.name))
+	{
+		g_array_index(entries, PmLogLevelEntry_t, 0).level =
+		    MAX(g_array_index(entries, PmLogLevelEntry_t, 0).level, entry.level);
+		return FALSE;
+	}
+
+	g_array_append_val(entries, entry);
+
+	return FALSE;
+}
+
+
+/**
+ * @brief UpdateLogFilter
+ *
+ * Filter the /dev/log socket according to g_logFilter.level, once it
+ * is open.
+ */
+static void UpdateLogFilter(void)
+{
+	int instructions;
+
+	if (g_logFilter.sockFd < 0)
+	{
+		return;
+	}
+
+	instructions = SockFilterSet(g_logFilter.sockFd, g_atomic_int_get(&g_logFilter.level));
+
+	if (instructions >= 0)
+	{
+		g_atomic_int_set(&g_logFilter.instructions, instructions);
+	}
+}
+
+
+/* Forward Declaration */
+static void WantCacheClear(void);
+
+/**
+ * @brief PublishContextLevels
+ *
+ * Update the level page, the socket filter and the early discard after
+ * the rules or the runtime changes of a context changed.  Main thread
+ * only.
+ */
+static void PublishContextLevels(void)
+{
+	const PmLogContextConf_t   *defaultConfP;
+	PmLogLevelEntry_t           fallback;
+	GArray                     *entries;
+	int                         maxLevel = PMLOG_LEVEL_PAGE_NONE;
+	guint                       i;
+
+	WantCacheClear();
+
+	/* the first element collects the level of the unknown contexts, which
+	 * are routed to the default one */
+	memset(&fallback, 0, sizeof(fallback));
+	defaultConfP = g_tree_lookup(g_contextConfs, kPmLogDefaultContextName);
+	fallback.level = defaultConfP ? ContextMinLevel(defaultConfP) : PMLOG_LEVEL_PAGE_NONE;
+
+	entries = g_array_new(FALSE, FALSE, sizeof(PmLogLevelEntry_t));
+	g_array_append_val(entries, fallback);
+	g_tree_foreach(g_contextConfs, CollectContextLevel, entries);
+
+	/* what no context logs needn't reach the daemon */
+	for (i = 0; i < entries->len; i++)
+	{
+		maxLevel = MAX(maxLevel, g_array_index(entries, PmLogLevelEntry_t, i).level);
+	}
+
+	if (maxLevel != g_atomic_int_get(&g_logFilter.level))
+	{
+		g_atomic_int_set(&g_logFilter.level, maxLevel);
+		UpdateLogFilter();
+	}
+
+	/* the tree is sorted by strcmp, so are the entries */
+	if (g_levelPage && !LevelPagePublish(g_levelPage,
+	                      &g_array_index(entries, PmLogLevelEntry_t, 1),
+	                      (int) entries->len - 1,
+	                      g_array_index(entries, PmLogLevelEntry_t, 0).level))
+	{
+		ErrPrint("%s: failed to publish the levels\n", __FUNCTION__);
+	}
+
+	g_array_free(entries, TRUE);
+}
+
+
+/**
+ * @brief ParseMsgProgram
+ *
+ * If the message came from a syslog call, it should be of the form:
+ *  <progname>: [ '[' <pid> ']' ] ' '
+ *
+ * If this is matched, return the address of the character past the ' ',
+ * else return NULL.
+ *
+ * @param msg the message to parse
+ * @param programFull
+ * @param programFullBuffSize
+ * @param nameLenP
+ * @param programName
+ * @param programNameBuffSize
+ *
+ * @return if a match was made, the program name is returned in programName,
+ * otherwise it should be left empty.
+ */
+static const char *ParseMsgProgram(const char *msg,
+                                   char *programFull, size_t programFullBuffSize, size_t *nameLenP,
+                                   char *programName, size_t programNameBuffSize)
+{
+	const char *s;
+	size_t      nameLen;
+	size_t      fullLen;
+	int         index_colon = -1;
+	int         index_first_space = -1;
+
+	programFull[ 0 ] = '\0';
+	programName[ 0 ] = '\0';
+	*nameLenP = 0;
+
+	s = msg;
+
+	/* span characters not including ':' and whitespace */
+	nameLen = 0;
+
+	while ((*s != 0) && (*s != ':'))
+	{
+		// Case of long process name which includes parameter
+		// e.g. "chrome --in-render-process ... : [pid:tid]"
+		if (isspace(*s) && index_first_space == -1)
+		{
+			index_first_space = s - msg;
+		}
+		nameLen++;
+		s++;
+	}
+
+	if (nameLen == 0)
+	{
+		return NULL;
+	}
+
+	if (*s != ':')
+	{
+		return NULL;
+	}
+	else
+	{
+		// Remember index of colon to remove the colon
+		index_colon = s - msg;
+	}
+
+	s++;
+
+	if (*s != ' ')
+	{
+		return NULL;
+	}
+
+	s++;
+
+	//
+	if (index_first_space > -1)
+	{
+		nameLen = (size_t)index_first_space;
+		index_colon = index_first_space;
+	}
+
+	fullLen = (size_t)(s - msg);
+
+	if (fullLen >= programFullBuffSize)
+	{
+		/* overflow */
+		fullLen = programFullBuffSize - 1;
+	}
+
+	memcpy(programFull, msg, fullLen);
+
+	if (index_colon > -1)
+	{
+		programFull[ index_colon ] = ' ';  // Remove the colon and replace with space
+		programFull[ index_colon + 1 ] = '\0'; // Replace with next of the colon with NUL
+	}
+
+	programFull[ fullLen ] = '\0';
+
+	*nameLenP = nameLen;
+
+	if (nameLen >= programNameBuffSize)
+	{
+		/* name buff overflow! */
+		nameLen = programNameBuffSize - 1;
+	}
+
+	memcpy(programName, msg, nameLen);
+	programName[ nameLen ] = 0;
+
+	return s;
+}
+
+
+/**
+ * @brief ParseMsgPidTid
+ *
+ * If PmLogLib is set to log process/thread IDs, it should be of the form:
+ *  '[' <pid> [ ':' <tid> ] ']' ' '
+ *
+ * @param msg the message to parse
+ *
+ * @return if this is matched, return the address of the character past the ' ',
+ * else return NULL.
+ */
+static const char *ParseMsgPidTid(const char *msg)
+{
+	const char *s;
+
+	s = msg;
+
+	if (*s != '[')
+	{
+		return NULL;
+	}
+
+	s++;
+
+	if (']' == *s)  // If "[Pid:Tid]" is empty, it will come as "[]".
+	{
+		if (*++s != ' ')
+		{
+			return NULL;
+		}
+
+		return ++s;
+	}
+
+	if (!isdigit(*s))
+	{
+		return NULL;
+	}
+
+	s++;
+
+	while (isdigit(*s))
+	{
+		s++;
+	}
+
+	if (*s == ':')
+	{
+		s++;
+
+		if (!isdigit(*s))
+		{
+			return NULL;
+		}
+
+		s++;
+
+		while (isdigit(*s))
+		{
+			s++;
+		}
+	}
+
+	if (*s != ']')
+	{
+		return NULL;
+	}
+
+	s++;
+
+	if (*s != ' ')
+	{
+		return NULL;
+	}
+
+	s++;
+
+	return s;
+}
+
+
+/**
+ * @brief ParseMsgContext
+ *
+ * If the message came from a PmLogLib call that specified a context,
+ * it should be of the form:
+ *  contextName msgid
+ *
+ * If a match was made, the context name is returned in contextName,
+ * otherwise it should be left empty.
+ *
+ * @param msg the message
+ * @param contextName  the context name to write
+ * @param contextNameBuffSize  the size of the context name buffer
+ *
+ * @return the address of the character past the ' ' if this is matched, otherwise return NULL.
+ */
+static const char *ParseMsgContext(const char *msg, char *contextName,
+                                   size_t contextNameBuffSize)
+{
+	const char *s;
+	size_t      i;
+
+	contextName[ 0 ] = 0;
+
+	s = msg;
+
+	/* span characters that are allowed for context names
+	 * see PmLogLib for definition */
+	i = 0;
+
+	while (!isspace(*s))
+	{
+		i++;
+		s++;
+	}
+
+	if (i == 0)
+	{
+		return NULL;
+	}
+
+	if (i >= contextNameBuffSize)
+	{
+		/* context buff overflow! */
+		i = contextNameBuffSize - 1;
+	}
+
+	memcpy(contextName, msg, i);
+	contextName[ i ] = 0;
+
+	return s;
+}
+
+static const char *ParseMsgID(const char *msg, char *msgid,
+                                   size_t msgIDSize)
+{
+        const char *s;
+        size_t      i;
+
+        msgid[ 0 ] = 0;
+
+        s = msg;
+
+        /* span characters that are allowed for context names
+         * see PmLogLib for definition */
+        i = 0;
+
+	DbgPrint("In %s, msg is %s\n", __func__, msg);
+        while (!isspace(*s))
+        {
+                i++;
+                s++;
+        }
+
+        if (i == 0)
+        {
+		DbgPrint("In %s, returning NULL\n", __func__);
+                return NULL;
+        }
+
+        if (i >= msgIDSize)
+        {
+                /* context buff overflow! */
+                i = msgIDSize - 1;
+        }
+
+        memcpy(msgid, msg, i);
+        msgid[ i ] = 0;
+
+	DbgPrint("In %s, msgid is %s\n", __func__, msgid);
+        return s;
+}
+
+/**
+ * @brief FindLogFile
+ *
+ * @param outputName
+ *
+ * @return the log file of the named output, or NULL if there is none
+ */
+static PmLogFile_t *FindLogFile(const char *outputName)
+{
+	int i;
+
+	for (i = 0; i < g_numOutputs; i++)
+	{
+		if (g_logFiles[ i ].outputName &&
+		        (strcmp(g_logFiles[ i ].outputName, outputName) == 0))
+		{
+			return &g_logFiles[ i ];
+		}
+	}
+
+	return NULL;
+}
+
+/////////////////////////////////////////////////////////////////
+//                                                             //
+//            Start of API documentation comment block         //
+//                                                             //
+/////////////////////////////////////////////////////////////////
+/**
+ * @brief HandleLogCommand
+ * A command handler used to handle internal log commands (like rotate and dump).
+ *
+ * @param msg the message
+ *
+ * @return true iff the message was a command and it was handled.
+ */
+static bool HandleLogCommand(const char *msg)
+{
+	const char  *kLogCmdPrefix    = "!log ";
+	const size_t kLogCmdPrefixLen = 5;
+	PmLogFile_t *logFileP;
+	int          i;
+
+	if (strncmp(msg, kLogCmdPrefix, kLogCmdPrefixLen) != 0)
+	{
+		return false;
+	}
+
+	msg += kLogCmdPrefixLen;
+
+	if (strcmp(msg, "rotate") == 0)
+	{
+		DbgPrint("HandleLogCommand: forcing rotation of main log\n");
+		logFileP = &g_logFiles[ 0 ];
+		OutputRotate(logFileP, NULL, NULL);
+		return true;
+	}
+
+	/* "rotate all" or "rotate <output>" */
+	if (strncmp(msg, "rotate ", 7) == 0)
+	{
+		msg += 7;
+
+		if (strcmp(msg, "all") == 0)
+		{
+			DbgPrint("HandleLogCommand: forcing rotation of all logs\n");
+
+			for (i = 0; i < g_numOutputs; i++)
+			{
+				OutputRotate(&g_logFiles[ i ], NULL, NULL);
+			}
+
+			return true;
+		}
+
+		logFileP = FindLogFile(msg);
+
+		if (logFileP)
+		{
+			DbgPrint("HandleLogCommand: forcing rotation of %s\n", msg);
+			OutputRotate(logFileP, NULL, NULL);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * @brief getMonotonicTime
+ *
+ * Get the current monotonic time in seconds
+ *
+ * @return -1 on error, the monotonic time otherwise
+ */
+static __time_t getMonotonicTime()
+{
+	int result = 0;
+	struct timespec ts;
+	result = clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	if (result != 0)
+	{
+		DbgPrint("%s: Problem reading time", __FUNCTION__);
+		return -1;
+	}
+
+	return ts.tv_sec;
+}
+
+/**
+ * @brief FlushMessage
+ *
+ * Flush the given message.  This just calls OutputMessage
+ *
+ * @param time unused
+ * @param pri priority of the message
+ * @param programName program that logged the message
+ * @param msg The message to flush
+ * @param data the context to flush under
+ */
+void FlushMessage(gint64 time, int pri, const char *programName,
+                  const char *msg, gpointer data)
+{
+	DbgPrint("%s: called with msg=%s\n", __FUNCTION__, msg);
+	const PmLogContextConf_t   *contextConfP = data;
+
+	OutputMessage(contextConfP, pri, programName, msg);
+}
+
+/**
+ * @brief FormatMessageTimestamp
+ *
+ * Creates the timestamp string that is the prefix to output messages.
+ *
+ * @param nowTv the time to format
+ * @param mono monotonic seconds at that time, -1 if unknown
+ *
+ * @return pointer to new gchar* containing timestamp
+ */
+static gchar *FormatMessageTimestamp(const struct timeval *nowTv, time_t mono)
+{
+	time_t          now;
+	struct tm       nowTm;
+	char            fracSecStr[ 16 ];
+	char            nowStr[ 26 ];
+	GString        *timeStamp = NULL;
+
+	now = nowTv->tv_sec;
+
+	if (g_useFullTimeStamps)
+	{
+		/*  Generate the timestamp => "1985-04-12T23:20:50.52Z" */
+		memset(&nowTm, 0, sizeof(nowTm));
+		(void) gmtime_r(&now, &nowTm);
+
+		fracSecStr[ 0 ] = 0;
+
+		if (g_timeStampFracSecDigits > 0)
+		{
+			snprintf(fracSecStr, sizeof(fracSecStr),
+			         ".%06ld", nowTv->tv_usec);
+			fracSecStr[ 1 + g_timeStampFracSecDigits ] = 0;
+		}
+
+
+		timeStamp = g_string_sized_new(40);
+		g_string_printf(timeStamp,
+		                "%04d-%02d-%02dT%02d:%02d:%02d%sZ",
+		                1900 + nowTm.tm_year, 1 + nowTm.tm_mon, nowTm.tm_mday,
+		                nowTm.tm_hour, nowTm.tm_min, nowTm.tm_sec, fracSecStr);
+	}
+	else
+	{
+		/*
+		 * Generate the timestamp. ctime => "Wed Jun 30 21:49:08 1993\n"
+		 * Note: glibc uses strftime "%h %e %T" using C locale
+		 */
+		timeStamp = g_string_new_len(ctime_r(&now, nowStr) + 4, 15);
+	}
+
+	/* append the monotonic time */
+	if (g_timeStampMonotonic && (mono != -1))
+	{
+		g_string_append_printf(timeStamp, " [%ld]", (long) mono);
+	}
+
+	return g_string_free(timeStamp, FALSE);
+}
+
+/* CLOCK_MONOTONIC minus CLOCK_REALTIME in us, main thread only */
+static gint64 g_monoOffset;
+
+/**
+ * @brief MonotonicSeconds
+ *
+ * Main thread: convert a wall clock time, such as the arrival of a
+ * datagram, without reading the clocks.
+ *
+ * @param time
+ *
+ * @return the monotonic seconds at that time, -1 if before boot
+ */
+static time_t MonotonicSeconds(const struct timeval *time)
+{
+	gint64 mono = (gint64) time->tv_sec * G_USEC_PER_SEC + time->tv_usec + g_monoOffset;
+
+	return (mono >= 0) ? (time_t)(mono / G_USEC_PER_SEC) : -1;
+}
+
+/**
+ * @brief MakeMessageTimestamp
+ *
+ * Creates the timestamp string for the current time.
+ *
+ * @return pointer to new gchar* containing timestamp
+ */
+static gchar *MakeMessageTimestamp()
+{
+	struct timeval  nowTv;
+
+	memset(&nowTv, 0, sizeof(nowTv));
+	(void) gettimeofday(&nowTv, NULL);
+
+	return FormatMessageTimestamp(&nowTv, getMonotonicTime());
+}
+
+/**
+ * @brief FormatRBUsage
+ *
+ * For compressed ring buffers, describe how much history is held per
+ * byte of memory.  Empty string for raw ring buffers.
+ *
+ * @param rb
+ * @param str
+ * @param size
+ */
+static void FormatRBUsage(const PmLogRingBuffer_t *rb, char *str, size_t size)
+{
+	int rawBytes;
+	int storedBytes;
+
+	str[ 0 ] = 0;
+
+	if (rb->compress)
+	{
+		RBGetUsage(rb, &rawBytes, &storedBytes);
+
+		if (storedBytes > 0)
+		{
+			snprintf(str, size, " (%d bytes of history in %d bytes, %.2f per byte)",
+			         rawBytes, storedBytes, (double) rawBytes / (double) storedBytes);
+		}
+	}
+}
+
+/**
+ * @brief FlushNotMe
+ *
+ * This flushes the RB if the context is not me.  The point of this
+ * is that it is called on every contexts when a flush is to be done.
+ * We exclude "me" since it will be done last.
+ *
+ * @param value pointer to a context that may be flushed
+ * @param data pointer to the context that is not to be flushed, aka "me"
+ * @param key unused
+ *
+ * @return
+ */
+gboolean FlushNotMe(gpointer key, gpointer value, gpointer data)
+{
+	PmLogContextConf_t *keyContextP = value;
+	const PmLogContextConf_t   *me = data;
+
+	if (keyContextP == me)
+	{
+		/* Don't flush me. It will be done last so I show up recently in log */
+		DbgPrint("%s: %s will be flushing last, skipping", __FUNCTION__, keyContextP->contextName);
+	}
+	else if (keyContextP->rb)
+	{
+		/* have RB, need to flush */
+		DbgPrint("%s: %s is now flushing...", __FUNCTION__, keyContextP->contextName);
+
+		if (!(keyContextP->rb->isEmpty))
+		{
+
+			gchar *timeStamp = MakeMessageTimestamp();
+			char            priStr[ 20 ];
+			char            usageStr[ 80 ];
+			/* look up facility + priority name from pri */
+			FormatPri(LOG_SYSLOG | LOG_INFO, priStr, sizeof(priStr));
+			gchar *outMsg =
+			    g_strdup_printf("%s %s pmsyslogd: {%s}: ------ Flushing ring buffer for context %s ------\n",
+			                    timeStamp,
+			                    priStr,
+			                    keyContextP->contextName,
+			                    me->contextName);
+
+			g_free(timeStamp);
+			OutputMessage(keyContextP, LOG_SYSLOG | LOG_INFO, "pmsyslogd", outMsg);
+			g_free(outMsg);
+
+			FormatRBUsage(keyContextP->rb, usageStr, sizeof(usageStr));
+			RBFlush(keyContextP->rb, FlushMessage, keyContextP);
+
+			timeStamp = MakeMessageTimestamp();
+			outMsg = g_strdup_printf("%s %s pmsyslogd: {%s}: ------ Done flushing%s ------\n",
+			                         timeStamp,
+			                         priStr,
+			                         keyContextP->contextName,
+			                         usageStr);
+			OutputMessage(keyContextP, LOG_SYSLOG | LOG_INFO, "pmsyslogd", outMsg);
+
+			g_free(timeStamp);
+			g_free(outMsg);
+		}
+	}
+	else
+	{
+		/* no RB, keep going */
+		DbgPrint("%s: %s doesnt have ring buffer, not flushing", __FUNCTION__, keyContextP->contextName);
+	}
+
+	return FALSE;
+}
+
+/**
+ * @brief ParseMsgTag
+ * Parse identifier which indicates whether current log
+ * is from pmloglib.
+ *
+ * @param msg message to parse
+ */
+static
+const char *ParseMsgTag(const char *msg)
+{
+	size_t tagLength = strlen(PMLOG_IDENTIFIER) + 1; // tag + space
+
+	if ((strlen(msg) < tagLength)  ||
+	        (strncmp(msg, PMLOG_IDENTIFIER " ", tagLength) != 0))
+	{
+		return NULL;    // Does not start with tag
+	}
+
+	return msg + tagLength;
+}
+
+#ifdef RDX_LOG_REPORTING
+
+/* maximum number of reports waiting for the heavy operation thread */
+#define RDX_MAX_PENDING_REPORTS     4
+
+/* fingerprints remembered before pruning the expired ones */
+#define RDX_MAX_FINGERPRINTS        256
+
+/* longest part of a message used for its fingerprint */
+#define RDX_FINGERPRINT_LEN         200
+
+typedef struct
+{
+	/* last messages logged, newest at the tail */
+	GQueue      recentLines;
+
+	/* fingerprint => monotonic time of its last report, in seconds */
+	GHashTable *lastReports;
+
+	/* start of the current hour and reports made since */
+	gint64      budgetStart;
+	int         budgetUsed;
+
+	/* reports queued but not made yet */
+	gint        pending;
+}
+RdxReporter_t;
+
+static RdxReporter_t g_rdxReporter;
+
+#endif
+
+typedef struct _RdxReportTask
+{
+	int pri;
+	gchar *programName;
+	gchar *msg;
+} RdxReportTask;
+
+RdxReportTask *CreateRdxReportTask(int pri, const char *programName, const char *msg)
+{
+	RdxReportTask *ret = g_new0(RdxReportTask, 1);
+	ret->pri = pri;
+	ret->programName = g_strdup(programName);
+	ret->msg = g_strdup(msg);
+	return ret;
+}
+
+void DeleteRdxReportTask(RdxReportTask *task)
+{
+	g_free(task->programName);
+	task->programName = NULL;
+
+	g_free(task->msg);
+	task->msg = NULL;
+
+	g_free(task);
+}
+
+gboolean RdxLogReport(gpointer userdata)
+{
+	RdxReportTask *task = (RdxReportTask *)userdata;
+
+	RdxReportMetadata md = create_rdx_report_metadata();
+	rdx_report_metadata_set_component(md, "syslog");
+	const char *cause;
+
+	switch ((task->pri & LOG_PRIMASK))
+	{
+		case LOG_EMERG:
+			cause = "LOG_EMERG";
+			break;
+
+		case LOG_ALERT:
+			cause = "LOG_ALERT";
+			break;
+
+		case LOG_CRIT:
+			cause = "LOG_CRIT";
+			break;
+
+		case LOG_ERR:
+			cause = "LOG_ERR";
+			break;
+
+		case LOG_WARNING:
+			cause = "LOG_WARNING";
+			break;
+
+		case LOG_NOTICE:
+			cause = "LOG_NOTICE";
+			break;
+
+		case LOG_INFO:
+			cause = "LOG_INFO";
+			break;
+
+		case LOG_DEBUG:
+			cause = "LOG_DEBUG";
+			break;
+
+		default:
+			cause = "UNKNOWN";
+	}
+
+	rdx_report_metadata_set_cause(md, cause);
+	rdx_report_metadata_set_detail(md, task->programName);
+	rdx_make_report(md, task->msg);
+	destroy_rdx_report_metadata(md);
+
+	DeleteRdxReportTask(task);
+
+#ifdef RDX_LOG_REPORTING
+	g_atomic_int_add(&g_rdxReporter.pending, -1);
+#endif
+
+	return FALSE;
+}
+
+#ifdef RDX_LOG_REPORTING
+
+static const char *const kRdxDefaultBlacklist[] =
+{
+	"rdxd", "uploadd", "pmsyslogd", "upstart", NULL
+};
+
+/**
+ * @brief RdxReporterInit
+ *
+ * Set up the report state, once the configuration is read.
+ */
+static void RdxReporterInit(void)
+{
+	int i;
+
+	if (g_rdxBlacklist == NULL)
+	{
+		g_rdxBlacklist = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		                                       NULL);
+
+		for (i = 0; kRdxDefaultBlacklist[ i ] != NULL; i++)
+		{
+			g_hash_table_add(g_rdxBlacklist, g_strdup(kRdxDefaultBlacklist[ i ]));
+		}
+	}
+
+	g_queue_init(&g_rdxReporter.recentLines);
+	g_rdxReporter.lastReports = g_hash_table_new_full(g_str_hash, g_str_equal,
+	                                                  g_free, g_free);
+	g_rdxReporter.budgetStart = getMonotonicTime();
+}
+
+/**
+ * @brief RdxFingerprint
+ *
+ * Identify a message regardless of the numbers in it (pids, addresses,
+ * counters...), so a crash loop is reported once.
+ *
+ * @param programName
+ * @param msg
+ *
+ * @return newly allocated fingerprint
+ */
+static gchar *RdxFingerprint(const char *programName, const char *msg)
+{
+	GString    *fp = g_string_new(programName);
+	const char *p;
+
+	g_string_append_c(fp, '|');
+
+	for (p = msg; *p && (p - msg) < RDX_FINGERPRINT_LEN; p++)
+	{
+		if (isdigit((unsigned char) *p))
+		{
+			/* collapse a run of digits */
+			if (fp->str[ fp->len - 1 ] != '#')
+			{
+				g_string_append_c(fp, '#');
+			}
+		}
+		else
+		{
+			g_string_append_c(fp, *p);
+		}
+	}
+
+	return g_string_free(fp, FALSE);
+}
+
+/**
+ * @brief RdxPruneReport
+ *
+ * GHRFunc dropping the fingerprints reported before the dedup window.
+ */
+static gboolean RdxPruneReport(gpointer key, gpointer value, gpointer data)
+{
+	return *(gint64 *) value <= *(gint64 *) data;
+}
+
+/**
+ * @brief RdxShouldReport
+ *
+ * Apply the blacklist, the dedup window, the hourly budget and the
+ * bound on pending reports.
+ *
+ * @param programName
+ * @param msg
+ *
+ * @return true if the message is to be reported
+ */
+static bool RdxShouldReport(const char *programName, const char *msg)
+{
+	gint64  now = getMonotonicTime();
+	gint64  expired;
+	gint64 *last;
+	gchar  *fp;
+
+	if (g_hash_table_contains(g_rdxBlacklist, programName))
+	{
+		return false;
+	}
+
+	fp = RdxFingerprint(programName, msg);
+	last = g_hash_table_lookup(g_rdxReporter.lastReports, fp);
+
+	if (last && (now - *last < g_rdxDedupWindow))
+	{
+		DbgPrint("%s: duplicate of a recent report\n", __FUNCTION__);
+		g_free(fp);
+		return false;
+	}
+
+	if (now - g_rdxReporter.budgetStart >= 3600)
+	{
+		g_rdxReporter.budgetStart = now;
+		g_rdxReporter.budgetUsed = 0;
+	}
+
+	if ((g_rdxReporter.budgetUsed >= g_rdxReportsPerHour) ||
+	        (g_atomic_int_get(&g_rdxReporter.pending) >= RDX_MAX_PENDING_REPORTS))
+	{
+		DbgPrint("%s: report budget exhausted\n", __FUNCTION__);
+		g_free(fp);
+		return false;
+	}
+
+	if (g_hash_table_size(g_rdxReporter.lastReports) >= RDX_MAX_FINGERPRINTS)
+	{
+		expired = now - g_rdxDedupWindow;
+		g_hash_table_foreach_remove(g_rdxReporter.lastReports, RdxPruneReport,
+		                            &expired);
+	}
+
+	last = g_new(gint64, 1);
+	*last = now;
+	g_hash_table_replace(g_rdxReporter.lastReports, fp, last);
+
+	g_rdxReporter.budgetUsed++;
+
+	return true;
+}
+
+/**
+ * @brief RdxReportMessage
+ *
+ * Keep the message as context for later reports, and report it if it
+ * is critical or worse.  The report is made on the heavy operation
+ * thread.
+ *
+ * @param pri
+ * @param programName
+ * @param line the message as written to the log
+ */
+static void RdxReportMessage(int pri, const char *programName,
+                             const char *line)
+{
+	GString *report;
+	GList   *l;
+
+	if (g_rdxContextLines > 0)
+	{
+		g_queue_push_tail(&g_rdxReporter.recentLines, g_strdup(line));
+
+		while (g_queue_get_length(&g_rdxReporter.recentLines) >
+		        (guint) g_rdxContextLines)
+		{
+			g_free(g_queue_pop_head(&g_rdxReporter.recentLines));
+		}
+	}
+
+	if (((pri & LOG_PRIMASK) > LOG_CRIT) || !RdxShouldReport(programName, line))
+	{
+		return;
+	}
+
+	/* the recent lines end with this one */
+	report = g_string_new(NULL);
+
+	for (l = g_rdxReporter.recentLines.head; l != NULL; l = l->next)
+	{
+		g_string_append(report, l->data);
+	}
+
+	if (g_rdxContextLines <= 0)
+	{
+		g_string_append(report, line);
+	}
+
+	g_atomic_int_inc(&g_rdxReporter.pending);
+	AddHeavyOperationTask(&heavyOperationThread, RdxLogReport,
+	                      CreateRdxReportTask(pri, programName, report->str));
+	g_string_free(report, TRUE);
+}
+
+#endif
+
+
+/* a message between the receiving and the routing of the log pipeline */
+typedef struct _LogRecord
+{
+	guint64         seq;
+	int             pri;
+	struct timeval  time;
+
+	/* monotonic seconds at that time, -1 if unknown */
+	time_t          monoTime;
+
+	/* datagram as received, until parsed */
+	gchar          *raw;
+	int             rawLen;
+
+	/* formatted line, as written to the outputs; NULL if the message
+	 * is dropped */
+	GString        *outMsg;
+	char            priStr[ 20 ];
+	char            programName[ PMLOG_PROGRAM_MAX_NAME_LENGTH + 1 ];
+	char            contextName[ PMLOG_MAX_CONTEXT_NAME_LEN + 1 ];
+#ifdef PRODUCTION_BUILD
+	char            msgid[ MAX_MSGID_LEN + 1];
+#endif
+
+	/* context given by id, else looked up by name when routing */
+	PmLogContextConf_t *contextConfP;
+
+	/* true if the levels kept for the message were not cached yet */
+	bool            wantMiss;
+
+	/* descriptor passed along with the message, owned by the record */
+	bool            hasAttachment;
+	int             attachFd;
+
+	/* "!log" command to run instead of logging, if any */
+	gchar          *command;
+} LogRecord;
+
+/**
+ * @brief LogRecordClear
+ *
+ * @param rec
+ */
+static void LogRecordClear(LogRecord *rec)
+{
+	if (rec->outMsg)
+	{
+		g_string_free(rec->outMsg, true);
+		rec->outMsg = NULL;
+	}
+
+	g_free(rec->raw);
+	rec->raw = NULL;
+	g_free(rec->command);
+	rec->command = NULL;
+
+	if (rec->hasAttachment)
+	{
+		close(rec->attachFd);
+		rec->hasAttachment = false;
+	}
+}
+
+/**********************************************************************
+ *  Early discard
+ *
+ *  Most debug messages match no rule: they are dropped right after
+ *  their header is parsed, before the line is formatted.  Whether
+ *  anything keeps the messages of a facility, context and program is
+ *  cached as a bit per level.  Entries are only filled on the main
+ *  thread, which owns the contexts, when routing a message that missed;
+ *  parsers on any thread only look them up.
+ **********************************************************************/
+
+/* entries kept before starting over, programs come from the clients */
+#define WANT_CACHE_MAX_ENTRIES  4096
+
+/* set in the entries, as a 0 mask is a valid one */
+#define WANT_CACHE_FILLED       0x100
+
+static struct
+{
+	GMutex          lock;
+
+	/* "facility|context|program" to the levels kept */
+	GHashTable     *levels;
+
+	/* messages dropped before formatting, read by getStats */
+	volatile gint   discarded;
+} g_wantCache;
+
+/**
+ * @brief WantCacheKey
+ *
+ * @param rec with its priority, context and program parsed
+ * @param key
+ * @param size
+ */
+static void WantCacheKey(const LogRecord *rec, char *key, size_t size)
+{
+	snprintf(key, size, "%d|%s|%s", rec->pri & LOG_FACMASK, rec->contextName,
+	         rec->programName);
+}
+
+/**
+ * @brief WantCacheClear
+ *
+ * Forget the cached levels after a context changed.  Main thread only.
+ */
+static void WantCacheClear(void)
+{
+	g_mutex_lock(&g_wantCache.lock);
+
+	if (g_wantCache.levels)
+	{
+		g_hash_table_remove_all(g_wantCache.levels);
+	}
+
+	g_mutex_unlock(&g_wantCache.lock);
+}
+
+/**
+ * @brief LogRecordWanted
+ *
+ * Parsers: tell whether the message may be kept.  rec->wantMiss is set
+ * if that is not known yet, for the main thread to find out.
+ *
+ * @param rec with its priority, context and program parsed
+ *
+ * @return false to drop the message
+ */
+static bool LogRecordWanted(LogRecord *rec)
+{
+	char    key[ 16 + sizeof(rec->contextName) + sizeof(rec->programName) ];
+	guint   levels = 0;
+
+	WantCacheKey(rec, key, sizeof(key));
+
+	g_mutex_lock(&g_wantCache.lock);
+
+	if (g_wantCache.levels)
+	{
+		levels = GPOINTER_TO_UINT(g_hash_table_lookup(g_wantCache.levels, key));
+	}
+
+	g_mutex_unlock(&g_wantCache.lock);
+
+	if (!(levels & WANT_CACHE_FILLED))
+	{
+		rec->wantMiss = true;
+		return true;
+	}
+
+	if (levels & (1 << (rec->pri & LOG_PRIMASK)))
+	{
+		return true;
+	}
+
+	g_atomic_int_inc(&g_wantCache.discarded);
+
+	return false;
+}
+
+/**
+ * @brief ContextWantedLevels
+ *
+ * Levels that RouteLogRecord keeps for the messages of a context,
+ * facility and program.  Main thread only.
+ *
+ * @param contextConfP NULL if the context is unknown and there is no
+ * default one
+ * @param facility
+ * @param programName
+ *
+ * @return a bit per level
+ */
+static guint ContextWantedLevels(const PmLogContextConf_t *contextConfP, int facility,
+                                 const char *programName)
+{
+	bool    wantOutput[ PMLOG_MAX_NUM_OUTPUTS ];
+	guint   levels = 0;
+	int     lvl;
+
+	if (!contextConfP)
+	{
+		return 0;
+	}
+
+	for (lvl = LOG_EMERG; lvl <= LOG_DEBUG; lvl++)
+	{
+		if (contextConfP->override.hasLevel && (lvl > contextConfP->override.level))
+		{
+			continue;
+		}
+
+		if ((contextConfP->rb && !contextConfP->override.bypassRB) ||
+		        SelectOutputs(contextConfP, facility | lvl, programName, wantOutput))
+		{
+			levels |= 1 << lvl;
+		}
+
+#ifdef RDX_LOG_REPORTING
+
+		/* critical messages are reported, along with the recent lines */
+		if ((g_rdxContextLines > 0) || (lvl <= LOG_CRIT))
+		{
+			levels |= 1 << lvl;
+		}
+
+#endif
+	}
+
+	return levels;
+}
+
+/**
+ * @brief WantCacheFill
+ *
+ * Main thread: cache the levels kept for a message that missed.
+ *
+ * @param rec
+ * @param contextConfP the context it is routed to, NULL if none
+ */
+static void WantCacheFill(const LogRecord *rec, const PmLogContextConf_t *contextConfP)
+{
+	char    key[ 16 + sizeof(rec->contextName) + sizeof(rec->programName) ];
+	guint   levels;
+
+	WantCacheKey(rec, key, sizeof(key));
+	levels = ContextWantedLevels(contextConfP, rec->pri & LOG_FACMASK, rec->programName);
+
+	g_mutex_lock(&g_wantCache.lock);
+
+	if (!g_wantCache.levels)
+	{
+		g_wantCache.levels = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	}
+
+	if (g_hash_table_size(g_wantCache.levels) >= WANT_CACHE_MAX_ENTRIES)
+	{
+		g_hash_table_remove_all(g_wantCache.levels);
+	}
+
+	g_hash_table_replace(g_wantCache.levels, g_strdup(key),
+	                     GUINT_TO_POINTER(levels | WANT_CACHE_FILLED));
+
+	g_mutex_unlock(&g_wantCache.lock);
+}
+
+/**
+ * @brief ParseLogRecord
+ * Parse the message and format the line to log, unless nothing would
+ * keep it (see LogRecordWanted).  May run on any thread.
+ *
+ * @param rec record with the priority and time of the message
+ * @param msg message to log
+ */
+static void ParseLogRecord(LogRecord *rec, const char *msg)
+{
+	size_t          msgLen;
+	gchar          *timeStamp = NULL;
+	char            msgProgram[ 256 ];
+	const char     *msgLeft;
+	const char     *msgCurr;
+	const char     *msgNext;
+	size_t          msgProgramNameLen;
+
+	/*
+	 * Remove timestamp prefix if present. Local messages should have this, remote may not.
+	 * Check for RFC 3164 timestamp  0123456789ABCDEF0 "Mmm dd hh:mm:ss " and remove it
+	 */
+	msgLen = strlen(msg);
+
+	if ((msgLen >= 16) &&
+	        (msg[ 3 ] == ' ') &&
+	        isdigit(msg[ 5 ]) &&
+	        (msg[ 6 ] == ' ') &&
+	        isdigit(msg[ 8 ]) &&
+	        (msg[ 9 ] == ':') &&
+	        isdigit(msg[ 10 ]) &&
+	        isdigit(msg[ 11 ]) &&
+	        (msg[ 12 ] == ':') &&
+	        isdigit(msg[ 13 ]) &&
+	        isdigit(msg[ 14 ]) &&
+	        (msg[ 15 ] == ' '))
+	{
+		msg += 16;
+		msgLen -= 16;
+	}
+
+	msgProgram[ 0 ] = 0;
+	rec->programName[ 0 ] = 0;
+	rec->contextName[ 0 ] = 0;
+
+	/*
+	 * msgLeft is what will actually be written to the file (possibly
+	 * after stripping some stuff off from msg prefix)
+	 */
+	msgLeft = msg; // eg "progName contextName rest_of_msg..."
+
+	/* parse off program identifier prefix */
+	msgNext = ParseMsgProgram(msgLeft, msgProgram, sizeof(msgProgram),
+	                          &msgProgramNameLen, rec->programName,
+	                          sizeof(rec->programName));
+
+	if (msgNext != NULL)
+	{
+		msgLeft = msgNext; /* eg "contextName rest_of_msg..." */
+	}
+
+	/* msgCurr is where we're at in parsing */
+	msgCurr = msgLeft;
+
+	/* parse off PmLogLib pid/tid prefix */
+	msgNext = ParseMsgPidTid(msgCurr);
+
+	if (msgNext != NULL)
+	{
+		/* integrate into msgProgram */
+		snprintf(msgProgram + msgProgramNameLen + 1,
+		         sizeof(msgProgram) - msgProgramNameLen + 1, "%.*s",
+		         msgNext - msgCurr, msgCurr);
+
+		msgLeft = msgNext;
+		msgCurr = msgNext;
+	}
+
+	/* Recognization for PMLOG_IDENTIFIER*/
+	msgNext = ParseMsgTag(msgCurr);
+
+	if (!msgNext)
+	{
+		// not from pmloglib
+		strcpy(rec->contextName, LEGACY_LOG);
+	}
+	else
+	{
+		// from pmloglib
+		msgCurr = msgNext;
+		msgLeft = msgNext;
+		/* parse off PmLogLib context identifier prefix (if present) */
+		msgNext = ParseMsgContext(msgCurr, rec->contextName,
+		                          sizeof(rec->contextName));
+
+		if (msgNext != NULL)
+		{
+			msgCurr = msgNext;
+		}
+	}
+
+	/* commands are run in order with the messages, when routing */
+	if (strncmp(msgCurr, "!log ", 5) == 0)
+	{
+		rec->command = g_strdup(msgCurr);
+	}
+	else if (!LogRecordWanted(rec))
+	{
+		return;
+	}
+
+	rec->outMsg = g_string_sized_new(MAXLINE + 1);
+	timeStamp = FormatMessageTimestamp(&rec->time, rec->monoTime);
+
+	/* look up facility + priority name from pri */
+	FormatPri(rec->pri, rec->priStr, sizeof(rec->priStr));
+
+	g_string_printf(rec->outMsg, "%s %s ", timeStamp, rec->priStr);
+
+	g_free(timeStamp);
+
+	rec->outMsg = g_string_append(rec->outMsg, msgProgram); /* e.g "uploadd \0" */
+	rec->outMsg = g_string_append(rec->outMsg, msgLeft); /* "context msgid kvpair message" */
+	rec->outMsg = g_string_append(rec->outMsg,
+	                              "\n"); /* e.g "2008-12-08T12:17:12.824279Z [1824] user.info uploadd uploadd msgid kvpairs msg... \n" */
+
+#ifdef PRODUCTION_BUILD
+	(void) ParseMsgID(++msgCurr, rec->msgid, sizeof(rec->msgid));
+#endif
+}
+
+/**
+ * @brief SanitizePri
+ *
+ * @param pri as sent by the client
+ *
+ * @return pri, or user.notice if invalid
+ */
+static int SanitizePri(int pri)
+{
+	if ((pri & LOG_FACMASK) == PMLOGDAEMON_LOG_KERN)
+	{
+		pri = (pri & (~LOG_FACMASK)) | LOG_KERN;
+	}
+
+	if (pri & ~(LOG_FACMASK | LOG_PRIMASK))
+	{
+		pri = LOG_USER | LOG_NOTICE;
+	}
+
+	return pri;
+}
+
+/**
+ * @brief SanitizeAppend
+ *
+ * Append a field of a binary message with printable characters, as
+ * SanitizeMessage does for text messages.
+ *
+ * @param out
+ * @param in
+ * @param inLen stops at a NUL character before
+ * @param budgetP bytes left for the line, updated
+ */
+static void SanitizeAppend(GString *out, const char *in, size_t inLen,
+                           size_t *budgetP)
+{
+	unsigned char   c;
+	size_t          i;
+
+	for (i = 0; (i < inLen) && ((c = (unsigned char) in[ i ]) != 0); i++)
+	{
+		if ((c == '\n') || (c == 127))
+		{
+			c = ' ';
+		}
+
+		if (c < 0x20)
+		{
+			if (*budgetP < 2)
+			{
+				break;
+			}
+
+			/* escape control characters as printable, 0x07 => ^G, etc */
+			g_string_append_c(out, '^');
+			g_string_append_c(out, (gchar)(c ^ 0x40));
+			*budgetP -= 2;
+		}
+		else
+		{
+			if (*budgetP < 1)
+			{
+				break;
+			}
+
+			g_string_append_c(out, (gchar) c);
+			*budgetP -= 1;
+		}
+	}
+}
+
+/* binary messages parsed, for getStats */
+typedef struct
+{
+	gint        parsed;
+
+	/* logged in the default context, their id being outdated */
+	gint        staleContextIds;
+
+	/* dropped as malformed */
+	gint        rejected;
+} BinaryMessageStats;
+
+static BinaryMessageStats g_binaryStats;
+
+/**
+ * @brief IsBinaryMessage
+ *
+ * @param buff
+ * @param buffLen
+ *
+ * @return true if the message is a binary one, see binmsg.h
+ */
+static bool IsBinaryMessage(const char *buff, int buffLen)
+{
+	return (buffLen >= (int) sizeof(PmLogBinHeader_t)) &&
+	       (memcmp(buff, PMLOG_BIN_MAGIC, PMLOG_BIN_MAGIC_LEN) == 0);
+}
+
+/**
+ * @brief ParseBinaryFields
+ *
+ * @param buff the binary message
+ * @param buffLen
+ * @param fields receives the start of each field
+ * @param fieldLens receives the length of each field
+ *
+ * @return false if the message is malformed
+ */
+static bool ParseBinaryFields(const char *buff, int buffLen,
+                              const char *fields[ PMLOG_BIN_NUM_FIELDS ],
+                              guint16 fieldLens[ PMLOG_BIN_NUM_FIELDS ])
+{
+	const char *p = buff + sizeof(PmLogBinHeader_t);
+	const char *end = buff + buffLen;
+	int         i;
+
+	if (((const PmLogBinHeader_t *) buff)->version != PMLOG_BIN_VERSION)
+	{
+		return false;
+	}
+
+	for (i = 0; i < PMLOG_BIN_NUM_FIELDS; i++)
+	{
+		if (end - p < (ptrdiff_t) sizeof(guint16))
+		{
+			return false;
+		}
+
+		memcpy(&fieldLens[ i ], p, sizeof(guint16));
+		p += sizeof(guint16);
+
+		if (end - p < (ptrdiff_t) fieldLens[ i ])
+		{
+			return false;
+		}
+
+		fields[ i ] = p;
+		p += fieldLens[ i ];
+	}
+
+	return true;
+}
+
+/**
+ * @brief ParseBinaryRecord
+ * Format the line to log from the fields of a binary message, which
+ * need no parsing, unless nothing would keep it.  May run on any
+ * thread.  The line is the one ParseLogRecord makes of the same message
+ * sent as text.
+ *
+ * @param rec record with the time of the message
+ * @param buff the binary message
+ * @param buffLen
+ */
+static void ParseBinaryRecord(LogRecord *rec, const char *buff, int buffLen)
+{
+	PmLogBinHeader_t    header;
+	const char         *fields[ PMLOG_BIN_NUM_FIELDS ];
+	guint16             fieldLens[ PMLOG_BIN_NUM_FIELDS ];
+	gchar              *timeStamp;
+	size_t              budget = MAXLINE;
+
+	if (!ParseBinaryFields(buff, buffLen, fields, fieldLens))
+	{
+		g_atomic_int_inc(&g_binaryStats.rejected);
+		return;
+	}
+
+	memcpy(&header, buff, sizeof(header));
+	rec->pri = SanitizePri(header.pri);
+	g_atomic_int_inc(&g_binaryStats.parsed);
+
+	if (header.contextId && (header.contextEpoch == g_contextEpoch) &&
+	        (header.contextId <= (guint32) g_numContextIds))
+	{
+		rec->contextConfP = g_contextsById[ header.contextId - 1 ];
+		g_strlcpy(rec->contextName, rec->contextConfP->contextName,
+		          sizeof(rec->contextName));
+	}
+	else
+	{
+		/* e.g. mapped before a restart: looked up by name */
+		if (header.contextId)
+		{
+			g_atomic_int_inc(&g_binaryStats.staleContextIds);
+		}
+
+		memcpy(rec->contextName, fields[ 1 ],
+		       MIN(fieldLens[ 1 ], sizeof(rec->contextName) - 1));
+	}
+
+	memcpy(rec->programName, fields[ 0 ],
+	       MIN(fieldLens[ 0 ], sizeof(rec->programName) - 1));
+#ifdef PRODUCTION_BUILD
+	memcpy(rec->msgid, fields[ 2 ], MIN(fieldLens[ 2 ], sizeof(rec->msgid) - 1));
+#endif
+
+	if (!LogRecordWanted(rec))
+	{
+		return;
+	}
+
+	rec->outMsg = g_string_sized_new(MAXLINE + 1);
+	timeStamp = FormatMessageTimestamp(&rec->time, rec->monoTime);
+	FormatPri(rec->pri, rec->priStr, sizeof(rec->priStr));
+	g_string_printf(rec->outMsg, "%s %s ", timeStamp, rec->priStr);
+	g_free(timeStamp);
+
+	SanitizeAppend(rec->outMsg, fields[ 0 ], fieldLens[ 0 ], &budget);
+	g_string_append_c(rec->outMsg, ' ');
+
+	if ((header.flags & PMLOG_BIN_HAS_PID) && (header.flags & PMLOG_BIN_HAS_TID))
+	{
+		g_string_append_printf(rec->outMsg, "[%u:%u] ", header.pid, header.tid);
+	}
+	else if (header.flags & PMLOG_BIN_HAS_PID)
+	{
+		g_string_append_printf(rec->outMsg, "[%u] ", header.pid);
+	}
+
+	if (rec->contextName[ 0 ])
+	{
+		SanitizeAppend(rec->outMsg, rec->contextName, sizeof(rec->contextName),
+		               &budget);
+		g_string_append_c(rec->outMsg, ' ');
+	}
+
+	if (fieldLens[ 2 ])
+	{
+		SanitizeAppend(rec->outMsg, fields[ 2 ], fieldLens[ 2 ], &budget);
+		g_string_append_c(rec->outMsg, ' ');
+	}
+
+	SanitizeAppend(rec->outMsg, fields[ 3 ], fieldLens[ 3 ], &budget);
+	g_string_append_c(rec->outMsg, '\n');
+}
+
+/**********************************************************************
+ *  Attachments
+ *
+ *  A client may pass a sealed memfd along with a message, for a payload
+ *  too large for a datagram (a crash dump excerpt, a JSON blob...).  It
+ *  is copied to a file of ATTACHMENTS_DIR on the heavy operation thread,
+ *  and the log line names that file.  The oldest files are removed to
+ *  stay within ATTACHMENTS_BUDGET.
+ **********************************************************************/
+
+#define ATTACHMENTS_DIR         WEBOS_INSTALL_LOGDIR "/attachments"
+
+/* largest attachment stored */
+#define ATTACHMENT_MAX_SIZE     (1024 * 1024)
+
+/* bytes kept in ATTACHMENTS_DIR */
+#define ATTACHMENTS_BUDGET      (8 * 1024 * 1024)
+
+/* the client can't change the content once passed */
+#define ATTACHMENT_SEALS        (F_SEAL_SHRINK | F_SEAL_WRITE)
+
+typedef struct _Attachment
+{
+	gchar  *name;
+	gsize   size;
+} Attachment;
+
+typedef struct _AttachmentCopyTask
+{
+	int     fd;
+	gsize   size;
+	gchar  *path;
+} AttachmentCopyTask;
+
+/* updated by the main thread, counters also read by getStats */
+static struct
+{
+	/* stored files, oldest first */
+	GQueue          stored;
+	guint           seq;
+	volatile gint   numStored;
+	volatile gint   bytes;
+	volatile gint   dropped;
+} g_attachments = { G_QUEUE_INIT, 0, 0, 0, 0 };
+
+/**
+ * @brief AttachmentFree
+ *
+ * @param data
+ */
+static void AttachmentFree(gpointer data)
+{
+	Attachment *attachment = data;
+
+	g_free(attachment->name);
+	g_free(attachment);
+}
+
+/**
+ * @brief AttachmentCompare
+ *
+ * Names start with the time they were stored, so this is oldest first.
+ *
+ * @param a
+ * @param b
+ * @param data
+ *
+ * @return as strcmp
+ */
+static gint AttachmentCompare(gconstpointer a, gconstpointer b, gpointer data)
+{
+	return strcmp(((const Attachment *) a)->name, ((const Attachment *) b)->name);
+}
+
+/**
+ * @brief AttachmentCopy
+ *
+ * Heavy operation thread: write the content of the memfd to its file.
+ *
+ * @param userdata AttachmentCopyTask
+ *
+ * @return FALSE
+ */
+static gboolean AttachmentCopy(gpointer userdata)
+{
+	AttachmentCopyTask *task = userdata;
+	gchar              *tmpPath = g_strconcat(task->path, ".tmp", NULL);
+	const char         *map = MAP_FAILED;
+	gsize               done = 0;
+	ssize_t             n = 0;
+	int                 fd = -1;
+
+	(void) g_mkdir_with_parents(ATTACHMENTS_DIR, 0755);
+
+	if (task->size > 0)
+	{
+		map = mmap(NULL, task->size, PROT_READ, MAP_PRIVATE, task->fd, 0);
+	}
+
+	if (((task->size > 0) && (map == MAP_FAILED)) ||
+	        ((fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0))
+	{
+		ErrPrint("%s: failed to copy %s: %s\n", __FUNCTION__, task->path,
+		         strerror(errno));
+		goto out;
+	}
+
+	while (done < task->size)
+	{
+		n = write(fd, map + done, task->size - done);
+
+		if (n > 0)
+		{
+			done += (gsize) n;
+		}
+		else if ((n == 0) || (errno != EINTR))
+		{
+			break;
+		}
+	}
+
+	close(fd);
+
+	if ((done < task->size) || (rename(tmpPath, task->path) != 0))
+	{
+		ErrPrint("%s: failed to write %s: %s\n", __FUNCTION__, task->path,
+		         strerror(errno));
+		(void) unlink(tmpPath);
+	}
+
+out:
+
+	if (map != MAP_FAILED)
+	{
+		(void) munmap((void *) map, task->size);
+	}
+
+	close(task->fd);
+	g_free(tmpPath);
+	g_free(task->path);
+	g_free(task);
+
+	return FALSE;
+}
+
+/**
+ * @brief AttachmentRemove
+ *
+ * Heavy operation thread: remove a file, after its copy as tasks run in
+ * order.
+ *
+ * @param userdata path, freed
+ *
+ * @return FALSE
+ */
+static gboolean AttachmentRemove(gpointer userdata)
+{
+	gchar *path = userdata;
+
+	if ((unlink(path) != 0) && (errno != ENOENT))
+	{
+		ErrPrint("%s: failed to remove %s: %s\n", __FUNCTION__, path, strerror(errno));
+	}
+
+	g_free(path);
+
+	return FALSE;
+}
+
+/**
+ * @brief AttachmentsEvict
+ *
+ * Remove the oldest files until the budget leaves room for size bytes.
+ *
+ * @param size
+ */
+static void AttachmentsEvict(gsize size)
+{
+	Attachment *attachment;
+
+	while (((gsize) g_attachments.bytes + size > ATTACHMENTS_BUDGET) &&
+	        ((attachment = g_queue_pop_head(&g_attachments.stored)) != NULL))
+	{
+		g_atomic_int_add(&g_attachments.bytes, -(gint) attachment->size);
+		g_atomic_int_add(&g_attachments.numStored, -1);
+		AddHeavyOperationTask(&heavyOperationThread, AttachmentRemove,
+		                      g_build_filename(ATTACHMENTS_DIR, attachment->name, NULL));
+		AttachmentFree(attachment);
+	}
+}
+
+/**
+ * @brief AttachmentsInit
+ *
+ * Account for the files stored by a previous instance.
+ */
+static void AttachmentsInit(void)
+{
+	Attachment  *attachment;
+	GDir        *dir;
+	const gchar *name;
+	gchar       *path;
+	struct stat  st;
+
+	dir = g_dir_open(ATTACHMENTS_DIR, 0, NULL);
+
+	if (!dir)
+	{
+		return;
+	}
+
+	while ((name = g_dir_read_name(dir)) != NULL)
+	{
+		path = g_build_filename(ATTACHMENTS_DIR, name, NULL);
+
+		if (g_str_has_suffix(name, ".tmp"))
+		{
+			(void) unlink(path);
+		}
+		else if ((lstat(path, &st) == 0) && S_ISREG(st.st_mode))
+		{
+			attachment = g_new0(Attachment, 1);
+			attachment->name = g_strdup(name);
+			attachment->size = (gsize) st.st_size;
+			g_atomic_int_add(&g_attachments.bytes, (gint) attachment->size);
+			g_atomic_int_inc(&g_attachments.numStored);
+			g_queue_insert_sorted(&g_attachments.stored, attachment,
+			                      AttachmentCompare, NULL);
+		}
+
+		g_free(path);
+	}
+
+	g_dir_close(dir);
+
+	AttachmentsEvict(0);
+}
+
+/**
+ * @brief AttachmentCheck
+ *
+ * @param fd
+ * @param size set to the size of the content
+ *
+ * @return NULL if the attachment can be stored, else why not
+ */
+static const char *AttachmentCheck(int fd, gsize *size)
+{
+	struct stat st;
+	int         seals = fcntl(fd, F_GET_SEALS);
+
+	if ((seals < 0) || ((seals & ATTACHMENT_SEALS) != ATTACHMENT_SEALS))
+	{
+		return "not a sealed memfd";
+	}
+
+	if ((fstat(fd, &st) != 0) || !S_ISREG(st.st_mode))
+	{
+		return "not a file";
+	}
+
+	if (st.st_size > ATTACHMENT_MAX_SIZE)
+	{
+		return "too large";
+	}
+
+	*size = (gsize) st.st_size;
+
+	return NULL;
+}
+
+/**
+ * @brief AttachmentAccept
+ *
+ * Main thread: store the attachment of a message being logged, and name
+ * it in the line.
+ *
+ * @param rec
+ */
+static void AttachmentAccept(LogRecord *rec)
+{
+	AttachmentCopyTask *task;
+	Attachment         *attachment;
+	const char         *reason;
+	gchar              *note;
+	gchar              *p;
+	gsize               size = 0;
+	gsize               pos;
+
+	if (!rec->hasAttachment)
+	{
+		return;
+	}
+
+	reason = AttachmentCheck(rec->attachFd, &size);
+
+	if (reason)
+	{
+		g_atomic_int_inc(&g_attachments.dropped);
+		note = g_strdup_printf(" [attachment dropped: %s]", reason);
+	}
+	else
+	{
+		AttachmentsEvict(size);
+
+		attachment = g_new0(Attachment, 1);
+		attachment->name = g_strdup_printf("%010ld-%04u-%s", (long) rec->time.tv_sec,
+		                                   g_attachments.seq++ % 10000, rec->programName);
+		attachment->size = size;
+
+		/* the program name comes from the client */
+		for (p = attachment->name; *p; p++)
+		{
+			if (!g_ascii_isalnum(*p) && (*p != '.') && (*p != '_') && (*p != '-'))
+			{
+				*p = '_';
+			}
+		}
+
+		g_atomic_int_add(&g_attachments.bytes, (gint) size);
+		g_atomic_int_inc(&g_attachments.numStored);
+		g_queue_push_tail(&g_attachments.stored, attachment);
+
+		task = g_new0(AttachmentCopyTask, 1);
+		task->fd = rec->attachFd;
+		task->size = size;
+		task->path = g_build_filename(ATTACHMENTS_DIR, attachment->name, NULL);
+		rec->hasAttachment = false;
+		AddHeavyOperationTask(&heavyOperationThread, AttachmentCopy, task);
+
+		note = g_strdup_printf(" [attachment %s, %lu bytes]", attachment->name,
+		                       (unsigned long) size);
+	}
+
+	pos = rec->outMsg->len;
+
+	if ((pos > 0) && (rec->outMsg->str[ pos - 1 ] == '\n'))
+	{
+		pos--;
+	}
+
+	g_string_insert(rec->outMsg, (gssize) pos, note);
+	g_free(note);
+}
+
+/**
+ * @brief RouteLogRecord
+ * Log a parsed message: ring buffers, outputs and reports.  Runs on the
+ * main thread, in the order the messages were received.
+ *
+ * @param rec
+ */
+static void RouteLogRecord(LogRecord *rec)
+{
+	gchar          *timeStamp = NULL;
+	int             pri = rec->pri;
+	GString        *outMsg = rec->outMsg;
+
+	if (!outMsg)
+	{
+		return;
+	}
+
+	if (rec->command && HandleLogCommand(rec->command))
+	{
+		return;
+	}
+
+	PmLogContextConf_t *contextConfP = rec->contextConfP;
+
+	/* look up the specified context */
+	if (!contextConfP && (rec->contextName[ 0 ] != 0))
+	{
+		contextConfP = g_tree_lookup(g_contextConfs, rec->contextName);
+	}
+
+	/* default to default context */
+	if (contextConfP == NULL)
+	{
+		contextConfP = g_tree_lookup(g_contextConfs, kPmLogDefaultContextName);
+	}
+
+	if (rec->wantMiss)
+	{
+		WantCacheFill(rec, contextConfP);
+	}
+
+	if (contextConfP == NULL)
+	{
+		DbgPrint("%s, default context not found!\n", __FUNCTION__);
+		return;
+	}
+
+	/* drop what is below the effective level set at runtime */
+	if (contextConfP->override.hasLevel &&
+	        ((pri & LOG_PRIMASK) > contextConfP->override.level))
+	{
+		return;
+	}
+
+#ifdef PRODUCTION_BUILD
+        char context_msgid_pair[MAXLINE];
+        context_msgid_pair[0] = '\0';   // ensures the memory is an empty string
+        strncat(context_msgid_pair, rec->contextName, sizeof(rec->contextName));
+        strncat(context_msgid_pair, "/", 1);
+        strncat(context_msgid_pair, rec->msgid, sizeof(rec->msgid));
+
+	if ((g_hash_table_lookup(whitelist_table, context_msgid_pair)) != NULL)
+	{
+		DbgPrint("Whitelisted: This message can be logged %s\n", context_msgid_pair);
+#endif
+		/* stored only for messages logged */
+		AttachmentAccept(rec);
+
+		/* Has ring buffer */
+		if (contextConfP->rb && !contextConfP->override.bypassRB)
+		{
+			DbgPrint("%s: %s has RB\n", __FUNCTION__, contextConfP->contextName);
+			int lvl = pri & LOG_PRIMASK;
+
+			if (lvl <= contextConfP->rb->flushLevel)
+			{
+				DbgPrint("%s: %s Flushing!\n", __FUNCTION__, contextConfP->contextName);
+
+				/* the history, the message and the markers in the lane of the message */
+				OutputForceLane(OutputLaneOf(pri));
+				g_tree_foreach(g_contextConfs, FlushNotMe, contextConfP);
+
+				timeStamp = MakeMessageTimestamp();
+				char priStr2[20];
+				char usageStr[80];
+				FormatPri(LOG_SYSLOG | LOG_INFO, priStr2, sizeof(priStr2));
+				gchar *flushMsg =
+				    g_strdup_printf("%s %s pmsyslogd: {%s}: ------ Flushing ring buffer for %s message ------\n",
+				                    timeStamp,
+				                    priStr2,
+			                            contextConfP->contextName,
+				                    rec->priStr);
+				g_free(timeStamp);
+				OutputMessage(contextConfP, pri, "pmsyslogd", flushMsg);
+
+				/* Flush */
+				FormatRBUsage(contextConfP->rb, usageStr, sizeof(usageStr));
+				RBFlush(contextConfP->rb, FlushMessage, contextConfP);
+				OutputMessage(contextConfP, pri, rec->programName, outMsg->str);
+				g_free(flushMsg);
+
+				timeStamp = MakeMessageTimestamp();
+				flushMsg =
+				    g_strdup_printf("%s %s pmsyslogd: {%s}: ------ Done flushing%s ------\n",
+				                    timeStamp,
+			                            priStr2,
+			                            contextConfP->contextName,
+				                    usageStr);
+				OutputMessage(contextConfP, pri, "pmsyslogd", flushMsg);
+				g_free(timeStamp);
+				g_free(flushMsg);
+
+				OutputForceLane(OUTPUT_NUM_LANES);
+			}
+			else
+			{
+				DbgPrint("%s: %s buffering!\n", __FUNCTION__, contextConfP->contextName);
+				/* buffer */
+				RBWrite(contextConfP->rb,
+				        (gint64) rec->time.tv_sec * G_USEC_PER_SEC + rec->time.tv_usec,
+				        pri, rec->programName, outMsg->str, (int) outMsg->len);
+			}
+		}
+		else
+		{
+			OutputMessage(contextConfP, pri, rec->programName, outMsg->str);
+		}
+
+#ifdef PRODUCTION_BUILD
+	}
+	else
+	{
+		DbgPrint("Blacklisted: Restrict logging this message %s\n", context_msgid_pair);
+	}
+#endif
+
+#ifdef RDX_LOG_REPORTING
+	/* RDX report */
+	RdxReportMessage(pri, rec->programName, outMsg->str);
+#endif
+}
+
+/**
+ * @brief LogMessage
+ * Log the message
+ *
+ * @param pri priority
+ * @param msg message to log
+ */
+static void LogMessage(int pri, const char *msg)
+{
+	LogRecord       rec;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.pri = pri;
+	(void) gettimeofday(&rec.time, NULL);
+	rec.monoTime = getMonotonicTime();
+
+	ParseLogRecord(&rec, msg);
+	RouteLogRecord(&rec);
+	LogRecordClear(&rec);
+}
+
+/**
+ * @brief SanitizeMessage
+ *
+ * Parse the priority of a message read off of the /dev/log socket and
+ * recreate its body with printable characters.
+ *
+ * @param buff the message, null-terminated
+ * @param line receives the body
+ * @param lineSize
+ *
+ * @return the priority
+ */
+static int SanitizeMessage(const char *buff, char *line, size_t lineSize)
+{
+	int             pri;
+	const char     *in;
+	char           *out;
+	unsigned char   c;
+
+	pri = LOG_USER | LOG_NOTICE;
+
+	in = buff;
+
+	/* If string starts with "<ddd>" parse the priority */
+	if (*in == '<')
+	{
+		in++;
+		pri = 0;
+
+		while (isdigit(*in))
+		{
+			pri = pri * 10 + *in - '0';
+			in++;
+		}
+
+		if (*in == '>')
+		{
+			in++;
+		}
+	}
+
+	pri = SanitizePri(pri);
+
+	out = line;
+
+	while ((c = *in++) != 0)
+	{
+		if (out >= &line[ lineSize - 1 ])
+		{
+			break;
+		}
+
+		if ((c == '\n') || (c == 127))
+		{
+			*out++ = ' ';
+		}
+		else if (c < 0x20)
+		{
+			if (out + 1 >= &line[ lineSize - 1 ])
+			{
+				break;
+			}
+
+			/*
+			 * escape control characters as printable
+			 * 0x07 => ^G, 0x08 => ^H, 0x09 => ^I, etc
+			 */
+			*out++ = '^';
+			*out++ = c ^ 0x40;
+		}
+		else
+		{
+			*out++ = c;
+		}
+	}
+
+	*out = 0;
+
+	return pri;
+}
+
+/**
+ * @brief ProcessMessage
+ *
+ * Message processor, this is called on each message read
+ * off of the /dev/log socket; it will actually parse the
+ * message to calculate the priority and recreate the log
+ * body to contain with printable characters.  Afterwhich
+ * it will log the message.
+ *
+ * @param buff the message
+ * @param buffLen the length of the message
+ * @param time when the message was received
+ * @param attachFd descriptor passed along, taken over, or -1
+ */
+static void ProcessMessage(const char *buff, int buffLen,
+                           const struct timeval *time, int attachFd)
+{
+	LogRecord       rec;
+	char            line[ MAXLINE + 1 ];
+
+	/*
+	 * As we are using a datagram socket, we know that buff is a
+	 * complete message that is a null-terminated string.
+	 * The caller has already verified that, so we can ignore
+	 * the specified length here and just look for the terminator.
+	 * Note: If there were embedded NUL characters in
+	 * the data that will cause the message to be truncated.
+	 * Binary messages, starting with one, are not strings.
+	 */
+	memset(&rec, 0, sizeof(rec));
+	rec.time = *time;
+	rec.monoTime = MonotonicSeconds(time);
+	rec.hasAttachment = (attachFd >= 0);
+	rec.attachFd = attachFd;
+
+	if (IsBinaryMessage(buff, buffLen))
+	{
+		ParseBinaryRecord(&rec, buff, buffLen);
+	}
+	else
+	{
+		rec.pri = SanitizeMessage(buff, line, sizeof(line));
+		ParseLogRecord(&rec, line);
+	}
+
+	RouteLogRecord(&rec);
+	LogRecordClear(&rec);
+}
+
+/**********************************************************************
+ *  Ingest pipeline
+ *
+ *  With worker threads, the main thread only receives the messages and
+ *  numbers them.  Workers parse and format them in parallel; each gets
+ *  the messages of a given program, in order.  Back on the main thread,
+ *  the records are put back in sequence and routed, which keeps ring
+ *  buffers and contexts single-threaded and the outputs in order.
+ **********************************************************************/
+
+#define INGEST_MAX_WORKERS      16
+
+/* most records between receiving and routing */
+#define INGEST_WINDOW           1024
+
+typedef struct _IngestWorker
+{
+	GThread      *thrd;
+	GAsyncQueue  *queue;
+
+	/* records parsed, for getStats */
+	gint          parsed;
+} IngestWorker;
+
+typedef struct _IngestPipeline_t
+{
+	IngestWorker    workers[ INGEST_MAX_WORKERS ];
+	int             numWorkers;
+
+	/* parsed records, back to the main thread */
+	GAsyncQueue    *done;
+	gint            drainScheduled;
+
+	/* sequence of the next record received, and records routed */
+	guint64         received;
+	guint64         routed;
+
+	/* records waiting for the ones before them, by sequence */
+	LogRecord      *window[ INGEST_WINDOW ];
+
+	gint            maxInFlight;
+} IngestPipeline_t;
+
+static IngestPipeline_t g_ingest;
+
+/* tells a worker to quit */
+static LogRecord        g_ingestQuit;
+
+/* Forward Declaration */
+static gboolean IngestDrain(gpointer userdata);
+
+/**
+ * @brief IngestWorkerThreadFunc
+ *
+ * @param user_data the IngestWorker
+ *
+ * @return NULL
+ */
+static gpointer IngestWorkerThreadFunc(gpointer user_data)
+{
+	IngestWorker   *worker = user_data;
+	LogRecord      *rec;
+	char            line[ MAXLINE + 1 ];
+
+	while ((rec = g_async_queue_pop(worker->queue)) != &g_ingestQuit)
+	{
+		if (IsBinaryMessage(rec->raw, rec->rawLen))
+		{
+			ParseBinaryRecord(rec, rec->raw, rec->rawLen);
+		}
+		else
+		{
+			rec->pri = SanitizeMessage(rec->raw, line, sizeof(line));
+			ParseLogRecord(rec, line);
+		}
+
+		g_free(rec->raw);
+		rec->raw = NULL;
+
+		g_atomic_int_inc(&worker->parsed);
+		g_async_queue_push(g_ingest.done, rec);
+
+		/* items pushed before the drain resets the flag are seen by it */
+		if (g_atomic_int_compare_and_exchange(&g_ingest.drainScheduled, 0, 1))
+		{
+			g_main_context_invoke(NULL, IngestDrain, NULL);
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief IngestShardOf
+ *
+ * Pick the worker of a message from its program name, so the messages
+ * of a program are parsed in order.
+ *
+ * @param buff the message as received
+ * @param buffLen
+ *
+ * @return worker index
+ */
+static int IngestShardOf(const char *buff, int buffLen)
+{
+	const char *p = buff;
+	const char *fields[ PMLOG_BIN_NUM_FIELDS ];
+	guint16     fieldLens[ PMLOG_BIN_NUM_FIELDS ];
+	guint       hash = 5381;
+	int         i;
+
+	if (IsBinaryMessage(buff, buffLen))
+	{
+		if (ParseBinaryFields(buff, buffLen, fields, fieldLens))
+		{
+			for (i = 0; (i < PMLOG_PROGRAM_MAX_NAME_LENGTH) && (i < fieldLens[ 0 ]); i++)
+			{
+				hash = hash * 33 + (unsigned char) fields[ 0 ][ i ];
+			}
+		}
+
+		return hash % g_ingest.numWorkers;
+	}
+
+	if (*p == '<')
+	{
+		while (*p && (*p != '>'))
+		{
+			p++;
+		}
+
+		if (*p)
+		{
+			p++;
+		}
+	}
+
+	/* skip an RFC 3164 timestamp "Mmm dd hh:mm:ss " */
+	if ((strnlen(p, 16) == 16) && (p[ 3 ] == ' ') && (p[ 9 ] == ':') &&
+	        (p[ 15 ] == ' '))
+	{
+		p += 16;
+	}
+
+	for (i = 0; (i < PMLOG_PROGRAM_MAX_NAME_LENGTH) && p[ i ] &&
+	        !strchr(" :[", p[ i ]); i++)
+	{
+		hash = hash * 33 + (unsigned char) p[ i ];
+	}
+
+	return hash % g_ingest.numWorkers;
+}
+
+/**
+ * @brief IngestRoute
+ *
+ * @param rec routed and freed
+ */
+static void IngestRoute(LogRecord *rec)
+{
+	RouteLogRecord(rec);
+	LogRecordClear(rec);
+	g_free(rec);
+
+	g_ingest.routed++;
+}
+
+/**
+ * @brief IngestAccept
+ *
+ * Route a parsed record, after the ones received before it unless
+ * order is only kept per program.
+ *
+ * @param rec
+ */
+static void IngestAccept(LogRecord *rec)
+{
+	if (g_ingestRelaxedOrder)
+	{
+		IngestRoute(rec);
+		return;
+	}
+
+	g_ingest.window[ rec->seq % INGEST_WINDOW ] = rec;
+
+	while ((rec = g_ingest.window[ g_ingest.routed % INGEST_WINDOW ]) != NULL)
+	{
+		g_ingest.window[ g_ingest.routed % INGEST_WINDOW ] = NULL;
+		IngestRoute(rec);
+	}
+}
+
+/**
+ * @brief IngestDrain
+ *
+ * Main thread, scheduled by the workers: route the parsed records.
+ *
+ * @param userdata
+ *
+ * @return FALSE
+ */
+static gboolean IngestDrain(gpointer userdata)
+{
+	LogRecord *rec;
+
+	g_atomic_int_set(&g_ingest.drainScheduled, 0);
+
+	while ((rec = g_async_queue_try_pop(g_ingest.done)) != NULL)
+	{
+		IngestAccept(rec);
+	}
+
+	return FALSE;
+}
+
+/**
+ * @brief IngestSubmit
+ *
+ * Main thread: number a received message and hand it to its worker.
+ *
+ * @param buff the message, null-terminated
+ * @param buffLen the length of the message
+ * @param time when the message was received
+ * @param attachFd descriptor passed along, taken over, or -1
+ */
+static void IngestSubmit(const char *buff, int buffLen,
+                         const struct timeval *time, int attachFd)
+{
+	LogRecord  *rec;
+	gint        inFlight;
+
+	rec = g_new0(LogRecord, 1);
+	rec->seq = g_ingest.received++;
+	rec->time = *time;
+	rec->monoTime = MonotonicSeconds(time);
+	rec->raw = g_malloc(buffLen + 1);
+	rec->rawLen = buffLen;
+	memcpy(rec->raw, buff, buffLen);
+	rec->raw[ buffLen ] = '\0';
+	rec->hasAttachment = (attachFd >= 0);
+	rec->attachFd = attachFd;
+
+	g_async_queue_push(g_ingest.workers[ IngestShardOf(buff, buffLen) ].queue, rec);
+
+	inFlight = (gint)(g_ingest.received - g_ingest.routed);
+
+	if (inFlight > g_atomic_int_get(&g_ingest.maxInFlight))
+	{
+		g_atomic_int_set(&g_ingest.maxInFlight, inFlight);
+	}
+
+	/* don't run ahead of the slowest worker by more than the window */
+	while (g_ingest.received - g_ingest.routed >= INGEST_WINDOW)
+	{
+		IngestAccept(g_async_queue_pop(g_ingest.done));
+	}
+}
+
+/**
+ * @brief StartIngestPipeline
+ *
+ * Start the workers asked for on the command line, if any.
+ *
+ * @return true on success
+ */
+static bool StartIngestPipeline(void)
+{
+	IngestWorker   *worker;
+	GError         *gerr = NULL;
+	int             i;
+
+	if (g_ingestWorkers <= 0)
+	{
+		return true;
+	}
+
+	g_ingest.done = g_async_queue_new();
+
+	for (i = 0; i < MIN(g_ingestWorkers, INGEST_MAX_WORKERS); i++)
+	{
+		worker = &g_ingest.workers[ i ];
+		worker->queue = g_async_queue_new();
+		worker->thrd = g_thread_try_new("IngestWorker", IngestWorkerThreadFunc,
+		                                worker, &gerr);
+
+		if (!worker->thrd)
+		{
+			ErrPrint("Failed to create ingest worker: %s", gerr->message);
+			g_error_free(gerr);
+			g_async_queue_unref(worker->queue);
+			worker->queue = NULL;
+			return false;
+		}
+
+		g_ingest.numWorkers++;
+	}
+
+	return true;
+}
+
+/**
+ * @brief StopIngestPipeline
+ *
+ * Route the messages received so far and stop the workers.
+ */
+static void StopIngestPipeline(void)
+{
+	IngestWorker   *worker;
+	int             i;
+
+	for (i = 0; i < g_ingest.numWorkers; i++)
+	{
+		worker = &g_ingest.workers[ i ];
+		g_async_queue_push(worker->queue, &g_ingestQuit);
+		g_thread_join(worker->thrd);
+		g_async_queue_unref(worker->queue);
+		worker->thrd = NULL;
+		worker->queue = NULL;
+	}
+
+	g_ingest.numWorkers = 0;
+
+	if (g_ingest.done)
+	{
+		(void) IngestDrain(NULL);
+		g_async_queue_unref(g_ingest.done);
+		g_ingest.done = NULL;
+	}
+}
+
+static void _SysLogMessage(const int level, const char *fmt, ...)
+{
+	va_list     args;
+	char        msg[ 512 ];
+
+	va_start(args, fmt);
+
+	(void) vsnprintf(msg, sizeof(msg), fmt, args);
+
+	va_end(args);
+
+	LogMessage(level, msg);
+}
+
+static GMainLoop *mainLoop = NULL;
+
+/**
+ * @brief ShutdownDrain
+ *
+ * Timeout source: quit once the log socket and the rings of the shared
+ * memory clients are empty, or at the deadline.
+ *
+ * @param userdata
+ *
+ * @return TRUE to check again
+ */
+static gboolean ShutdownDrain(gpointer userdata)
+{
+	PmLogReceiverStats_t    stats;
+	int                     queued = 0;
+
+	if ((g_logFilter.sockFd >= 0) && (ioctl(g_logFilter.sockFd, SIOCINQ, &queued) != 0))
+	{
+		queued = 0;
+	}
+
+	if (g_receiver)
+	{
+		ReceiverGetStats(g_receiver, &stats);
+		queued += (int) stats.shmBacklog;
+	}
+
+	if ((queued > 0) && (g_get_monotonic_time() < g_shutdown.deadline))
+	{
+		return TRUE;
+	}
+
+	if (queued > 0)
+	{
+		ErrPrint("%s: log socket or rings not drained in time\n", __FUNCTION__);
+	}
+
+	g_main_loop_quit(mainLoop);
+
+	return FALSE;
+}
+
+/**
+ * @brief QuitSysLogD
+ *
+ * Called by Glib's mainloop when a signal asking to exit is read.  The
+ * messages still in the log socket are handled first, for at most
+ * SHUTDOWN_DRAIN_TIMEOUT; signaled again, exit at once.
+ *
+ * @param fd the signalfd
+ * @param condition
+ * @param data
+ *
+ * @return TRUE to keep watching
+ */
+static gboolean QuitSysLogD(gint fd, GIOCondition condition, gpointer data)
+{
+	struct signalfd_siginfo info;
+
+	if (read(fd, &info, sizeof(info)) != sizeof(info))
+	{
+		return TRUE;
+	}
+
+	/* exit based on external signal */
+	DbgPrint("PROC_EXIT");
+
+	if (g_shutdown.deadline)
+	{
+		g_main_loop_quit(mainLoop);
+		return TRUE;
+	}
+
+	g_shutdown.deadline = g_get_monotonic_time() + SHUTDOWN_DRAIN_TIMEOUT * 1000;
+	(void) g_timeout_add(SHUTDOWN_DRAIN_INTERVAL, ShutdownDrain, NULL);
+
+	return TRUE;
+}
+
+/**
+ * @brief HandleHandoverRequest
+ *
+ * Called by Glib's mainloop when a new instance connects to take over:
+ * send it the sockets at once, so that it doesn't give up while we
+ * shut down, and exit, leaving it the messages not read yet.
+ *
+ * @param fd the handover listening socket
+ * @param condition
+ * @param data
+ *
+ * @return FALSE once the sockets are handed over
+ */
+static gboolean HandleHandoverRequest(gint fd, GIOCondition condition,
+                                      gpointer data)
+{
+	int connFd = HandoverAccept(fd);
+
+	if (connFd < 0)
+	{
+		return TRUE;
+	}
+
+	/* keep running if the new instance went away */
+	if (!HandoverSendFds(connFd, g_handover.fds))
+	{
+		close(connFd);
+		return TRUE;
+	}
+
+	PmLogInfo(g_context, "HANDOVER", 0, "handing over to a new instance");
+
+	g_handover.connFd = connFd;
+	g_handover.handedOver = true;
+	g_handover.sending = true;
+	g_main_loop_quit(mainLoop);
+
+	return FALSE;
+}
+
+/**
+ * @brief HandOverRecord
+ *
+ * Send a record of a ring buffer to the instance taking over, or write
+ * it if that fails.
+ *
+ * @param time
+ * @param pri
+ * @param programName
+ * @param msg
+ * @param data the PmLogContextConf_t of the ring buffer
+ */
+static void HandOverRecord(gint64 time, int pri, const char *programName,
+                           const char *msg, gpointer data)
+{
+	const PmLogContextConf_t   *contextConfP = data;
+
+	if (g_handover.sending &&
+	        HandoverSendRecord(g_handover.connFd, contextConfP->contextName, time, pri,
+	                           programName, msg))
+	{
+		return;
+	}
+
+	g_handover.sending = false;
+	FlushMessage(time, pri, programName, msg, data);
+}
+
+/**
+ * @brief SaveRing
+ *
+ * Hand the ring buffer of a context over to the instance taking over,
+ * else write it to the outputs so that it isn't lost on exit.
+ *
+ * @param key unused
+ * @param value the PmLogContextConf_t
+ * @param data unused
+ *
+ * @return FALSE to go on
+ */
+static gboolean SaveRing(gpointer key, gpointer value, gpointer data)
+{
+	PmLogContextConf_t *contextConfP = value;
+	gchar              *timeStamp;
+	gchar              *outMsg;
+	char                priStr[ 20 ];
+	char                usageStr[ 80 ];
+
+	if (!contextConfP->rb || contextConfP->rb->isEmpty)
+	{
+		return FALSE;
+	}
+
+	if (g_handover.sending)
+	{
+		/* written instead if sending fails */
+		OutputForceLane(OUTPUT_LANE_BULK);
+		RBFlush(contextConfP->rb, HandOverRecord, contextConfP);
+		OutputForceLane(OUTPUT_NUM_LANES);
+		return FALSE;
+	}
+
+	FormatPri(LOG_SYSLOG | LOG_INFO, priStr, sizeof(priStr));
+	OutputForceLane(OUTPUT_LANE_BULK);
+
+	timeStamp = MakeMessageTimestamp();
+	outMsg = g_strdup_printf("%s %s pmsyslogd: {%s}: ------ Flushing ring buffer on exit ------\n",
+	                         timeStamp, priStr, contextConfP->contextName);
+	OutputMessage(contextConfP, LOG_SYSLOG | LOG_INFO, "pmsyslogd", outMsg);
+	g_free(timeStamp);
+	g_free(outMsg);
+
+	FormatRBUsage(contextConfP->rb, usageStr, sizeof(usageStr));
+	RBFlush(contextConfP->rb, FlushMessage, contextConfP);
+
+	timeStamp = MakeMessageTimestamp();
+	outMsg = g_strdup_printf("%s %s pmsyslogd: {%s}: ------ Done flushing%s ------\n",
+	                         timeStamp, priStr, contextConfP->contextName, usageStr);
+	OutputMessage(contextConfP, LOG_SYSLOG | LOG_INFO, "pmsyslogd", outMsg);
+	g_free(timeStamp);
+	g_free(outMsg);
+
+	OutputForceLane(OUTPUT_NUM_LANES);
+
+	return FALSE;
+}
+
+/**
+ * @brief SaveRings
+ *
+ * On exit, once every message read is handled: hand the ring buffers
+ * over to the instance taking over, if any, else write them to the
+ * outputs.
+ */
+static void SaveRings(void)
+{
+	g_tree_foreach(g_contextConfs, SaveRing, NULL);
+}
+
+/**
+ * @brief TakeOverRecord
+ *
+ * Add a record handed over to the ring buffer of its context.
+ *
+ * @param contextName
+ * @param time
+ * @param pri
+ * @param programName
+ * @param msg
+ * @param msgLen
+ * @param data unused
+ */
+static void TakeOverRecord(const char *contextName, gint64 time, int pri,
+                           const char *programName, const char *msg,
+                           int msgLen, gpointer data)
+{
+	PmLogContextConf_t *contextConfP = g_tree_lookup(g_contextConfs, contextName);
+
+	if (!contextConfP || !contextConfP->rb)
+	{
+		DbgPrint("%s: %s has no ring buffer anymore\n", __FUNCTION__, contextName);
+		return;
+	}
+
+	RBWrite(contextConfP->rb, time, pri, programName, msg, msgLen);
+}
+
+/**
+ * @brief TakeOver
+ *
+ * Get the sockets and ring buffers of the running daemon, and wait for
+ * it to exit.  Started normally if there is none.
+ *
+ * @return true if the sockets were handed over: the daemon is exiting,
+ * if it hasn't yet
+ */
+static bool TakeOver(void)
+{
+	int connFd = HandoverConnect(PMLOG_HANDOVER_SOCKET_PATH, g_handover.fds);
+
+	if (connFd < 0)
+	{
+		return false;
+	}
+
+	if (!HandoverReceive(connFd, HANDOVER_EXIT_TIMEOUT, TakeOverRecord, NULL))
+	{
+		ErrPrint("%s: running daemon did not exit yet\n", __FUNCTION__);
+	}
+
+	close(connFd);
+
+	return true;
+}
+
+
+/**
+ * @brief LogConfig
+ *
+ * Used to log the configuration for debugging purposes.
+ *
+ * This is a GTraverseFunc (see glib's Balanced Binary Trees), it is passed the key and value
+ * of each node, together with user_data parameter passed to g_tree_traverse().  If the function
+ * returns TRUE, the traversal is stopped;  Currently it will never stop.
+ *
+ * @param key a key of a GTree node
+ * @param value the value corresponding to the key
+ * @param data user data passed to g_tree_traversal
+ *
+ * @return TRUE to stop the traversal; currently it always returns FALSE
+ */
+static gboolean LogConfig(gpointer key, gpointer value, gpointer data)
+{
+	const PmLogContextConf_t   *contextP = value;
+	gchar *name = (gchar *)key;
+	int j;
+
+	const PmLogFile_t  *outputP;
+	const PmLogRule_t  *ruleP;
+	char filter[32] = {0,};
+	char output[32] = {0,};
+
+	PmLogInfo(g_context, "CFG_CTX", 1, PMLOGKS("Name", name), "");
+
+	if (contextP->rb)
+	{
+		PmLogInfo(g_context, "CFG_CTX_BUFFER", 4,
+		          PMLOGKFV("Size", "%d", contextP->rb->bufferSize),
+		          PMLOGKFV("MinSize", "%d", contextP->rb->minSize),
+		          PMLOGKS("FlushLevel", GetRuleLevelStr(contextP->rb->flushLevel)),
+		          PMLOGKS("Compressed", contextP->rb->compress ? "true" : "false"),
+		          "");
+	}
+
+	for (j = 0; j < contextP->numRules; j++)
+	{
+		ruleP = &contextP->rules[ j ];
+
+		outputP = &g_outputConfs[ ruleP->outputIndex ];
+
+		snprintf(filter, sizeof(filter), "%s.%s%s.%s",
+		         GetRuleFacilityStr(ruleP->facility),
+		         ruleP->levelInvert ? "!" : "",
+		         GetRuleLevelStr(ruleP->level),
+		         (ruleP->program == NULL) ? "*" : ruleP->program);
+
+		snprintf(output, sizeof(output), "%s%s",
+		         ruleP->omitOutput ? "-" : "",
+		         outputP->outputName);
+
+		PmLogInfo(g_context, "CFG_RULE", 2, PMLOGKS("Filter", filter), PMLOGKS("Output",
+		          output), "");
+	}
+
+	/* return true to stop the traversal */
+	return FALSE;
+
+}
+
+/**
+ * @brief LogConfigInfo
+ *
+ * For status reporting purposes, log out configuration information.
+ * It accomplishes this by calling LogConfig on every node in the configuration
+ * tree.
+ *
+ * @see LogConfig
+ */
+static void LogConfigInfo(void)
+{
+	const PmLogFile_t  *outputP;
+	int                 i;
+	int                 allocated;
+	int                 inUse;
+	int                 peak;
+	int                 budget;
+
+	RBPoolGetUsage(&allocated, &inUse, &peak, &budget);
+
+	PmLogInfo(g_context, "CFG_BUFFER_POOL", 2,
+	          PMLOGKFV("Budget", "%d", budget),
+	          PMLOGKFV("ChunkSize", "%d", RBPoolChunkSize()),
+	          "");
+
+	for (i = 0; i < g_numOutputs; i++)
+	{
+		outputP = &g_outputConfs[ i ];
+
+		PmLogInfo(g_context, "CFG_OUTPUT", 4,
+		          PMLOGKS("Name", outputP->outputName),
+		          PMLOGKS("Path", outputP->path),
+		          PMLOGKFV("Size", "%d", outputP->maxSize),
+		          PMLOGKFV("Rotations", "%d", outputP->rotations),
+		          "");
+	}
+
+	g_tree_foreach(g_contextConfs, LogConfig, NULL);
+}
+
+/**
+ * @brief LogFileKillRotations
+ *
+ * delete the rotation files at and after the given index
+ *
+ * e.g
+ * messages          index: 0
+ * messages.0.gz     index: 1
+ * messages.1.gz     index: 2
+ * messages.2.gz     index: 3
+ * messages.3.gz     index: 4
+ * messages.4.gz     index: 5
+ *
+ * @param logFileP
+ * @param start starting index to delete, see example above
+ */
+static void
+LogFileKillRotations(PmLogFile_t *logFileP, int start)
+{
+	int r = 0;
+
+	for (r = start; r < PMLOG_MAX_NUM_ROTATIONS; r++)
+	{
+		gchar *rotation_file = r ?
+		                       g_strdup_printf(PMLOGDAEMON_FILE_ROTATION_PATTERN, logFileP->path, r - 1) :
+		                       g_strdup(logFileP->path);
+
+		g_remove(rotation_file);
+		g_free(rotation_file);
+	}
+}
+
+
+/**
+ * @brief LogFileInit
+ * Constructor for the logFileP; copy variables from confP and initialize
+ *
+ * @param logFileP logfile to initialize
+ * @param confP source of initial data to copy from.
+ */
+static void LogFileInit(PmLogFile_t *logFileP, const PmLogFile_t *confP)
+{
+	/* copy the fields to this struct for convenience */
+	logFileP->outputName    = confP->outputName;
+	logFileP->path          = confP->path;
+	logFileP->maxSize       = confP->maxSize;
+	logFileP->rotations     = confP->rotations;
+
+	/* make sure there are not stale rotation files around */
+	LogFileKillRotations(logFileP, logFileP->rotations + 1);
+}
+
+
+/**
+ * @brief ReportKernelDrops
+ *
+ * Log how many datagrams the kernel dropped, at most once per
+ * KERNEL_DROPS_LOG_INTERVAL.
+ */
+static void ReportKernelDrops(void)
+{
+	PmLogReceiverStats_t    stats;
+	time_t                  now;
+
+	ReceiverGetStats(g_receiver, &stats);
+
+	if (stats.kernelDrops == g_kernelDrops.logged)
+	{
+		return;
+	}
+
+	now = getMonotonicTime();
+
+	if (g_kernelDrops.lastLog && (now - g_kernelDrops.lastLog < KERNEL_DROPS_LOG_INTERVAL))
+	{
+		return;
+	}
+
+	PmLogWarning(g_context, "KERNEL_DROPS", 2,
+	             PMLOGKFV("Dropped", "%u", stats.kernelDrops - g_kernelDrops.logged),
+	             PMLOGKFV("ReceiveBuffer", "%d", stats.receiveBuffer),
+	             "%u messages dropped by kernel", stats.kernelDrops - g_kernelDrops.logged);
+
+	g_kernelDrops.logged = stats.kernelDrops;
+	g_kernelDrops.lastLog = now;
+}
+
+/**
+ * @brief HandleReceivedBatch
+ *
+ * Called by Glib's mainloop when the receiver thread handed over
+ * messages read off of the unix domain socket /dev/log.
+ *
+ * @param fd the handoff descriptor of the receiver
+ * @param condition
+ * @param data
+ *
+ * @return TRUE to keep watching
+ */
+static gboolean HandleReceivedBatch(gint fd, GIOCondition condition,
+                                    gpointer data)
+{
+	GPtrArray          *batch;
+	PmLogDatagram_t    *dgram;
+	guint               i;
+
+	/* follow changes of the wall clock */
+	g_monoOffset = g_get_monotonic_time() - g_get_real_time();
+
+	while ((batch = ReceiverTakeBatch(g_receiver)) != NULL)
+	{
+		for (i = 0; i < batch->len; i++)
+		{
+			dgram = g_ptr_array_index(batch, i);
+			#ifdef PMLOGDAEMON_ENABLE_LOGGING
+			if (g_ingest.numWorkers > 0)
+			{
+				IngestSubmit(dgram->buff, dgram->len, &dgram->time, dgram->attachFd);
+			}
+			else
+			{
+				ProcessMessage(dgram->buff, dgram->len, &dgram->time, dgram->attachFd);
+			}
+
+			dgram->attachFd = -1;
+			#endif
+		}
+
+		g_ptr_array_unref(batch);
+	}
+
+	ReportKernelDrops();
+
+	return TRUE;
+}
+
+/**
+ * @brief StartReceiver
+ *
+ * Start the receiver thread and watch what it hands over.
+ *
+ * @return true on success
+ */
+static bool StartReceiver(void)
+{
+	g_receiver = ReceiverStart(MAXLINE);
+
+	if (!g_receiver)
+	{
+		ErrPrint("Failed to create Receiver Line");
+		return false;
+	}
+
+	ReceiverSetBufferBounds(g_receiver, g_receiveBufferMin, g_receiveBufferMax);
+
+	(void) g_unix_fd_add(ReceiverHandoffFd(g_receiver), G_IO_IN,
+	                     HandleReceivedBatch, NULL);
+
+	return true;
+}
+
+/**
+ * @brief StopReceiver
+ *
+ * Stop the receiver thread and log what it received until then.
+ */
+static void StopReceiver(void)
+{
+	if (!g_receiver)
+	{
+		return;
+	}
+
+	ReceiverStop(g_receiver);
+	(void) HandleReceivedBatch(ReceiverHandoffFd(g_receiver), G_IO_IN, NULL);
+	ReceiverFree(g_receiver);
+	g_receiver = NULL;
+}
+
+/**
+ * @brief ReplyLunaError
+ *
+ * @param lsHandle
+ * @param lsMessage
+ * @param errorText
+ */
+static void ReplyLunaError(LSHandle *lsHandle, LSMessage *lsMessage,
+                               const char *errorText)
+{
+	LSError    lserror;
+	jvalue_ref reply = jobject_create();
+
+	LSErrorInit(&lserror);
+
+	jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(false));
+	jobject_put(reply, J_CSTR_TO_JVAL("errorText"), jstring_create(errorText));
+
+	if (!LSMessageReply(lsHandle, lsMessage, jvalue_tostring_simple(reply),
+	                    &lserror))
+	{
+		LSErrorLog(g_context, "LSREPLY_ERROR", &lserror);
+		LSErrorFree(&lserror);
+	}
+
+	j_release(&reply);
+}
+
+/* a log rotated by a forcerotate call */
+typedef struct _ForceRotateFile
+{
+	const char *outputName;
+	gchar      *path;
+
+	/* true if given to the rotation subscribers rather than compressed */
+	bool        handedOff;
+} ForceRotateFile;
+
+typedef struct _ForceRotateRequest
+{
+	LSHandle   *lsHandle;
+	LSMessage  *lsMessage;
+
+	/* output to rotate, NULL for all */
+	gchar      *outputName;
+
+	/* ForceRotateFile for each rotated output */
+	GSList     *files;
+} ForceRotateRequest;
+
+/* archive written by backuplogs */
+#define BACKUP_LOGS_TARBALL     WEBOS_INSTALL_LOCALSTATEDIR "/spool/rdxd/previous_boot_logs.tar.gz"
+
+/* archives written by incremental backuplogs, followed by the time of
+ * the backup so that none replaces one not collected yet */
+#define BACKUP_LOGS_INCREMENTAL_PREFIX  WEBOS_INSTALL_LOCALSTATEDIR "/spool/rdxd/incremental_logs-"
+#define BACKUP_LOGS_INCREMENTAL_SUFFIX  ".tar.gz"
+
+/* files archived by the last backup, the base of an incremental one */
+#define BACKUP_LOGS_MANIFEST    WEBOS_INSTALL_LOCALSTATEDIR "/spool/rdxd/backuplogs.manifest"
+
+/* directory of the members in the archive */
+#define BACKUP_LOGS_MEMBER_DIR  "log/"
+
+/* bytes before the end of what was archived of a log, checked to tell
+ * that it only grew since */
+#define BACKUP_LOGS_CHECK_BLOCK 4096
+
+/* a log file opened by backuplogs, or an entry of the manifest */
+typedef struct _BackupFile
+{
+	gchar      *name;
+	int         fd;
+	gint64      inode;
+
+	/* size at the time of the request, later writes are left out */
+	off_t       size;
+	struct stat fileStat;
+
+	/* checksum of the block ending at size, NULL if unknown */
+	gchar      *endSum;
+} BackupFile;
+
+typedef struct _BackupRequest
+{
+	LSHandle   *lsHandle;
+	LSMessage  *lsMessage;
+
+	/* true to archive only what changed since the last backup */
+	bool        incremental;
+
+	/* BackupFile for each log */
+	GSList     *files;
+	gint64      startTime;
+} BackupRequest;
+
+/* 1 while a backup is in progress */
+static gint         g_backupRunning;
+
+/**
+ * @brief BackupFileFree
+ *
+ * @param data the BackupFile
+ */
+static void BackupFileFree(gpointer data)
+{
+	BackupFile *file = data;
+
+	if (file->fd >= 0)
+	{
+		close(file->fd);
+	}
+
+	g_free(file->name);
+	g_free(file->endSum);
+	g_free(file);
+}
+
+/**
+ * @brief BackupRequestFree
+ *
+ * @param req
+ */
+static void BackupRequestFree(BackupRequest *req)
+{
+	g_slist_free_full(req->files, BackupFileFree);
+	LSMessageUnref(req->lsMessage);
+	g_free(req);
+
+	g_atomic_int_set(&g_backupRunning, 0);
+}
+
+/**
+ * @brief BackupManifestLoad
+ *
+ * Read the manifest of the last backup.
+ *
+ * @return table of the BackupFile entries by name, empty if there is
+ * no manifest
+ */
+static GHashTable *BackupManifestLoad(void)
+{
+	GHashTable *manifest;
+	JSchemaInfo schemainfo;
+	jvalue_ref  parsed;
+	jvalue_ref  files;
+	jvalue_ref  entry;
+	jvalue_ref  value;
+	raw_buffer  str;
+	BackupFile *file;
+	int64_t     n;
+	int         i;
+
+	manifest = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+	                                 BackupFileFree);
+
+	jschema_info_init(&schemainfo, jschema_all(), NULL, NULL);
+	parsed = jdom_parse_file(BACKUP_LOGS_MANIFEST, &schemainfo,
+	                         DOMOPT_INPUT_NOCHANGE);
+
+	if (!jis_null(parsed) &&
+	        jobject_get_exists(parsed, J_CSTR_TO_BUF("files"), &files))
+	{
+		for (i = 0; i < jarray_size(files); i++)
+		{
+			entry = jarray_get(files, i);
+
+			if (!jobject_get_exists(entry, J_CSTR_TO_BUF("name"), &value))
+			{
+				continue;
+			}
+
+			str = jstring_get_fast(value);
+
+			if (!str.m_str)
+			{
+				continue;
+			}
+
+			file = g_new0(BackupFile, 1);
+			file->fd = -1;
+			file->name = g_strndup(str.m_str, str.m_len);
+
+			if (jobject_get_exists(entry, J_CSTR_TO_BUF("inode"), &value) &&
+			        (jnumber_get_i64(value, &n) == CONV_OK))
+			{
+				file->inode = n;
+			}
+
+			if (jobject_get_exists(entry, J_CSTR_TO_BUF("size"), &value) &&
+			        (jnumber_get_i64(value, &n) == CONV_OK))
+			{
+				file->size = (off_t) n;
+			}
+
+			if (jobject_get_exists(entry, J_CSTR_TO_BUF("mtime"), &value) &&
+			        (jnumber_get_i64(value, &n) == CONV_OK))
+			{
+				file->fileStat.st_mtime = (time_t) n;
+			}
+
+			if (jobject_get_exists(entry, J_CSTR_TO_BUF("endSum"), &value))
+			{
+				str = jstring_get_fast(value);
+
+				if (str.m_str)
+				{
+					file->endSum = g_strndup(str.m_str, str.m_len);
+				}
+			}
+
+			g_hash_table_replace(manifest, file->name, file);
+		}
+	}
+
+	j_release(&parsed);
+
+	return manifest;
+}
+
+/**
+ * @brief BackupFileEndSum
+ *
+ * @param file an opened log
+ * @param end
+ *
+ * @return checksum of the BACKUP_LOGS_CHECK_BLOCK bytes, or fewer, of
+ * the log before end, to free; NULL if they can't be read
+ */
+static gchar *BackupFileEndSum(const BackupFile *file, off_t end)
+{
+	guchar  buff[ BACKUP_LOGS_CHECK_BLOCK ];
+	off_t   start = MAX(end - BACKUP_LOGS_CHECK_BLOCK, 0);
+	ssize_t n;
+
+	if (file->fd < 0)
+	{
+		return NULL;
+	}
+
+	n = pread(file->fd, buff, (size_t)(end - start), start);
+
+	if (n != (ssize_t)(end - start))
+	{
+		return NULL;
+	}
+
+	return g_compute_checksum_for_data(G_CHECKSUM_SHA1, buff, (gsize) n);
+}
+
+/**
+ * @brief BackupManifestSave
+ *
+ * Record the files of a backup, as they were cut, as the base of the
+ * next incremental backup.
+ *
+ * @param files BackupFile list
+ *
+ * @return true on success
+ */
+static bool BackupManifestSave(GSList *files)
+{
+	BackupFile *file;
+	GSList     *l;
+	jvalue_ref  manifest;
+	jvalue_ref  array;
+	jvalue_ref  entry;
+	GError     *gerr = NULL;
+	bool        result = true;
+
+	array = jarray_create(NULL);
+
+	for (l = files; l != NULL; l = l->next)
+	{
+		file = l->data;
+		entry = jobject_create();
+		jobject_put(entry, J_CSTR_TO_JVAL("name"), jstring_create(file->name));
+		jobject_put(entry, J_CSTR_TO_JVAL("inode"),
+		            jnumber_create_i64(file->inode));
+		jobject_put(entry, J_CSTR_TO_JVAL("size"),
+		            jnumber_create_i64((int64_t) file->size));
+		jobject_put(entry, J_CSTR_TO_JVAL("mtime"),
+		            jnumber_create_i64((int64_t) file->fileStat.st_mtime));
+
+		g_free(file->endSum);
+		file->endSum = BackupFileEndSum(file, file->size);
+
+		if (file->endSum)
+		{
+			jobject_put(entry, J_CSTR_TO_JVAL("endSum"), jstring_create(file->endSum));
+		}
+
+		jarray_append(array, entry);
+	}
+
+	manifest = jobject_create();
+	jobject_put(manifest, J_CSTR_TO_JVAL("files"), array);
+
+	if (!g_file_set_contents(BACKUP_LOGS_MANIFEST,
+	                         jvalue_tostring_simple(manifest), -1, &gerr))
+	{
+		ErrPrint("%s: %s\n", __FUNCTION__, gerr->message);
+		g_error_free(gerr);
+		result = false;
+	}
+
+	j_release(&manifest);
+
+	return result;
+}
+
+/**
+ * @brief BackupFileUnchanged
+ *
+ * @param key unused
+ * @param value a BackupFile of the manifest
+ * @param data the BackupFile of the log
+ *
+ * @return TRUE if the log is the file of the manifest, as archived
+ */
+static gboolean BackupFileUnchanged(gpointer key, gpointer value, gpointer data)
+{
+	const BackupFile *last = value;
+	const BackupFile *file = data;
+
+	return (last->inode == file->inode) && (last->size == file->size) &&
+	       (last->fileStat.st_mtime == file->fileStat.st_mtime);
+}
+
+/**
+ * @brief BackupFileOffset
+ *
+ * Decide what part of a file an incremental backup needs.
+ *
+ * @param manifest
+ * @param file
+ *
+ * @return offset of the first byte to archive, -1 to skip the file
+ */
+static off_t BackupFileOffset(GHashTable *manifest, const BackupFile *file)
+{
+	const BackupFile   *last;
+	gchar              *sum;
+	off_t               offset = 0;
+
+	last = g_hash_table_lookup(manifest, file->name);
+
+	if (!last || (last->inode != file->inode))
+	{
+		/* already archived under another name, before a rotation */
+		return g_hash_table_find(manifest, BackupFileUnchanged,
+		                         (gpointer) file) ? -1 : 0;
+	}
+
+	if (BackupFileUnchanged(NULL, (gpointer) last, (gpointer) file))
+	{
+		return -1;
+	}
+
+	/*
+	 * A live log that grew: only its tail is new, unless it was
+	 * truncated in place meanwhile (e.g. to free disk space), which keeps the
+	 * inode: what was archived is then no longer there.
+	 */
+	if ((last->size < file->size) && last->endSum)
+	{
+		sum = BackupFileEndSum(file, last->size);
+
+		if (sum && (strcmp(sum, last->endSum) == 0))
+		{
+			offset = last->size;
+		}
+
+		g_free(sum);
+	}
+
+	return offset;
+}
+
+/**
+ * @brief BackupIncrementalPath
+ *
+ * @return a path for a new incremental archive, named after the time
+ */
+static gchar *BackupIncrementalPath(void)
+{
+	char        stamp[ 32 ];
+	time_t      now = time(NULL);
+	struct tm   tm;
+	gchar      *path;
+	int         i;
+
+	(void) strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", localtime_r(&now, &tm));
+	path = g_strconcat(BACKUP_LOGS_INCREMENTAL_PREFIX, stamp,
+	                   BACKUP_LOGS_INCREMENTAL_SUFFIX, NULL);
+
+	/* backups don't overlap, so this one is only raced by itself */
+	for (i = 1; g_file_test(path, G_FILE_TEST_EXISTS); i++)
+	{
+		g_free(path);
+		path = g_strdup_printf("%s%s-%d%s", BACKUP_LOGS_INCREMENTAL_PREFIX, stamp, i,
+		                       BACKUP_LOGS_INCREMENTAL_SUFFIX);
+	}
+
+	return path;
+}
+
+/**
+ * @brief BackupLogsThreadFunc
+ *
+ * Stream the files opened by BackupLogsCut into the archive, then
+ * reply.  Runs on its own thread, as this takes a while.  An
+ * incremental backup only archives the files, or the tails of the live
+ * logs, that are not in the manifest of the last backup; tails are
+ * named "<log>+<offset>".
+ *
+ * @param userdata the BackupRequest
+ *
+ * @return NULL
+ */
+static gpointer BackupLogsThreadFunc(gpointer userdata)
+{
+	BackupRequest  *req = userdata;
+	BackupFile     *file;
+	GSList         *l;
+	PmLogArchive_t *archive;
+	GHashTable     *manifest = NULL;
+	gchar          *path;
+	gchar          *tmpPath;
+	gchar          *name;
+	off_t           offset;
+	off_t           size = 0;
+	off_t           bytes = 0;
+	int             numArchived = 0;
+	bool            ok;
+	jvalue_ref      reply;
+	LSError         lserror;
+
+	if (req->incremental)
+	{
+		path = BackupIncrementalPath();
+		manifest = BackupManifestLoad();
+	}
+	else
+	{
+		path = g_strdup(BACKUP_LOGS_TARBALL);
+	}
+
+	/* write aside, so an interrupted backup doesn't replace the last one */
+	tmpPath = g_strconcat(path, ".tmp", NULL);
+	archive = ArchiveOpen(tmpPath);
+	ok = (archive != NULL);
+
+	for (l = req->files; ok && (l != NULL); l = l->next)
+	{
+		file = l->data;
+		offset = manifest ? BackupFileOffset(manifest, file) : 0;
+
+		if (offset < 0)
+		{
+			continue;
+		}
+
+		if (offset > 0)
+		{
+			name = g_strdup_printf("%s%s+%lld", BACKUP_LOGS_MEMBER_DIR, file->name,
+			                       (long long) offset);
+		}
+		else
+		{
+			name = g_strconcat(BACKUP_LOGS_MEMBER_DIR, file->name, NULL);
+		}
+
+		ok = ArchiveAddFile(archive, name, file->fd, offset, file->size - offset,
+		                    &file->fileStat);
+		g_free(name);
+
+		numArchived++;
+		bytes += file->size - offset;
+	}
+
+	if (manifest)
+	{
+		g_hash_table_destroy(manifest);
+	}
+
+	if (archive && !ArchiveClose(archive, &size))
+	{
+		ok = false;
+	}
+
+	if (ok && (rename(tmpPath, path) != 0))
+	{
+		ErrPrint("%s: rename error: %s\n", __FUNCTION__, strerror(errno));
+		ok = false;
+	}
+
+	/* the next incremental backup starts from here */
+	if (ok)
+	{
+		(void) BackupManifestSave(req->files);
+	}
+
+	if (!ok)
+	{
+		(void) unlink(tmpPath);
+		ReplyLunaError(req->lsHandle, req->lsMessage, "Failed to archive logs");
+	}
+	else
+	{
+		reply = jobject_create();
+		jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
+		jobject_put(reply, J_CSTR_TO_JVAL("path"), jstring_create(path));
+		jobject_put(reply, J_CSTR_TO_JVAL("mode"),
+		            jstring_create(req->incremental ? "incremental" : "full"));
+		jobject_put(reply, J_CSTR_TO_JVAL("size"),
+		            jnumber_create_i64((int64_t) size));
+		jobject_put(reply, J_CSTR_TO_JVAL("files"),
+		            jnumber_create_i32(numArchived));
+		jobject_put(reply, J_CSTR_TO_JVAL("skipped"),
+		            jnumber_create_i32((int32_t) g_slist_length(req->files) - numArchived));
+		jobject_put(reply, J_CSTR_TO_JVAL("bytes"),
+		            jnumber_create_i64((int64_t) bytes));
+		jobject_put(reply, J_CSTR_TO_JVAL("duration"),
+		            jnumber_create_i64((g_get_monotonic_time() - req->startTime) / 1000));
+
+		LSErrorInit(&lserror);
+
+		if (!LSMessageReply(req->lsHandle, req->lsMessage,
+		                    jvalue_tostring_simple(reply), &lserror))
+		{
+			LSErrorLog(g_context, "LSREPLY_ERROR", &lserror);
+			LSErrorFree(&lserror);
+		}
+
+		j_release(&reply);
+	}
+
+	PmLogInfo(g_context, "BACKUP_LOGS", 4, PMLOGKS("Result", ok ? "ok" : "failed"),
+	          PMLOGKS("Mode", req->incremental ? "incremental" : "full"),
+	          PMLOGKFV("Size", "%lld", (long long) size),
+	          PMLOGKFV("Duration", "%lld",
+	                   (long long)(g_get_monotonic_time() - req->startTime) / 1000), "");
+
+	g_free(tmpPath);
+	g_free(path);
+	BackupRequestFree(req);
+
+	return NULL;
+}
+
+/**
+ * @brief BackupLogsCut
+ *
+ * Runs on the main thread once the output executors wrote everything
+ * logged before the call.  Opening the files pins them: rotations
+ * renaming or removing them meanwhile don't affect the backup, and only
+ * what was there at this point is archived.
+ *
+ * @param userdata the BackupRequest
+ *
+ * @return FALSE
+ */
+static gboolean BackupLogsCut(gpointer userdata)
+{
+	BackupRequest *req = userdata;
+	BackupFile    *file;
+	GDir          *dir;
+	const gchar   *name;
+	gchar         *path;
+	GThread       *thread;
+	GError        *gerr = NULL;
+	int            fd;
+
+	dir = g_dir_open(WEBOS_INSTALL_LOGDIR, 0, &gerr);
+
+	if (!dir)
+	{
+		ReplyLunaError(req->lsHandle, req->lsMessage, gerr->message);
+		g_error_free(gerr);
+		BackupRequestFree(req);
+		return FALSE;
+	}
+
+	while ((name = g_dir_read_name(dir)) != NULL)
+	{
+		path = g_build_filename(WEBOS_INSTALL_LOGDIR, name, NULL);
+		fd = open(path, O_RDONLY | O_NOFOLLOW | O_NONBLOCK);
+		g_free(path);
+
+		if (fd < 0)
+		{
+			continue;
+		}
+
+		file = g_new0(BackupFile, 1);
+		file->fd = fd;
+
+		if ((fstat(fd, &file->fileStat) != 0) || !S_ISREG(file->fileStat.st_mode))
+		{
+			close(fd);
+			g_free(file);
+			continue;
+		}
+
+		file->name = g_strdup(name);
+		file->inode = (gint64) file->fileStat.st_ino;
+		file->size = file->fileStat.st_size;
+		req->files = g_slist_prepend(req->files, file);
+	}
+
+	g_dir_close(dir);
+
+	thread = g_thread_try_new("BackupLogs", BackupLogsThreadFunc, req, &gerr);
+
+	if (!thread)
+	{
+		ReplyLunaError(req->lsHandle, req->lsMessage, gerr->message);
+		g_error_free(gerr);
+		BackupRequestFree(req);
+		return FALSE;
+	}
+
+	g_thread_unref(thread);
+
+	return FALSE;
+}
+
+/**
+ * @brief BackupLogsSync
+ *
+ * Runs on the main thread: cut the logs once the messages logged so far
+ * are written.
+ *
+ * @param userdata the BackupRequest
+ *
+ * @return FALSE
+ */
+static gboolean BackupLogsSync(gpointer userdata)
+{
+	OutputBarrier(NULL, BackupLogsCut, userdata);
 
-			gchar *timeStamp = MakeMessageTimestamp();
-			char            priStr[ 20 ];
-			/* look up facility + priority name from pri */
-			FormatPri(LOG_SYSLOG | LOG_INFO, priStr, sizeof(priStr));
-			gchar *outMsg =
-			    g_strdup_printf("%s %s pmsyslogd: {%s}: ------ Flushing ring buffer for context %s ------\n",
-			                    timeStamp,
-			                    priStr,
-			                    keyContextP->contextName,
-			                    me->contextName);
+	return FALSE;
+}
+
+/////////////////////////////////////////////////////////////////
+//                                                             //
+//            Start of API documentation comment block         //
+//                                                             //
+/////////////////////////////////////////////////////////////////
+/**
+@page com_webos_pmlogd com.webos.pmlogd
+@{
+@section com_webos_pmlogd_backuplogs backuplogs
+
+make tarball which includes all files in /var/log to
+/var/spool/rdxd/previous_boot_logs.tar.gz.  The live logs are archived
+as they were when the call was made; the reply is sent once the
+archive is written.
+
+In incremental mode, only the files not archived by the last backup
+are written, to a new /var/spool/rdxd/incremental_logs-<time>.tar.gz
+given in the reply.  Logs that grew since are archived from where the
+last backup stopped, as "log/<name>+<offset>".  Files are recognized
+by inode, size and mtime, so rotated logs are not archived again after
+being renamed.  Each increment is relative to the previous backup,
+full or incremental: restoring needs the last full archive and every
+increment written since, which are never replaced.
+
+@par Parameters
+
+Name | Required | Type | Description
+-----|--------|------|----------
+mode | no | String | "full" (default) or "incremental"
+
+@par Returns
+
+Name | Required | Type | Description
+-----|--------|------|----------
+returnValue | yes | Boolean | True on success, false otherwise
+errorText | no | String | Error text
+path | no | String | Path of the archive
+mode | no | String | "full" or "incremental"
+size | no | Number | Size of the archive in bytes
+files | no | Number | Number of files archived
+skipped | no | Number | Number of files left out as already archived
+bytes | no | Number | Bytes of logs archived
+duration | no | Number | Time taken, in milliseconds
+@}
+*/
+/////////////////////////////////////////////////////////////////
+//                                                             //
+//            End of API documentation comment block           //
+//                                                             //
+/////////////////////////////////////////////////////////////////
+static bool backup_logs_ls(LSHandle *lsHandle, LSMessage *lsMessage, void *wd)
+{
+	BackupRequest *req;
+	JSchemaInfo    schemainfo;
+	jvalue_ref     parsed;
+	jvalue_ref     value;
+	raw_buffer     str;
+	bool           incremental = false;
+
+	jschema_info_init(&schemainfo, jschema_all(), NULL, NULL);
+	parsed = jdom_parse(j_cstr_to_buffer(LSMessageGetPayload(lsMessage)),
+	                    DOMOPT_NOOPT, &schemainfo);
+
+	if (jobject_get_exists(parsed, J_CSTR_TO_BUF("mode"), &value))
+	{
+		str = jstring_get_fast(value);
+
+		if (str.m_str && (str.m_len == 11) &&
+		        (strncmp(str.m_str, "incremental", 11) == 0))
+		{
+			incremental = true;
+		}
+		else if (!str.m_str || (str.m_len != 4) ||
+		         (strncmp(str.m_str, "full", 4) != 0))
+		{
+			j_release(&parsed);
+			ReplyLunaError(lsHandle, lsMessage, "Invalid mode");
+			return true;
+		}
+	}
+
+	j_release(&parsed);
+
+	if (!g_atomic_int_compare_and_exchange(&g_backupRunning, 0, 1))
+	{
+		ReplyLunaError(lsHandle, lsMessage, "Backup already in progress");
+		return true;
+	}
+
+	req = g_new0(BackupRequest, 1);
+	req->lsHandle = lsHandle;
+	req->lsMessage = lsMessage;
+	req->incremental = incremental;
+	req->startTime = g_get_monotonic_time();
+
+	LSMessageRef(lsMessage);
+	g_main_context_invoke(NULL, BackupLogsSync, req);
+
+	return true;
+}
+
+/**
+ * @brief ForceRotateRequestFree
+ *
+ * @param req
+ */
+static void ForceRotateRequestFree(ForceRotateRequest *req)
+{
+	GSList          *l;
+	ForceRotateFile *file;
+
+	for (l = req->files; l != NULL; l = l->next)
+	{
+		file = l->data;
+		g_free(file->path);
+		g_free(file);
+	}
+
+	g_slist_free(req->files);
+	LSMessageUnref(req->lsMessage);
+	g_free(req->outputName);
+	g_free(req);
+}
+
+/**
+ * @brief ForceRotateCompress
+ *
+ * Heavy operation task: compress the logs rotated by a forcerotate call
+ * and send the completion reply listing the produced files.
+ *
+ * @param userdata the ForceRotateRequest
+ *
+ * @return FALSE
+ */
+static gboolean ForceRotateCompress(gpointer userdata)
+{
+	ForceRotateRequest *req = userdata;
+	ForceRotateFile    *file;
+	GSList             *l;
+	gchar              *gzPath;
+	struct stat         fileStat;
+	jvalue_ref          files;
+	jvalue_ref          entry;
+	jvalue_ref          reply;
+	LSError             lserror;
+
+	files = jarray_create(NULL);
+
+	for (l = req->files; l != NULL; l = l->next)
+	{
+		file = l->data;
+
+		if (!file->handedOff)
+		{
+			gzPath = g_strconcat(file->path, ".gz", NULL);
+
+			if (CompressFile(g_strdup(file->path)))
+			{
+				g_free(file->path);
+				file->path = gzPath;
+			}
+			else
+			{
+				g_free(gzPath);
+			}
+		}
+
+		entry = jobject_create();
+		jobject_put(entry, J_CSTR_TO_JVAL("output"),
+		            jstring_create(file->outputName));
+		jobject_put(entry, J_CSTR_TO_JVAL("path"), jstring_create(file->path));
+		jobject_put(entry, J_CSTR_TO_JVAL("handedOff"),
+		            jboolean_create(file->handedOff));
+
+		if (stat(file->path, &fileStat) == 0)
+		{
+			jobject_put(entry, J_CSTR_TO_JVAL("size"),
+			            jnumber_create_i64((int64_t) fileStat.st_size));
+		}
+
+		jarray_append(files, entry);
+	}
+
+	reply = jobject_create();
+	jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
+	jobject_put(reply, J_CSTR_TO_JVAL("done"), jboolean_create(true));
+	jobject_put(reply, J_CSTR_TO_JVAL("files"), files);
+
+	LSErrorInit(&lserror);
+
+	if (!LSMessageReply(req->lsHandle, req->lsMessage,
+	                    jvalue_tostring_simple(reply), &lserror))
+	{
+		LSErrorLog(g_context, "LSREPLY_ERROR", &lserror);
+		LSErrorFree(&lserror);
+	}
+
+	j_release(&reply);
+	ForceRotateRequestFree(req);
+
+	return FALSE;
+}
+
+/**
+ * @brief ForceRotateOutput
+ *
+ * @param req
+ * @param logFileP
+ */
+static void ForceRotateOutput(ForceRotateRequest *req, PmLogFile_t *logFileP)
+{
+	ForceRotateFile *file;
+
+	/* filled in by the executor of the output */
+	file = g_new0(ForceRotateFile, 1);
+	file->outputName = logFileP->outputName;
+	req->files = g_slist_append(req->files, file);
+
+	OutputRotate(logFileP, &file->path, &file->handedOff);
+}
+
+/**
+ * @brief ForceRotateRotated
+ *
+ * Runs on the main thread once the executors rotated the outputs.
+ * Compression is left to the heavy operation thread.
+ *
+ * @param userdata the ForceRotateRequest
+ *
+ * @return FALSE
+ */
+static gboolean ForceRotateRotated(gpointer userdata)
+{
+	ForceRotateRequest *req = userdata;
+	ForceRotateFile    *file;
+	GSList             *l;
+	GSList             *next;
+	jvalue_ref          reply;
+	jvalue_ref          outputs;
+	LSError             lserror;
+
+	/* forget the outputs that could not be rotated */
+	for (l = req->files; l != NULL; l = next)
+	{
+		next = l->next;
+		file = l->data;
+
+		if (!file->path)
+		{
+			g_free(file);
+			req->files = g_slist_delete_link(req->files, l);
+		}
+	}
+
+	if (!req->files)
+	{
+		ReplyLunaError(req->lsHandle, req->lsMessage, "Log rotation failed");
+		ForceRotateRequestFree(req);
+		return FALSE;
+	}
+
+	/* subscribers hear about the rotation now and about the files later */
+	if (LSMessageIsSubscription(req->lsMessage))
+	{
+		outputs = jarray_create(NULL);
+
+		for (l = req->files; l != NULL; l = l->next)
+		{
+			jarray_append(outputs, jstring_create(
+			                  ((ForceRotateFile *) l->data)->outputName));
+		}
+
+		reply = jobject_create();
+		jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
+		jobject_put(reply, J_CSTR_TO_JVAL("subscribed"), jboolean_create(true));
+		jobject_put(reply, J_CSTR_TO_JVAL("outputs"), outputs);
+
+		LSErrorInit(&lserror);
+
+		if (!LSMessageReply(req->lsHandle, req->lsMessage,
+		                    jvalue_tostring_simple(reply), &lserror))
+		{
+			LSErrorLog(g_context, "LSREPLY_ERROR", &lserror);
+			LSErrorFree(&lserror);
+		}
+
+		j_release(&reply);
+	}
+
+	AddHeavyOperationTask(&heavyOperationThread, ForceRotateCompress, req);
+
+	return FALSE;
+}
+
+/**
+ * @brief ForceRotateApply
+ *
+ * Runs on the main thread, so all the selected outputs are rotated at
+ * the same point of the message stream.
+ *
+ * @param userdata the ForceRotateRequest
+ *
+ * @return FALSE
+ */
+static gboolean ForceRotateApply(gpointer userdata)
+{
+	ForceRotateRequest *req = userdata;
+	PmLogFile_t        *logFileP = NULL;
+	int                 i;
+
+	if (req->outputName)
+	{
+		logFileP = FindLogFile(req->outputName);
+
+		if (!logFileP)
+		{
+			ReplyLunaError(req->lsHandle, req->lsMessage, "Unknown output");
+			ForceRotateRequestFree(req);
+			return FALSE;
+		}
+
+		ForceRotateOutput(req, logFileP);
+	}
+	else
+	{
+		for (i = 0; i < g_numOutputs; i++)
+		{
+			ForceRotateOutput(req, &g_logFiles[ i ]);
+		}
+	}
+
+	OutputBarrier(logFileP, ForceRotateRotated, req);
+
+	return FALSE;
+}
+
+/////////////////////////////////////////////////////////////////
+//                                                             //
+//            Start of API documentation comment block         //
+//                                                             //
+/////////////////////////////////////////////////////////////////
+/**
+@page com_webos_pmlogd com.webos.pmlogd
+@{
+@section com_webos_pmlogd_forcerotate forcerotate
+
+Force rotation of an output, by default the main one (/var/log/messages),
+or of all outputs at once.  All the selected outputs are rotated at the
+same point of the message stream.  The reply is sent once the rotated
+logs are compressed; a subscribed caller also gets an immediate reply
+listing the rotated outputs.
+
+@par Parameters
+
+Name | Required | Type | Description
+-----|--------|------|----------
+output | no | String | Output name, or "all"
+subscribe | no | Boolean | Get a reply when the rotation is done, then on completion
+
+@par Returns
+
+Name | Required | Type | Description
+-----|--------|------|----------
+returnValue | yes | Boolean | True on success, false otherwise
+errorText | no | String | Error text
+subscribed | no | Boolean | True in the reply sent at rotation time
+outputs | no | Array | Names of the rotated outputs, in the reply sent at rotation time
+done | no | Boolean | True in the completion reply
+files | no | Array | Objects with "output", "path", "size" and "handedOff" (true if given to rotation subscribers instead of compressed), in the completion reply
+@}
+*/
+/////////////////////////////////////////////////////////////////
+//                                                             //
+//            End of API documentation comment block           //
+//                                                             //
+/////////////////////////////////////////////////////////////////
+static bool force_rotate_ls(LSHandle *lsHandle, LSMessage *lsMessage, void *wd)
+{
+	ForceRotateRequest *req;
+	JSchemaInfo         schemainfo;
+	jvalue_ref          parsed;
+	jvalue_ref          value;
+	raw_buffer          str;
+	bool                all = false;
+
+	req = g_new0(ForceRotateRequest, 1);
+	req->lsHandle = lsHandle;
+	req->lsMessage = lsMessage;
+
+	jschema_info_init(&schemainfo, jschema_all(), NULL, NULL);
+	parsed = jdom_parse(j_cstr_to_buffer(LSMessageGetPayload(lsMessage)),
+	                    DOMOPT_NOOPT, &schemainfo);
+
+	if (jobject_get_exists(parsed, J_CSTR_TO_BUF("output"), &value))
+	{
+		str = jstring_get_fast(value);
+
+		if (str.m_str && (str.m_len == 3) && (strncmp(str.m_str, "all", 3) == 0))
+		{
+			all = true;
+		}
+		else if (str.m_str)
+		{
+			req->outputName = g_strndup(str.m_str, str.m_len);
+		}
+	}
+
+	j_release(&parsed);
+
+	/* the main log by default, as always */
+	if (!all && !req->outputName && (g_numOutputs > 0))
+	{
+		req->outputName = g_strdup(g_logFiles[ 0 ].outputName);
+	}
+
+	LSMessageRef(lsMessage);
+	g_main_context_invoke(NULL, ForceRotateApply, req);
+
+	return true;
+}
+
+/**
+@page com_webos_pmlogd com.webos.pmlogd
+@{
+@section com_webos_pmlogd_subscribe_on_rotations subscribeOnRotations
+
+Add client to rotation subscription list.  Rotated logs of the matching
+outputs are handed over to the subscribers instead of being compressed:
+each one is reported in a reply with its "filepath" and "output".  The
+file is deleted once every subscriber has acknowledged it with
+ackRotation; if a subscriber cancels its subscription or does not
+acknowledge within 10 minutes, the file is compressed into the log
+rotations instead.
+
+@par Parameters
+
+Name | Required | Type | Description
+-----|--------|------|----------
+output | no | String | Output to be notified of, all outputs if omitted
+
+@par Returns
+
+Name | Required | Type | Description
+-----|--------|------|----------
+returnValue | yes | Boolean | True on success, false otherwise
+subscribed | yes | Boolean | True if subscribed
+errorText | no | String | Error text
+@}
+*/
+/////////////////////////////////////////////////////////////////
+//                                                             //
+//            End of API documentation comment block           //
+//                                                             //
+/////////////////////////////////////////////////////////////////
+static bool subscribe_on_rotations_ls(LSHandle *lsHandle, LSMessage *lsMessage, void *wd)
+{
+	bool result = true;
+	jvalue_ref reply = jobject_create();
+	jvalue_ref parsed;
+	jvalue_ref value;
+	JSchemaInfo schemainfo;
+	raw_buffer str;
+	gchar *outputName = NULL;
+	const char *errorText = NULL;
+	RotationSubscriber *sub;
 
-			g_free(timeStamp);
-			OutputMessage(keyContextP, LOG_SYSLOG | LOG_INFO, "pmsyslogd", outMsg);
-			g_free(outMsg);
+	LSError lserror;
+	LSErrorInit(&lserror);
 
-			RBFlush(keyContextP->rb, FlushMessage, keyContextP);
+	jschema_info_init(&schemainfo, jschema_all(), NULL, NULL);
+	parsed = jdom_parse(j_cstr_to_buffer(LSMessageGetPayload(lsMessage)),
+	                    DOMOPT_NOOPT, &schemainfo);
 
-			timeStamp = MakeMessageTimestamp();
-			outMsg = g_strdup_printf("%s %s pmsyslogd: {%s}: ------ Done flushing ------\n",
-			                         timeStamp,
-			                         priStr,
-			                         keyContextP->contextName);
-			OutputMessage(keyContextP, LOG_SYSLOG | LOG_INFO, "pmsyslogd", outMsg);
+	if (jobject_get_exists(parsed, J_CSTR_TO_BUF("output"), &value))
+	{
+		str = jstring_get_fast(value);
+		outputName = str.m_str ? g_strndup(str.m_str, str.m_len) : NULL;
 
-			g_free(timeStamp);
-			g_free(outMsg);
+		if (!outputName || !FindLogFile(outputName))
+		{
+			errorText = "Unknown output";
 		}
 	}
+
+	j_release(&parsed);
+
+	if (errorText)
+	{
+		jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(false));
+		jobject_put(reply, J_CSTR_TO_JVAL("subscribed"), jboolean_create(false));
+		jobject_put(reply, J_CSTR_TO_JVAL("errorText"), jstring_create(errorText));
+		g_free(outputName);
+	}
+	else if (!LSSubscriptionAdd(lsHandle, ROTATION_SUBSCRIPTION_KEY, lsMessage, &lserror))
+	{
+		jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(false));
+		jobject_put(reply, J_CSTR_TO_JVAL("subscribed"), jboolean_create(false));
+		jobject_put(reply, J_CSTR_TO_JVAL("errorText"),
+		            jstring_create("Internal error. Can't add subscription"));
+
+		LSErrorLog(g_context, "LSSUBADD_ERROR", &lserror);
+		LSErrorFree(&lserror);
+		g_free(outputName);
+
+		result = false;
+	}
 	else
 	{
-		/* no RB, keep going */
-		DbgPrint("%s: %s doesnt have ring buffer, not flushing", __FUNCTION__, keyContextP->contextName);
+		sub = g_new0(RotationSubscriber, 1);
+		sub->lsMessage = lsMessage;
+		sub->outputName = outputName;
+		LSMessageRef(lsMessage);
+
+		g_mutex_lock(&g_rotationLock);
+		g_rotationSubscribers = g_slist_append(g_rotationSubscribers, sub);
+		g_mutex_unlock(&g_rotationLock);
+
+		jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
+		jobject_put(reply, J_CSTR_TO_JVAL("subscribed"), jboolean_create(true));
 	}
 
-	return FALSE;
+	if (!LSMessageReply(lsHandle, lsMessage,
+	                    jvalue_tostring_simple(reply),
+	                    &lserror))
+
+	{
+		LSErrorLog(g_context, "LSSUBREPLY_ERROR", &lserror);
+		LSErrorFree(&lserror);
+
+		result = false;
+	}
+
+	DbgPrint("%s called\n", __FUNCTION__);
+
+	j_release(&reply);
+	return result;
 }
 
-/**
- * @brief ParseMsgTag
- * Parse identifier which indicates whether current log
- * is from pmloglib.
- *
- * @param msg message to parse
- */
-static
-const char *ParseMsgTag(const char *msg)
+static bool sub_cancel_func(LSHandle *sh, LSMessage *reply, void *ctx)
 {
-	size_t tagLength = strlen(PMLOG_IDENTIFIER) + 1; // tag + space
+	RotationSubscriber *sub = NULL;
+	RotatedFile        *file;
+	GSList             *l;
+	GSList             *next;
+	GSList             *link;
+	const char         *sender;
 
-	if ((strlen(msg) < tagLength)  ||
-	        (strncmp(msg, PMLOG_IDENTIFIER " ", tagLength) != 0))
+	g_mutex_lock(&g_rotationLock);
+
+	for (l = g_rotationSubscribers; l != NULL; l = l->next)
 	{
-		return NULL;    // Does not start with tag
+		if (((RotationSubscriber *) l->data)->lsMessage == reply)
+		{
+			sub = l->data;
+			g_rotationSubscribers = g_slist_delete_link(g_rotationSubscribers, l);
+			break;
+		}
 	}
 
-	return msg + tagLength;
-}
+	if (sub)
+	{
+		/* the subscriber will not acknowledge the files it holds */
+		sender = LSMessageGetSender(sub->lsMessage);
 
-typedef struct _RdxReportTask
-{
-	int pri;
-	gchar *programName;
-	gchar *msg;
-} RdxReportTask;
+		for (l = g_rotatedFiles; l != NULL; l = next)
+		{
+			next = l->next;
+			file = l->data;
+			link = g_slist_find_custom(file->pending, sender,
+			                           (GCompareFunc) g_strcmp0);
 
-RdxReportTask *CreateRdxReportTask(int pri, const char *programName, const char *msg)
-{
-	RdxReportTask *ret = g_new0(RdxReportTask, 1);
-	ret->pri = pri;
-	ret->programName = g_strdup(programName);
-	ret->msg = g_strdup(msg);
-	return ret;
-}
+			if (link)
+			{
+				RotatedFileRelease(file, link, false);
+			}
+		}
 
-void DeleteRdxReportTask(RdxReportTask *task)
-{
-	g_free(task->programName);
-	task->programName = NULL;
+		LSMessageUnref(sub->lsMessage);
+		g_free(sub->outputName);
+		g_free(sub);
+	}
 
-	g_free(task->msg);
-	task->msg = NULL;
+	g_mutex_unlock(&g_rotationLock);
 
-	g_free(task);
+	DbgPrint("%s called\n", __FUNCTION__);
+
+	return true;
 }
 
-gboolean RdxLogReport(gpointer userdata)
+/////////////////////////////////////////////////////////////////
+//                                                             //
+//            Start of API documentation comment block         //
+//                                                             //
+/////////////////////////////////////////////////////////////////
+/**
+@page com_webos_pmlogd com.webos.pmlogd
+@{
+@section com_webos_pmlogd_ackrotation ackRotation
+
+Acknowledge a rotated log reported to a subscribeOnRotations caller,
+releasing the reference of the caller on it.
+
+@par Parameters
+
+Name | Required | Type | Description
+-----|--------|------|----------
+filepath | yes | String | Path of the rotated log, as reported
+
+@par Returns
+
+Name | Required | Type | Description
+-----|--------|------|----------
+returnValue | yes | Boolean | True on success, false otherwise
+errorText | no | String | Error text
+@}
+*/
+/////////////////////////////////////////////////////////////////
+//                                                             //
+//            End of API documentation comment block           //
+//                                                             //
+/////////////////////////////////////////////////////////////////
+static bool ack_rotation_ls(LSHandle *lsHandle, LSMessage *lsMessage, void *wd)
 {
-	RdxReportTask *task = (RdxReportTask *)userdata;
+	JSchemaInfo  schemainfo;
+	jvalue_ref   parsed;
+	jvalue_ref   value;
+	jvalue_ref   reply;
+	raw_buffer   str;
+	gchar       *path = NULL;
+	RotatedFile *file;
+	GSList      *l;
+	GSList      *link = NULL;
+	LSError      lserror;
 
-	RdxReportMetadata md = create_rdx_report_metadata();
-	rdx_report_metadata_set_component(md, "syslog");
-	const char *cause;
+	jschema_info_init(&schemainfo, jschema_all(), NULL, NULL);
+	parsed = jdom_parse(j_cstr_to_buffer(LSMessageGetPayload(lsMessage)),
+	                    DOMOPT_NOOPT, &schemainfo);
 
-	switch ((task->pri & LOG_PRIMASK))
+	if (jobject_get_exists(parsed, J_CSTR_TO_BUF("filepath"), &value))
 	{
-		case LOG_EMERG:
-			cause = "LOG_EMERG";
-			break;
+		str = jstring_get_fast(value);
+		path = str.m_str ? g_strndup(str.m_str, str.m_len) : NULL;
+	}
 
-		case LOG_ALERT:
-			cause = "LOG_ALERT";
-			break;
+	j_release(&parsed);
 
-		case LOG_CRIT:
-			cause = "LOG_CRIT";
-			break;
+	if (!path)
+	{
+		ReplyLunaError(lsHandle, lsMessage, "Missing filepath");
+		return true;
+	}
 
-		case LOG_ERR:
-			cause = "LOG_ERR";
-			break;
+	g_mutex_lock(&g_rotationLock);
 
-		case LOG_WARNING:
-			cause = "LOG_WARNING";
-			break;
+	for (l = g_rotatedFiles; l != NULL; l = l->next)
+	{
+		file = l->data;
 
-		case LOG_NOTICE:
-			cause = "LOG_NOTICE";
-			break;
+		if (strcmp(file->path, path) == 0)
+		{
+			link = g_slist_find_custom(file->pending, LSMessageGetSender(lsMessage),
+			                           (GCompareFunc) g_strcmp0);
 
-		case LOG_INFO:
-			cause = "LOG_INFO";
-			break;
+			if (link)
+			{
+				RotatedFileRelease(file, link, true);
+			}
 
-		case LOG_DEBUG:
-			cause = "LOG_DEBUG";
 			break;
+		}
+	}
 
-		default:
-			cause = "UNKNOWN";
+	g_mutex_unlock(&g_rotationLock);
+
+	g_free(path);
+
+	if (!link)
+	{
+		ReplyLunaError(lsHandle, lsMessage, "No pending rotation for this file");
+		return true;
 	}
 
-	rdx_report_metadata_set_cause(md, cause);
-	rdx_report_metadata_set_detail(md, task->programName);
-	rdx_make_report(md, task->msg);
-	destroy_rdx_report_metadata(md);
+	reply = jobject_create();
+	jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
 
-	DeleteRdxReportTask(task);
+	LSErrorInit(&lserror);
 
-	return FALSE;
+	if (!LSMessageReply(lsHandle, lsMessage, jvalue_tostring_simple(reply),
+	                    &lserror))
+	{
+		LSErrorLog(g_context, "LSREPLY_ERROR", &lserror);
+		LSErrorFree(&lserror);
+	}
+
+	j_release(&reply);
+
+	return true;
 }
 
-/**
- * @brief LogMessage
- * Log the message
- *
- * @param pri priority
- * @param msg message to log
- */
-static void LogMessage(int pri, const char *msg)
-{
-	size_t          msgLen;
-	gchar          *timeStamp = NULL;
-	char            priStr[ 20 ];
-	GString        *outMsg = g_string_sized_new(MAXLINE + 1);
-	char            msgProgram[ 256 ];
-	char            programName[ PMLOG_PROGRAM_MAX_NAME_LENGTH + 1 ];
-	char            contextName[ PMLOG_MAX_CONTEXT_NAME_LEN + 1 ];
-#ifdef PRODUCTION_BUILD
-	char            msgid[ MAX_MSGID_LEN + 1];
-#endif
-	const char     *msgLeft;
-	const char     *msgCurr;
-	const char     *msgNext;
-	size_t          msgProgramNameLen;
+/* number of messages per reply when streaming to a subscribed caller */
+#define DUMP_RING_BATCH_SIZE    100
 
-	timeStamp = MakeMessageTimestamp();
+/* directory of the files written by dumpRing */
+#define DUMP_RING_DIR           WEBOS_INSTALL_LOGDIR "/dumps"
 
-	/*
-	 * Remove timestamp prefix if present. Local messages should have this, remote may not.
-	 * Check for RFC 3164 timestamp  0123456789ABCDEF0 "Mmm dd hh:mm:ss " and remove it
-	 */
-	msgLen = strlen(msg);
+typedef struct _DumpRingSnapshot
+{
+	gchar              *contextName;
+	PmLogRBSnapshot_t  *snapshot;
+} DumpRingSnapshot;
 
-	if ((msgLen >= 16) &&
-	        (msg[ 3 ] == ' ') &&
-	        isdigit(msg[ 5 ]) &&
-	        (msg[ 6 ] == ' ') &&
-	        isdigit(msg[ 8 ]) &&
-	        (msg[ 9 ] == ':') &&
-	        isdigit(msg[ 10 ]) &&
-	        isdigit(msg[ 11 ]) &&
-	        (msg[ 12 ] == ':') &&
-	        isdigit(msg[ 13 ]) &&
-	        isdigit(msg[ 14 ]) &&
-	        (msg[ 15 ] == ' '))
-	{
-		msg += 16;
-		msgLen -= 16;
-	}
+typedef struct _DumpRingRequest
+{
+	LSHandle   *lsHandle;
+	LSMessage  *lsMessage;
 
-	/* look up facility + priority name from pri */
-	FormatPri(pri, priStr, sizeof(priStr));
+	/* NULL for all contexts */
+	gchar      *contextName;
 
-	g_string_printf(outMsg, "%s %s ", timeStamp, priStr);
+	/* microseconds since the epoch, 0 for no limit */
+	gint64      since;
+	gint64      until;
 
-	g_free(timeStamp);
+	/* lowest priority to include, if hasLevel: -1 ("none") for none */
+	bool        hasLevel;
+	int         level;
 
-	msgProgram[ 0 ] = 0;
-	programName[ 0 ] = 0;
-	contextName[ 0 ] = 0;
+	/* file to write to, in DUMP_RING_DIR, NULL to reply with the messages */
+	gchar      *path;
 
-	/*
-	 * msgLeft is what will actually be written to the file (possibly
-	 * after stripping some stuff off from msg prefix)
-	 */
-	msgLeft = msg; // eg "progName contextName rest_of_msg..."
+	/* DumpRingSnapshot for each context, in context order */
+	GSList     *snapshots;
+} DumpRingRequest;
 
-	/* parse off program identifier prefix */
-	msgNext = ParseMsgProgram(msgLeft, msgProgram, sizeof(msgProgram),
-	                          &msgProgramNameLen, programName, sizeof(programName));
+typedef struct _DumpRingWriter
+{
+	DumpRingRequest *req;
+	const char      *contextName;
+	FILE            *file;
+	bool             stream;
+	jvalue_ref       contexts;
+	jvalue_ref       messages;
+	int              batchCount;
+	int              numRecords;
+	unsigned long    numBytes;
+} DumpRingWriter;
 
-	if (msgNext != NULL)
+/**
+ * @brief DumpRingSendBatch
+ *
+ * Send the messages collected so far for the current context as one
+ * reply of a subscribed dumpRing call.
+ *
+ * @param writer
+ */
+static void DumpRingSendBatch(DumpRingWriter *writer)
+{
+	LSError    lserror;
+	jvalue_ref reply;
+
+	if (writer->batchCount == 0)
 	{
-		msgLeft = msgNext; /* eg "contextName rest_of_msg..." */
+		return;
 	}
 
-	/* msgCurr is where we're at in parsing */
-	msgCurr = msgLeft;
+	LSErrorInit(&lserror);
 
-	/* parse off PmLogLib pid/tid prefix */
-	msgNext = ParseMsgPidTid(msgCurr);
+	reply = jobject_create();
+	jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
+	jobject_put(reply, J_CSTR_TO_JVAL("context"),
+	            jstring_create(writer->contextName));
+	jobject_put(reply, J_CSTR_TO_JVAL("messages"), writer->messages);
 
-	if (msgNext != NULL)
+	if (!LSMessageReply(writer->req->lsHandle, writer->req->lsMessage,
+	                    jvalue_tostring_simple(reply), &lserror))
 	{
-		/* integrate into msgProgram */
-		snprintf(msgProgram + msgProgramNameLen + 1,
-		         sizeof(msgProgram) - msgProgramNameLen + 1, "%.*s",
-		         msgNext - msgCurr, msgCurr);
-
-		msgLeft = msgNext;
-		msgCurr = msgNext;
+		LSErrorLog(g_context, "LSREPLY_ERROR", &lserror);
+		LSErrorFree(&lserror);
 	}
 
-	/* Recognization for PMLOG_IDENTIFIER*/
-	msgNext = ParseMsgTag(msgCurr);
+	j_release(&reply);
 
-	if (!msgNext)
+	writer->messages = jarray_create(NULL);
+	writer->batchCount = 0;
+}
+
+/**
+ * @brief DumpRingRecord
+ *
+ * RBTraversalFunc writing the records of a snapshot that pass the
+ * request filters.
+ */
+static void DumpRingRecord(gint64 time, int pri, const char *programName,
+                           const char *msg, gpointer data)
+{
+	DumpRingWriter  *writer = data;
+	DumpRingRequest *req = writer->req;
+	size_t           msgLen;
+
+	if (req->hasLevel && ((pri & LOG_PRIMASK) > req->level))
 	{
-		// not from pmloglib
-		strcpy(contextName, LEGACY_LOG);
+		return;
 	}
-	else
-	{
-		// from pmloglib
-		msgCurr = msgNext;
-		msgLeft = msgNext;
-		/* parse off PmLogLib context identifier prefix (if present) */
-		msgNext = ParseMsgContext(msgCurr, contextName, sizeof(contextName));
 
-		if (msgNext != NULL)
-		{
-			msgCurr = msgNext;
-		}
+	if ((req->since && time < req->since) || (req->until && time > req->until))
+	{
+		return;
 	}
 
-	if (HandleLogCommand(msgCurr))
+	msgLen = strlen(msg);
+	writer->numRecords++;
+	writer->numBytes += msgLen;
+
+	if (writer->file)
 	{
-		g_string_free(outMsg, true);
+		fwrite(msg, 1, msgLen, writer->file);
 		return;
 	}
 
-	outMsg = g_string_append(outMsg, msgProgram); /* e.g "uploadd \0" */
-	outMsg = g_string_append(outMsg, msgLeft); /* "context msgid kvpair message" */
-	outMsg = g_string_append(outMsg,
-	                         "\n"); /* e.g "2008-12-08T12:17:12.824279Z [1824] user.info uploadd uploadd msgid kvpairs msg... \n" */
+	/* messages are stored with their trailing newline */
+	if (msgLen > 0 && msg[msgLen - 1] == '\n')
+	{
+		msgLen--;
+	}
 
-	PmLogContextConf_t *contextConfP = NULL;
+	jarray_append(writer->messages,
+	              jstring_create_copy(j_str_to_buffer(msg, msgLen)));
+	writer->batchCount++;
 
-	/* look up the specified context */
-	if ((contextName[ 0 ] != 0))
+	if (writer->stream && writer->batchCount >= DUMP_RING_BATCH_SIZE)
 	{
-		contextConfP = g_tree_lookup(g_contextConfs, contextName);
+		DumpRingSendBatch(writer);
 	}
+}
 
-	/* default to default context */
-	if (contextConfP == NULL)
-	{
-		contextConfP = g_tree_lookup(g_contextConfs, kPmLogDefaultContextName);
+/**
+ * @brief DumpRingRequestFree
+ *
+ * @param req
+ */
+static void DumpRingRequestFree(DumpRingRequest *req)
+{
+	GSList           *l;
+	DumpRingSnapshot *snap;
 
-		if (contextConfP == NULL)
-		{
-			DbgPrint("%s, default context not found!\n", __FUNCTION__);
-			g_string_free(outMsg, true);
-			return;
-		}
+	for (l = req->snapshots; l != NULL; l = l->next)
+	{
+		snap = l->data;
+		RBSnapshotFree(snap->snapshot);
+		g_free(snap->contextName);
+		g_free(snap);
 	}
 
-#ifdef PRODUCTION_BUILD
-        msgNext = ParseMsgID(++msgCurr, msgid, sizeof(msgid));
-
-        char context_msgid_pair[MAXLINE];
-        context_msgid_pair[0] = '\0';   // ensures the memory is an empty string
-        strncat(context_msgid_pair, contextName, sizeof(contextName));
-        strncat(context_msgid_pair, "/", 1);
-        strncat(context_msgid_pair, msgid, sizeof(msgid));
+	g_slist_free(req->snapshots);
+	LSMessageUnref(req->lsMessage);
+	g_free(req->contextName);
+	g_free(req->path);
+	g_free(req);
+}
 
-	if ((g_hash_table_lookup(whitelist_table, context_msgid_pair)) != NULL)
-	{
-		DbgPrint("Whitelisted: This message can be logged %s\n", context_msgid_pair);
-#endif
-		/* Has ring buffer */
-		if (contextConfP->rb)
+/**
+ * @brief DumpRingSerialize
+ *
+ * Heavy operation task: filter the snapshots of a dumpRing request and
+ * write them to the file or reply with them, then free the request.
+ *
+ * @param userdata the DumpRingRequest
+ *
+ * @return FALSE
+ */
+static gboolean DumpRingSerialize(gpointer userdata)
+{
+	DumpRingRequest  *req = userdata;
+	DumpRingWriter    writer;
+	DumpRingSnapshot *snap;
+	GSList           *l;
+	LSError           lserror;
+	jvalue_ref        reply;
+	jvalue_ref        entry;
+
+	memset(&writer, 0, sizeof(writer));
+	writer.req = req;
+	writer.stream = !req->path && LSMessageIsSubscription(req->lsMessage);
+
+	if (req->path)
+	{
+		int fd = -1;
+
+		/* never overwrite a file, nor follow a link */
+		if ((g_mkdir_with_parents(DUMP_RING_DIR, 0750) != 0) ||
+		        ((fd = open(req->path, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC,
+		                    0640)) < 0) ||
+		        ((writer.file = fdopen(fd, "w")) == NULL))
 		{
-			DbgPrint("%s: %s has RB\n", __FUNCTION__, contextConfP->contextName);
-			int lvl = pri & LOG_PRIMASK;
+			ReplyLunaError(req->lsHandle, req->lsMessage, strerror(errno));
 
-			if (lvl <= contextConfP->rb->flushLevel)
+			if (fd >= 0)
 			{
-				DbgPrint("%s: %s Flushing!\n", __FUNCTION__, contextConfP->contextName);
-				g_tree_foreach(g_contextConfs, FlushNotMe, contextConfP);
+				close(fd);
+			}
 
-				timeStamp = MakeMessageTimestamp();
-				char priStr2[20];
-				FormatPri(LOG_SYSLOG | LOG_INFO, priStr2, sizeof(priStr2));
-				gchar *flushMsg =
-				    g_strdup_printf("%s %s pmsyslogd: {%s}: ------ Flushing ring buffer for %s message ------\n",
-				                    timeStamp,
-				                    priStr2,
-			                            contextConfP->contextName,
-				                    priStr);
-				g_free(timeStamp);
-				OutputMessage(contextConfP, pri, "pmsyslogd", flushMsg);
+			DumpRingRequestFree(req);
+			return FALSE;
+		}
+	}
+	else if (!writer.stream)
+	{
+		writer.contexts = jarray_create(NULL);
+	}
 
-				/* Flush */
-				RBFlush(contextConfP->rb, FlushMessage, contextConfP);
-				OutputMessage(contextConfP, pri, programName, outMsg->str);
-				g_free(flushMsg);
+	for (l = req->snapshots; l != NULL; l = l->next)
+	{
+		snap = l->data;
+		writer.contextName = snap->contextName;
+		writer.messages = jarray_create(NULL);
+		writer.batchCount = 0;
 
-				timeStamp = MakeMessageTimestamp();
-				flushMsg =
-				    g_strdup_printf("%s %s pmsyslogd: {%s}: ------ Done flushing ------\n",
-				                    timeStamp,
-			                            priStr2,
-			                            contextConfP->contextName);
-				OutputMessage(contextConfP, pri, "pmsyslogd", flushMsg);
-				g_free(timeStamp);
-				g_free(flushMsg);
+		RBSnapshotForeach(snap->snapshot, DumpRingRecord, &writer);
 
-			}
-			else
-			{
-				DbgPrint("%s: %s buffering!\n", __FUNCTION__, contextConfP->contextName);
-				/* buffer */
-				char buffMsg[contextConfP->rb->bufferSize];
-				snprintf(buffMsg, sizeof(buffMsg) - 1, "%d/%s/%s", pri, programName,
-				         outMsg->str);
-				buffMsg[sizeof(buffMsg) - 1 ] = '\0';
-				RBWrite(contextConfP->rb, buffMsg, (int)strlen(buffMsg) + 1);
-			}
+		if (writer.stream)
+		{
+			DumpRingSendBatch(&writer);
+			j_release(&writer.messages);
+		}
+		else if (writer.contexts)
+		{
+			entry = jobject_create();
+			jobject_put(entry, J_CSTR_TO_JVAL("context"),
+			            jstring_create(snap->contextName));
+			jobject_put(entry, J_CSTR_TO_JVAL("messages"), writer.messages);
+			jarray_append(writer.contexts, entry);
 		}
 		else
 		{
-			OutputMessage(contextConfP, pri, programName, outMsg->str);
+			j_release(&writer.messages);
 		}
+	}
 
-#ifdef PRODUCTION_BUILD
+	reply = jobject_create();
+	jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
+	jobject_put(reply, J_CSTR_TO_JVAL("records"),
+	            jnumber_create_i32(writer.numRecords));
+	jobject_put(reply, J_CSTR_TO_JVAL("bytes"),
+	            jnumber_create_i64((int64_t) writer.numBytes));
+
+	if (writer.file)
+	{
+		if (fclose(writer.file) != 0)
+		{
+			j_release(&reply);
+			ReplyLunaError(req->lsHandle, req->lsMessage, strerror(errno));
+			DumpRingRequestFree(req);
+			return FALSE;
+		}
+
+		jobject_put(reply, J_CSTR_TO_JVAL("path"), jstring_create(req->path));
+	}
+	else if (writer.contexts)
+	{
+		jobject_put(reply, J_CSTR_TO_JVAL("contexts"), writer.contexts);
 	}
 	else
 	{
-		DbgPrint("Blacklisted: Restrict logging this message %s\n", context_msgid_pair);
+		jobject_put(reply, J_CSTR_TO_JVAL("done"), jboolean_create(true));
 	}
-#endif
 
-	g_string_free(outMsg, true);
-
-#ifdef RDX_LOG_REPORTING
-	/* RDX report */
-	int i = 0;
+	LSErrorInit(&lserror);
 
-	if ((pri & LOG_PRIMASK) <= LOG_CRIT)
+	if (!LSMessageReply(req->lsHandle, req->lsMessage,
+	                    jvalue_tostring_simple(reply), &lserror))
 	{
-		const char *black_list[] = { "rdxd", "uploadd", "pmsyslogd", "upstart", NULL };
+		LSErrorLog(g_context, "LSREPLY_ERROR", &lserror);
+		LSErrorFree(&lserror);
+	}
 
-		for (i = 0; black_list[i] != NULL; i++)
-		{
-			if (strcmp(black_list[i], programName) == 0)
-			{
-				return;
-			}
-		}
+	j_release(&reply);
+	DumpRingRequestFree(req);
+
+	return FALSE;
+}
+
+/**
+ * @brief DumpRingAddSnapshot
+ *
+ * GTraverseFunc taking a snapshot of the RB of each context matching
+ * the request.
+ *
+ * @param key context name
+ * @param value the PmLogContextConf_t
+ * @param data the DumpRingRequest
+ *
+ * @return FALSE to continue the traversal
+ */
+static gboolean DumpRingAddSnapshot(gpointer key, gpointer value,
+                                    gpointer data)
+{
+	const PmLogContextConf_t *contextConfP = value;
+	DumpRingRequest          *req = data;
+	DumpRingSnapshot         *snap;
 
-		AddHeavyOperationTask(&heavyOperationTask, RdxLogReport, CreateRdxReportTask(pri, programName, msg));
+	if (contextConfP->rb && !contextConfP->rb->isEmpty)
+	{
+		snap = g_new0(DumpRingSnapshot, 1);
+		snap->contextName = g_strdup(contextConfP->contextName);
+		snap->snapshot = RBSnapshot(contextConfP->rb);
+		req->snapshots = g_slist_prepend(req->snapshots, snap);
 	}
 
-#endif
+	return FALSE;
 }
 
 /**
- * @brief ProcessMessage
+ * @brief DumpRingTakeSnapshots
  *
- * Message processor, this is called on each message read
- * off of the /dev/log socket; it will actually parse the
- * message to calculate the priority and recreate the log
- * body to contain with printable characters.  Afterwhich
- * it will log the message.
+ * Runs on the main thread, between two messages, so the snapshots of
+ * all the requested contexts are consistent.  Copying the chunks is
+ * cheap; filtering and serializing is left to the heavy operation
+ * thread.
  *
- * @param buff the message
- * @param buffLen the length of the message
+ * @param userdata the DumpRingRequest
+ *
+ * @return FALSE
  */
-static void ProcessMessage(const char *buff, int buffLen)
+static gboolean DumpRingTakeSnapshots(gpointer userdata)
 {
-	int             pri;
-	const char     *in;
-	char            line[ MAXLINE + 1 ];
-	char           *out;
-	unsigned char   c;
+	DumpRingRequest    *req = userdata;
+	PmLogContextConf_t *contextConfP;
 
-	/*
-	 * As we are using a datagram socket, we know that buff is a
-	 * complete message that is a null-terminated string.
-	 * The caller has already verified that, so we can ignore
-	 * the specified length here and just look for the terminator.
-	 * Note: If there were embedded NUL characters in
-	 * the data that will cause the message to be truncated.
-	 */
-	(void) &buffLen;
+	if (req->contextName)
+	{
+		contextConfP = g_tree_lookup(g_contextConfs, req->contextName);
 
-	pri = LOG_USER | LOG_NOTICE;
+		if (!contextConfP)
+		{
+			ReplyLunaError(req->lsHandle, req->lsMessage, "Unknown context");
+			DumpRingRequestFree(req);
+			return FALSE;
+		}
 
-	in = buff;
+		DumpRingAddSnapshot(contextConfP->contextName, contextConfP, req);
+	}
+	else
+	{
+		g_tree_foreach(g_contextConfs, DumpRingAddSnapshot, req);
+	}
 
-	/* If string starts with "<ddd>" parse the priority */
-	if (*in == '<')
+	req->snapshots = g_slist_reverse(req->snapshots);
+
+	AddHeavyOperationTask(&heavyOperationThread, DumpRingSerialize, req);
+
+	return FALSE;
+}
+
+/////////////////////////////////////////////////////////////////
+//                                                             //
+//            Start of API documentation comment block         //
+//                                                             //
+/////////////////////////////////////////////////////////////////
+/**
+@page com_webos_pmlogd com.webos.pmlogd
+@{
+@section com_webos_pmlogd_dumpring dumpRing
+
+Snapshot the ring buffer contents of one or all contexts without
+flushing them.  Messages are written to a new file of
+/var/log/dumps if file is given;
+otherwise they are returned in the reply, or in a series of replies
+of up to 100 messages each if the call is a subscription.
+
+@par Parameters
+
+Name | Required | Type | Description
+-----|--------|------|----------
+context | no | String | Context name, all contexts if omitted or "*"
+level | no | String | Only include messages of this level or more severe; "none" includes none
+since | no | Number | Only include messages logged at or after this time (seconds since the epoch)
+until | no | Number | Only include messages logged at or before this time (seconds since the epoch)
+file | no | String | Name of a file to create in /var/log/dumps and write the messages to; it must not exist yet
+subscribe | no | Boolean | Stream the messages in several replies
+
+@par Returns
+
+Name | Required | Type | Description
+-----|--------|------|----------
+returnValue | yes | Boolean | True on success, false otherwise
+errorText | no | String | Error text
+records | no | Number | Number of messages dumped, in the final reply
+bytes | no | Number | Number of bytes of messages dumped, in the final reply
+path | no | String | File the messages were written to
+contexts | no | Array | Objects with "context" and "messages", if not subscribed and no path given
+context | no | String | Context of the messages in a streamed reply
+messages | no | Array | Messages of a streamed reply
+done | no | Boolean | True in the final streamed reply
+@}
+*/
+/////////////////////////////////////////////////////////////////
+//                                                             //
+//            End of API documentation comment block           //
+//                                                             //
+/////////////////////////////////////////////////////////////////
+static bool dump_ring_ls(LSHandle *lsHandle, LSMessage *lsMessage, void *wd)
+{
+	DumpRingRequest *req;
+	JSchemaInfo      schemainfo;
+	jvalue_ref       parsed;
+	jvalue_ref       value;
+	raw_buffer       str;
+	int64_t          seconds;
+	const char      *errorText = NULL;
+
+	jschema_info_init(&schemainfo, jschema_all(), NULL, NULL);
+	parsed = jdom_parse(j_cstr_to_buffer(LSMessageGetPayload(lsMessage)),
+	                    DOMOPT_NOOPT, &schemainfo);
+
+	if (jis_null(parsed))
+	{
+		j_release(&parsed);
+		ReplyLunaError(lsHandle, lsMessage, "Invalid payload");
+		return true;
+	}
+
+	req = g_new0(DumpRingRequest, 1);
+	req->lsHandle = lsHandle;
+	req->lsMessage = lsMessage;
+
+	if (jobject_get_exists(parsed, J_CSTR_TO_BUF("context"), &value))
 	{
-		in++;
-		pri = 0;
+		str = jstring_get_fast(value);
 
-		while (isdigit(*in))
+		if (!str.m_str || str.m_len == 0)
 		{
-			pri = pri * 10 + *in - '0';
-			in++;
+			errorText = "Invalid context";
 		}
-
-		if (*in == '>')
+		else if (strncmp(str.m_str, "*", str.m_len) != 0)
 		{
-			in++;
+			req->contextName = g_strndup(str.m_str, str.m_len);
 		}
 	}
 
-	if ((pri & LOG_FACMASK) == PMLOGDAEMON_LOG_KERN)
+	if (!errorText && jobject_get_exists(parsed, J_CSTR_TO_BUF("level"), &value))
 	{
-		pri = (pri & (~LOG_FACMASK)) | LOG_KERN;
-	}
+		gchar *level;
 
-	if (pri & ~(LOG_FACMASK | LOG_PRIMASK))
-	{
-		pri = LOG_USER | LOG_NOTICE;
-	}
+		str = jstring_get_fast(value);
+		level = str.m_str ? g_strndup(str.m_str, str.m_len) : NULL;
 
-	out = line;
+		if (!level || !ParseLevel(level, &req->level))
+		{
+			errorText = "Invalid level";
+		}
+		else
+		{
+			req->hasLevel = true;
+		}
 
-	while ((c = *in++) != 0)
+		g_free(level);
+	}
+
+	if (!errorText && jobject_get_exists(parsed, J_CSTR_TO_BUF("since"), &value))
 	{
-		if (out >= &line[ sizeof(line) - 1 ])
+		if (jnumber_get_i64(value, &seconds) != CONV_OK)
+		{
+			errorText = "Invalid since";
+		}
+		else
 		{
-			break;
+			req->since = seconds * G_USEC_PER_SEC;
 		}
+	}
 
-		if ((c == '\n') || (c == 127))
+	if (!errorText && jobject_get_exists(parsed, J_CSTR_TO_BUF("until"), &value))
+	{
+		if (jnumber_get_i64(value, &seconds) != CONV_OK)
 		{
-			*out++ = ' ';
+			errorText = "Invalid until";
 		}
-		else if (c < 0x20)
+		else
 		{
-			if (out + 1 >= &line[ sizeof(line) - 1 ])
-			{
-				break;
-			}
+			req->until = seconds * G_USEC_PER_SEC;
+		}
+	}
 
-			/*
-			 * escape control characters as printable
-			 * 0x07 => ^G, 0x08 => ^H, 0x09 => ^I, etc
-			 */
-			*out++ = '^';
-			*out++ = c ^ 0x40;
+	if (!errorText && jobject_get_exists(parsed, J_CSTR_TO_BUF("file"), &value))
+	{
+		gchar *file;
+
+		str = jstring_get_fast(value);
+		file = str.m_str ? g_strndup(str.m_str, str.m_len) : NULL;
+
+		/* a bare name, kept in DUMP_RING_DIR */
+		if (!file || (file[0] == '\0') || (strlen(file) != str.m_len) ||
+		        (strlen(file) > NAME_MAX) || strchr(file, '/') || strstr(file, ".."))
+		{
+			errorText = "Invalid file name";
 		}
 		else
 		{
-			*out++ = c;
+			req->path = g_build_filename(DUMP_RING_DIR, file, NULL);
 		}
+
+		g_free(file);
 	}
 
-	*out = 0;
-	LogMessage(pri, line);
+	j_release(&parsed);
+
+	if (errorText)
+	{
+		ReplyLunaError(lsHandle, lsMessage, errorText);
+		g_free(req->contextName);
+		g_free(req->path);
+		g_free(req);
+		return true;
+	}
+
+	/* snapshot on the main thread, serialize back on this one */
+	LSMessageRef(lsMessage);
+	g_main_context_invoke(NULL, DumpRingTakeSnapshots, req);
+
+	return true;
 }
 
-static void _SysLogMessage(const int level, const char *fmt, ...)
+/* RB size used when buffering is turned on for a context without one */
+#define CONTEXT_DEFAULT_RB_SIZE     (16 * 1024)
+
+typedef struct _ContextConfRequest
 {
-	va_list     args;
-	char        msg[ 512 ];
+	LSHandle   *lsHandle;
+	LSMessage  *lsMessage;
+	gchar      *contextName;
 
-	va_start(args, fmt);
+	/* true to revert all runtime changes of the context */
+	bool        reset;
 
-	(void) vsnprintf(msg, sizeof(msg), fmt, args);
+	bool        hasLevel;
+	int         level;
 
-	va_end(args);
+	bool        hasBuffering;
+	bool        buffering;
 
-	LogMessage(level, msg);
-}
+	/* bytes, 0 to leave unchanged */
+	int         bufferSize;
 
-static GMainLoop *mainLoop = NULL;
+	bool        hasFlushLevel;
+	int         flushLevel;
+
+	/* seconds before the changes are reverted, 0 for never */
+	int         ttl;
+} ContextConfRequest;
 
 /**
- * @brief QuitSysLogD
- * Flush all log buffers and quit.  This method is intended to be called
- * as a signal handler
+ * @brief ContextConfRequestFree
  *
- * @param sig the signal to handle
+ * @param req
  */
-static void QuitSysLogD(int sig)
+static void ContextConfRequestFree(ContextConfRequest *req)
 {
-	/* exit based on external signal */
-	DbgPrint("PROC_EXIT");
-	g_main_loop_quit(mainLoop);
+	LSMessageUnref(req->lsMessage);
+	g_free(req->contextName);
+	g_free(req);
 }
 
-
 /**
- * @brief LogConfig
- *
- * Used to log the configuration for debugging purposes.
- *
- * This is a GTraverseFunc (see glib's Balanced Binary Trees), it is passed the key and value
- * of each node, together with user_data parameter passed to g_tree_traverse().  If the function
- * returns TRUE, the traversal is stopped;  Currently it will never stop.
+ * @brief ContextOverrideRevert
  *
- * @param key a key of a GTree node
- * @param value the value corresponding to the key
- * @param data user data passed to g_tree_traversal
+ * Undo the runtime changes of a context, restoring the configured RB
+ * settings.  Messages buffered in a RB that did not exist in the
+ * configuration are output before it is freed.
  *
- * @return TRUE to stop the traversal; currently it always returns FALSE
+ * @param contextConfP
  */
-static gboolean LogConfig(gpointer key, gpointer value, gpointer data)
+static void ContextOverrideRevert(PmLogContextConf_t *contextConfP)
 {
-	const PmLogContextConf_t   *contextP = value;
-	gchar *name = (gchar *)key;
-	int j;
-
-	const PmLogFile_t  *outputP;
-	const PmLogRule_t  *ruleP;
-	char filter[32] = {0,};
-	char output[32] = {0,};
-
-	PmLogInfo(g_context, "CFG_CTX", 1, PMLOGKS("Name", name), "");
+	PmLogContextOverride_t *ov = &contextConfP->override;
 
-	for (j = 0; j < contextP->numRules; j++)
+	if (!ov->active)
 	{
-		ruleP = &contextP->rules[ j ];
-
-		outputP = &g_outputConfs[ ruleP->outputIndex ];
-
-		snprintf(filter, sizeof(filter), "%s.%s%s.%s",
-		         GetRuleFacilityStr(ruleP->facility),
-		         ruleP->levelInvert ? "!" : "",
-		         GetRuleLevelStr(ruleP->level),
-		         (ruleP->program == NULL) ? "*" : ruleP->program);
+		return;
+	}
 
-		snprintf(output, sizeof(output), "%s%s",
-		         ruleP->omitOutput ? "-" : "",
-		         outputP->outputName);
+	if (ov->expireSource)
+	{
+		g_source_remove(ov->expireSource);
+	}
 
-		PmLogInfo(g_context, "CFG_RULE", 2, PMLOGKS("Filter", filter), PMLOGKS("Output",
-		          output), "");
+	if (ov->hasRBConf && contextConfP->rb)
+	{
+		if (!ov->hadRB)
+		{
+			OutputForceLane(OUTPUT_LANE_BULK);
+			RBFlush(contextConfP->rb, FlushMessage, contextConfP);
+			OutputForceLane(OUTPUT_NUM_LANES);
+			RBFree(contextConfP->rb);
+			contextConfP->rb = NULL;
+		}
+		else
+		{
+			RBResize(contextConfP->rb, ov->bufferSize);
+			contextConfP->rb->flushLevel = ov->flushLevel;
+		}
 	}
 
-	/* return true to stop the traversal */
-	return FALSE;
+	memset(ov, 0, sizeof(*ov));
+
+	PublishContextLevels();
 
+	PmLogInfo(g_context, "CTX_OVERRIDE_REVERTED", 1,
+	          PMLOGKS("Context", contextConfP->contextName), "");
 }
 
 /**
- * @brief LogConfigInfo
+ * @brief ContextOverrideExpire
  *
- * For status reporting purposes, log out configuration information.
- * It accomplishes this by calling LogConfig on every node in the configuration
- * tree.
+ * Timeout callback reverting the runtime changes of a context when
+ * their TTL runs out.
  *
- * @see LogConfig
+ * @param userdata the PmLogContextConf_t
+ *
+ * @return FALSE to remove the source
  */
-static void LogConfigInfo(void)
+static gboolean ContextOverrideExpire(gpointer userdata)
 {
-	const PmLogFile_t  *outputP;
-	int                 i;
-
-	for (i = 0; i < g_numOutputs; i++)
-	{
-		outputP = &g_outputConfs[ i ];
+	PmLogContextConf_t *contextConfP = userdata;
 
-		PmLogInfo(g_context, "CFG_OUTPUT", 4,
-		          PMLOGKS("Name", outputP->outputName),
-		          PMLOGKS("Path", outputP->path),
-		          PMLOGKFV("Size", "%d", outputP->maxSize),
-		          PMLOGKFV("Rotations", "%d", outputP->rotations),
-		          "");
-	}
+	/* the source is removed by returning FALSE */
+	contextConfP->override.expireSource = 0;
+	ContextOverrideRevert(contextConfP);
 
-	g_tree_foreach(g_contextConfs, LogConfig, NULL);
+	return FALSE;
 }
 
 /**
- * @brief LogFileKillRotations
+ * @brief ContextConfApply
  *
- * delete the rotation files at and after the given index
+ * Runs on the main thread, where messages are routed, so the changes
+ * take effect between two messages.
  *
- * e.g
- * messages          index: 0
- * messages.0.gz     index: 1
- * messages.1.gz     index: 2
- * messages.2.gz     index: 3
- * messages.3.gz     index: 4
- * messages.4.gz     index: 5
+ * @param userdata the ContextConfRequest
  *
- * @param logFileP
- * @param start starting index to delete, see example above
+ * @return FALSE
  */
-static void
-LogFileKillRotations(PmLogFile_t *logFileP, int start)
+static gboolean ContextConfApply(gpointer userdata)
 {
-	int r = 0;
+	ContextConfRequest     *req = userdata;
+	PmLogContextConf_t     *contextConfP;
+	PmLogContextOverride_t *ov;
+	PmLogRingBuffer_t      *rb;
+	LSError                 lserror;
+	jvalue_ref              reply;
 
-	for (r = start; r < PMLOG_MAX_NUM_ROTATIONS; r++)
+	contextConfP = g_tree_lookup(g_contextConfs, req->contextName);
+
+	if (!contextConfP)
 	{
-		gchar *rotation_file = r ?
-		                       g_strdup_printf(PMLOGDAEMON_FILE_ROTATION_PATTERN, logFileP->path, r - 1) :
-		                       g_strdup(logFileP->path);
+		ReplyLunaError(req->lsHandle, req->lsMessage, "Unknown context");
+		ContextConfRequestFree(req);
+		return FALSE;
+	}
 
-		g_remove(rotation_file);
-		g_free(rotation_file);
+	ov = &contextConfP->override;
+
+	if (req->reset)
+	{
+		ContextOverrideRevert(contextConfP);
 	}
-}
+	else
+	{
+		if ((req->bufferSize || req->hasFlushLevel) && !contextConfP->rb &&
+		        !(req->hasBuffering && req->buffering))
+		{
+			ReplyLunaError(req->lsHandle, req->lsMessage,
+			               "Context has no ring buffer");
+			ContextConfRequestFree(req);
+			return FALSE;
+		}
 
+		/* remember the configured RB settings before the first change */
+		if ((req->hasBuffering || req->bufferSize || req->hasFlushLevel) &&
+		        !ov->hasRBConf)
+		{
+			ov->hasRBConf = true;
+			ov->hadRB = (contextConfP->rb != NULL);
 
-/**
- * @brief LogFileInit
- * Constructor for the logFileP; copy variables from confP and initialize
- *
- * @param logFileP logfile to initialize
- * @param confP source of initial data to copy from.
- */
-static void LogFileInit(PmLogFile_t *logFileP, const PmLogFile_t *confP)
-{
-	/* copy the fields to this struct for convenience */
-	logFileP->outputName    = confP->outputName;
-	logFileP->path          = confP->path;
-	logFileP->maxSize       = confP->maxSize;
-	logFileP->rotations     = confP->rotations;
+			if (contextConfP->rb)
+			{
+				ov->bufferSize = contextConfP->rb->bufferSize;
+				ov->flushLevel = contextConfP->rb->flushLevel;
+			}
+		}
 
-	/* make sure there are not stale rotation files around */
-	LogFileKillRotations(logFileP, logFileP->rotations + 1);
-}
+		if (req->hasLevel)
+		{
+			ov->hasLevel = true;
+			ov->level = req->level;
+		}
 
+		if (req->hasBuffering)
+		{
+			if (req->buffering)
+			{
+				if (!contextConfP->rb)
+				{
+					contextConfP->rb = RBNew(req->bufferSize ? req->bufferSize :
+					                         CONTEXT_DEFAULT_RB_SIZE, 0,
+					                         req->hasFlushLevel ? req->flushLevel : LOG_ERR,
+					                         false);
+				}
 
-/**
- * @brief HandleNewLog
- *
- * Called by Glib's mainloop when there is data in the channel
- * to read.  In  this case this is called when someone has written
- * to the unix domain socket /dev/log
- *
- * @param source the channel (/dev/log) that has data to read
- * @param condition
- * @param data
- *
- * @return
- */
-gboolean HandleNewLog(GIOChannel *source, GIOCondition condition,
-                      gpointer data)
-{
-	char buff[MAXLINE + 1];
-	ssize_t bytes;
-	int sock_fd = g_io_channel_unix_get_fd(source);
+				ov->bypassRB = false;
+			}
+			else
+			{
+				/* output what was buffered so far, in order */
+				if (contextConfP->rb && !contextConfP->rb->isEmpty)
+				{
+					OutputForceLane(OUTPUT_LANE_BULK);
+					RBFlush(contextConfP->rb, FlushMessage, contextConfP);
+					OutputForceLane(OUTPUT_NUM_LANES);
+				}
 
-	if ((condition & G_IO_IN) || (condition & G_IO_PRI))
-	{
-		bytes = recv(sock_fd, buff, sizeof(buff) - 1, 0);
+				ov->bypassRB = true;
+			}
+		}
 
-		if (bytes <= 0)
+		rb = contextConfP->rb;
+
+		if (rb && req->bufferSize)
 		{
-			DbgPrint("%s: recv returned %d", __FUNCTION__, bytes);
-			goto error;
+			RBResize(rb, req->bufferSize);
 		}
 
-		if (bytes)
+		if (rb && req->hasFlushLevel)
 		{
-			buff[bytes] = '\0';
-			#ifdef PMLOGDAEMON_ENABLE_LOGGING
-			ProcessMessage(buff, bytes);
-			#endif
+			rb->flushLevel = req->flushLevel;
 		}
-	}
-	else
-	{
-		DbgPrint("%s: unexpected watch event condition: %d\n", __FUNCTION__, condition);
-	}
 
-error:
-	/* TODO: should this ever return FALSE, to close the channel? */
-	return TRUE;
-}
+		ov->active = true;
 
-/////////////////////////////////////////////////////////////////
-//                                                             //
-//            Start of API documentation comment block         //
-//                                                             //
-/////////////////////////////////////////////////////////////////
-/**
-@page com_webos_pmlogd com.webos.pmlogd
-@{
-@section com_webos_pmlogd_backuplogs backuplogs
+		/* a new request replaces the previous TTL */
+		if (ov->expireSource)
+		{
+			g_source_remove(ov->expireSource);
+			ov->expireSource = 0;
+		}
 
-make tarball which includes all files in /var/log to
-/mnt/lg/cmn_data/var/log
+		if (req->ttl > 0)
+		{
+			ov->expireSource = g_timeout_add_seconds(req->ttl, ContextOverrideExpire,
+			                                         contextConfP);
+		}
 
-@par Returns
+		PublishContextLevels();
 
-Name | Required | Type | Description
------|--------|------|----------
-returnValue | yes | Boolean | True on success, false otherwise
-@}
-*/
-/////////////////////////////////////////////////////////////////
-//                                                             //
-//            End of API documentation comment block           //
-//                                                             //
-/////////////////////////////////////////////////////////////////
-static bool backup_logs_ls(LSHandle *lsHandle, LSMessage *lsMessage, void *wd)
-{
-	LSMessageRef(lsMessage);
+		PmLogInfo(g_context, "CTX_OVERRIDE", 3,
+		          PMLOGKS("Context", contextConfP->contextName),
+		          PMLOGKFV("Level", "%d", ov->hasLevel ? ov->level : CONF_INT_UNINIT_VALUE),
+		          PMLOGKFV("TTL", "%d", req->ttl), "");
+	}
 
-	bool          ret_val;
-	const char    *tarball = WEBOS_INSTALL_LOCALSTATEDIR "/spool/rdxd/previous_boot_logs.tar.gz";
-	const char    *src_path = WEBOS_INSTALL_LOCALSTATEDIR;
-	const char    *log_files = "`find log/ -type f -maxdepth 1`";
-	const char    *tar_options = "--absolute-names";
-	jvalue_ref    reply = NULL;
-	jschema_ref   response_schema;
+	reply = jobject_create();
+	jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
+	jobject_put(reply, J_CSTR_TO_JVAL("context"),
+	            jstring_create(contextConfP->contextName));
 
-	response_schema = jschema_parse(j_cstr_to_buffer("{}"), DOMOPT_NOOPT, NULL);
+	if (ov->hasLevel)
+	{
+		jobject_put(reply, J_CSTR_TO_JVAL("level"),
+		            jstring_create(PmLogLevelToString(ov->level)));
+	}
 
-	reply = jobject_create();
+	rb = contextConfP->rb;
+	jobject_put(reply, J_CSTR_TO_JVAL("buffering"),
+	            jboolean_create(rb && !ov->bypassRB));
 
-	gchar *tar_cmd = g_strdup_printf("cd %s; tar -czf %s %s %s", src_path, tarball, log_files, tar_options);
+	if (rb)
+	{
+		jobject_put(reply, J_CSTR_TO_JVAL("bufferSize"),
+		            jnumber_create_i32(rb->bufferSize / 1024));
+		jobject_put(reply, J_CSTR_TO_JVAL("flushLevel"),
+		            jstring_create(PmLogLevelToString(rb->flushLevel)));
+	}
 
-	PmLogDebug(g_context, "tar_cmd : %s", tar_cmd);
+	LSErrorInit(&lserror);
 
-	system(tar_cmd); // Result value cannot be used as a validation. ls-method is not a synchronous.
-	if (g_file_test(tarball, G_FILE_TEST_EXISTS))
+	if (!LSMessageReply(req->lsHandle, req->lsMessage,
+	                    jvalue_tostring_simple(reply), &lserror))
 	{
-		jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
+		LSErrorLog(g_context, "LSREPLY_ERROR", &lserror);
+		LSErrorFree(&lserror);
 	}
-	else
+
+	j_release(&reply);
+	ContextConfRequestFree(req);
+
+	return FALSE;
+}
+
+/**
+ * @brief ParseLevelParam
+ *
+ * @param parsed the payload
+ * @param key
+ * @param hasLevelP set to true if the key is present and valid
+ * @param levelP
+ *
+ * @return false if the key is present but not a valid level name
+ */
+static bool ParseLevelParam(jvalue_ref parsed, const char *key, bool *hasLevelP,
+                            int *levelP)
+{
+	jvalue_ref  value;
+	raw_buffer  str;
+	gchar      *level;
+	bool        ok;
+
+	*hasLevelP = false;
+
+	if (!jobject_get_exists(parsed, j_cstr_to_buffer(key), &value))
 	{
-		jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(false));
+		return true;
 	}
 
-	ret_val = LSMessageReply(lsHandle, lsMessage, jvalue_tostring(reply,
-	                         response_schema), &g_lsError);
-	if (!ret_val)
+	str = jstring_get_fast(value);
+
+	if (!str.m_str)
 	{
-		PmLogWarning(g_context, "LSREPLY_ERROR", 1, PMLOGKS("ErrorText",
-		             g_lsError.message), "");
+		return false;
 	}
 
-	LSMessageUnref(lsMessage);
-	j_release(&reply);
-	LSErrorFree(&g_lsError);
-	g_free(tar_cmd);
+	level = g_strndup(str.m_str, str.m_len);
+	ok = ParseLevel(level, levelP);
+	g_free(level);
 
-	return (ret_val != 0);
+	*hasLevelP = ok;
+	return ok;
 }
 
 /////////////////////////////////////////////////////////////////
@@ -2332,9 +7950,25 @@ static bool backup_logs_ls(LSHandle *lsHandle, LSMessage *lsMessage, void *wd)
 /**
 @page com_webos_pmlogd com.webos.pmlogd
 @{
-@section com_webos_pmlogd_forcerotate forcerotate
+@section com_webos_pmlogd_setcontextconf setContextConf
+
+Change the level and buffering of a context at runtime, without
+reloading the configuration.  The level replaces the level of the
+context rules and drops less severe messages.  Changes are kept until
+the TTL runs out, a reset is requested or the daemon restarts; a new
+call replaces the TTL of the previous one.
 
-Force rotates to mainstream file. /var/log/messages
+@par Parameters
+
+Name | Required | Type | Description
+-----|--------|------|----------
+context | yes | String | Context name
+reset | no | Boolean | Revert all runtime changes of the context
+level | no | String | Effective level of the context, e.g. "debug", "none"
+buffering | no | Boolean | Buffer messages in the ring buffer, or output them directly
+bufferSize | no | Number | Ring buffer size in KB
+flushLevel | no | String | Level of the messages flushing the ring buffer
+ttl | no | Number | Seconds after which the changes are reverted, never if omitted
 
 @par Returns
 
@@ -2342,6 +7976,11 @@ Name | Required | Type | Description
 -----|--------|------|----------
 returnValue | yes | Boolean | True on success, false otherwise
 errorText | no | String | Error text
+context | no | String | Context name
+level | no | String | Effective level, if changed
+buffering | no | Boolean | True if messages are buffered
+bufferSize | no | Number | Ring buffer size in KB
+flushLevel | no | String | Level of the messages flushing the ring buffer
 @}
 */
 /////////////////////////////////////////////////////////////////
@@ -2349,47 +7988,326 @@ errorText | no | String | Error text
 //            End of API documentation comment block           //
 //                                                             //
 /////////////////////////////////////////////////////////////////
-static bool force_rotate_ls(LSHandle *lsHandle, LSMessage *lsMessage, void *wd)
+static bool set_context_conf_ls(LSHandle *lsHandle, LSMessage *lsMessage,
+                                void *wd)
 {
+	ContextConfRequest *req;
+	JSchemaInfo         schemainfo;
+	jvalue_ref          parsed;
+	jvalue_ref          value;
+	raw_buffer          str;
+	int                 n;
+	const char         *errorText = NULL;
+
+	jschema_info_init(&schemainfo, jschema_all(), NULL, NULL);
+	parsed = jdom_parse(j_cstr_to_buffer(LSMessageGetPayload(lsMessage)),
+	                    DOMOPT_NOOPT, &schemainfo);
+
+	if (jis_null(parsed))
+	{
+		j_release(&parsed);
+		ReplyLunaError(lsHandle, lsMessage, "Invalid payload");
+		return true;
+	}
 
-	bool          ret_val;
-	PmLogFile_t  *logFileP;
-	jvalue_ref    reply = NULL;
-	jschema_ref   response_schema = NULL;
+	req = g_new0(ContextConfRequest, 1);
+	req->lsHandle = lsHandle;
+	req->lsMessage = lsMessage;
 
-	LSMessageRef(lsMessage);
+	if (jobject_get_exists(parsed, J_CSTR_TO_BUF("context"), &value))
+	{
+		str = jstring_get_fast(value);
 
-	reply = jobject_create();
+		if (str.m_str && str.m_len > 0)
+		{
+			req->contextName = g_strndup(str.m_str, str.m_len);
+		}
+	}
 
-	logFileP = &g_logFiles[ 0 ];
+	if (!req->contextName)
+	{
+		errorText = "Missing context";
+	}
 
-	if (ForceRotateLogFile(logFileP, false))
+	if (!errorText && jobject_get_exists(parsed, J_CSTR_TO_BUF("reset"), &value))
 	{
-		jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
+		if (jboolean_get(value, &req->reset) != CONV_OK)
+		{
+			errorText = "Invalid reset";
+		}
 	}
-	else
+
+	if (!errorText && !ParseLevelParam(parsed, "level", &req->hasLevel,
+	                                   &req->level))
 	{
-		jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(false));
-		jobject_put(reply, J_CSTR_TO_JVAL("errorText"),
-		            jstring_create("Log rotation failed"));
+		errorText = "Invalid level";
 	}
 
-	response_schema = jschema_parse(j_cstr_to_buffer("{}"), DOMOPT_NOOPT, NULL);
+	if (!errorText && jobject_get_exists(parsed, J_CSTR_TO_BUF("buffering"),
+	                                     &value))
+	{
+		if (jboolean_get(value, &req->buffering) != CONV_OK)
+		{
+			errorText = "Invalid buffering";
+		}
+
+		req->hasBuffering = true;
+	}
 
-	ret_val = LSMessageReply(lsHandle, lsMessage, jvalue_tostring(reply,
-	                         response_schema), &g_lsError);
+	if (!errorText && jobject_get_exists(parsed, J_CSTR_TO_BUF("bufferSize"),
+	                                     &value))
+	{
+		if ((jnumber_get_i32(value, &n) != CONV_OK) || (n <= 0) ||
+		        (n > INT_MAX / 1024))
+		{
+			errorText = "Invalid bufferSize";
+		}
+		else
+		{
+			req->bufferSize = n * 1024;
+		}
+	}
 
-	if (!ret_val)
+	if (!errorText && !ParseLevelParam(parsed, "flushLevel", &req->hasFlushLevel,
+	                                   &req->flushLevel))
 	{
-		PmLogError(g_context, "LSREPLY_ERROR", 1, PMLOGKS("ErrorText",
-		           g_lsError.message), "");
+		errorText = "Invalid flushLevel";
 	}
 
-	LSMessageUnref(lsMessage);
-	j_release(&reply);
-	LSErrorFree(&g_lsError);
+	if (!errorText && jobject_get_exists(parsed, J_CSTR_TO_BUF("ttl"), &value))
+	{
+		if ((jnumber_get_i32(value, &req->ttl) != CONV_OK) || (req->ttl < 0))
+		{
+			errorText = "Invalid ttl";
+		}
+	}
+
+	j_release(&parsed);
+
+	if (errorText)
+	{
+		ReplyLunaError(lsHandle, lsMessage, errorText);
+		g_free(req->contextName);
+		g_free(req);
+		return true;
+	}
+
+	/* the routing state belongs to the main thread */
+	LSMessageRef(lsMessage);
+	g_main_context_invoke(NULL, ContextConfApply, req);
+
+	return true;
+}
+
+/* maximum number of methods in lsMethod_public */
+#define LUNA_MAX_METHODS    16
+
+/* time spent in each Luna method handler, only used on the service thread */
+typedef struct _LunaMethodStats
+{
+	const char        *name;
+	LSMethodFunction   function;
+	guint              calls;
+	gint64             totalTime;
+	gint64             maxTime;
+} LunaMethodStats;
+
+static LunaMethodStats  g_lunaStats[ LUNA_MAX_METHODS ];
+static int              g_numLunaStats;
+
+/**
+ * @brief LunaDispatch
+ *
+ * Registered for every public method: call its handler and account for
+ * the time spent in it.
+ */
+static bool LunaDispatch(LSHandle *lsHandle, LSMessage *lsMessage, void *wd)
+{
+	const char      *method = LSMessageGetMethod(lsMessage);
+	LunaMethodStats *stats = NULL;
+	gint64           start;
+	gint64           elapsed;
+	bool             result;
+	int              i;
+
+	for (i = 0; i < g_numLunaStats; i++)
+	{
+		if (method && (strcmp(g_lunaStats[ i ].name, method) == 0))
+		{
+			stats = &g_lunaStats[ i ];
+			break;
+		}
+	}
+
+	if (!stats)
+	{
+		return false;
+	}
+
+	start = g_get_monotonic_time();
+	result = stats->function(lsHandle, lsMessage, wd);
+	elapsed = g_get_monotonic_time() - start;
+
+	stats->calls++;
+	stats->totalTime += elapsed;
+	stats->maxTime = MAX(stats->maxTime, elapsed);
+
+	return result;
+}
+
+/**
+ * @brief MakeLoopLagStats
+ *
+ * @param ptr
+ *
+ * @return object with the last and maximum lateness of the loop
+ */
+static jvalue_ref MakeLoopLagStats(HeavyOperationThread *ptr)
+{
+	jvalue_ref lag = jobject_create();
+
+	jobject_put(lag, J_CSTR_TO_JVAL("last"),
+	            jnumber_create_i32(g_atomic_int_get(&ptr->lastLag)));
+	jobject_put(lag, J_CSTR_TO_JVAL("max"),
+	            jnumber_create_i32(g_atomic_int_get(&ptr->maxLag)));
+
+	return lag;
+}
+
+/**
+ * @brief MakeReceiverStats
+ *
+ * @return object with the counters of the receive engine
+ */
+static jvalue_ref MakeReceiverStats(void)
+{
+	PmLogReceiverStats_t    stats;
+	jvalue_ref              receiver = jobject_create();
+
+	if (!g_receiver)
+	{
+		return receiver;
+	}
+
+	ReceiverGetStats(g_receiver, &stats);
+
+	jobject_put(receiver, J_CSTR_TO_JVAL("engine"), jstring_create(stats.engine));
+	jobject_put(receiver, J_CSTR_TO_JVAL("datagrams"),
+	            jnumber_create_i64((int64_t) stats.datagrams));
+	jobject_put(receiver, J_CSTR_TO_JVAL("batches"),
+	            jnumber_create_i64((int64_t) stats.batches));
+	jobject_put(receiver, J_CSTR_TO_JVAL("syscalls"),
+	            jnumber_create_i64((int64_t) stats.syscalls));
+	jobject_put(receiver, J_CSTR_TO_JVAL("rings"),
+	            jnumber_create_i64((int64_t) stats.rings));
+	jobject_put(receiver, J_CSTR_TO_JVAL("shmRecords"),
+	            jnumber_create_i64((int64_t) stats.shmRecords));
+	jobject_put(receiver, J_CSTR_TO_JVAL("shmBacklog"),
+	            jnumber_create_i64((int64_t) stats.shmBacklog));
+	jobject_put(receiver, J_CSTR_TO_JVAL("kernelDrops"),
+	            jnumber_create_i64((int64_t) stats.kernelDrops));
+	jobject_put(receiver, J_CSTR_TO_JVAL("receiveBuffer"),
+	            jnumber_create_i32(stats.receiveBuffer));
+	jobject_put(receiver, J_CSTR_TO_JVAL("filterLevel"),
+	            jnumber_create_i32(g_atomic_int_get(&g_logFilter.level)));
+	jobject_put(receiver, J_CSTR_TO_JVAL("filterInstructions"),
+	            jnumber_create_i32(g_atomic_int_get(&g_logFilter.instructions)));
+
+	return receiver;
+}
+
+/**
+ * @brief MakeIngestStats
+ *
+ * @return object describing the ingest pipeline, for comparing worker
+ * counts
+ */
+static jvalue_ref MakeIngestStats(void)
+{
+	jvalue_ref ingest = jobject_create();
+	jvalue_ref parsed = jarray_create(NULL);
+	int        i;
+
+	for (i = 0; i < g_ingest.numWorkers; i++)
+	{
+		jarray_append(parsed, jnumber_create_i32(
+		                  g_atomic_int_get(&g_ingest.workers[ i ].parsed)));
+	}
+
+	jobject_put(ingest, J_CSTR_TO_JVAL("workers"),
+	            jnumber_create_i32(g_ingest.numWorkers));
+	jobject_put(ingest, J_CSTR_TO_JVAL("relaxedOrder"),
+	            jboolean_create(g_ingestRelaxedOrder));
+	jobject_put(ingest, J_CSTR_TO_JVAL("parsed"), parsed);
+	jobject_put(ingest, J_CSTR_TO_JVAL("maxInFlight"),
+	            jnumber_create_i32(g_atomic_int_get(&g_ingest.maxInFlight)));
+	jobject_put(ingest, J_CSTR_TO_JVAL("binary"),
+	            jnumber_create_i32(g_atomic_int_get(&g_binaryStats.parsed)));
+	jobject_put(ingest, J_CSTR_TO_JVAL("staleContextIds"),
+	            jnumber_create_i32(g_atomic_int_get(&g_binaryStats.staleContextIds)));
+	jobject_put(ingest, J_CSTR_TO_JVAL("binaryRejected"),
+	            jnumber_create_i32(g_atomic_int_get(&g_binaryStats.rejected)));
+	jobject_put(ingest, J_CSTR_TO_JVAL("discarded"),
+	            jnumber_create_i32(g_atomic_int_get(&g_wantCache.discarded)));
+
+	return ingest;
+}
+
+/**
+ * @brief MakeAttachmentStats
+ *
+ * @return object describing the stored attachments
+ */
+static jvalue_ref MakeAttachmentStats(void)
+{
+	jvalue_ref attachments = jobject_create();
+
+	jobject_put(attachments, J_CSTR_TO_JVAL("stored"),
+	            jnumber_create_i32(g_atomic_int_get(&g_attachments.numStored)));
+	jobject_put(attachments, J_CSTR_TO_JVAL("bytes"),
+	            jnumber_create_i32(g_atomic_int_get(&g_attachments.bytes)));
+	jobject_put(attachments, J_CSTR_TO_JVAL("dropped"),
+	            jnumber_create_i32(g_atomic_int_get(&g_attachments.dropped)));
+
+	return attachments;
+}
 
-	return (ret_val != 0);
+/**
+ * @brief MakeOutputStats
+ *
+ * @return array describing the queue of each output
+ */
+static jvalue_ref MakeOutputStats(void)
+{
+	OutputExecutor *exec;
+	jvalue_ref      outputs = jarray_create(NULL);
+	jvalue_ref      entry;
+	gsize           queued;
+	int             i;
+
+	for (i = 0; i < g_numOutputExecutors; i++)
+	{
+		exec = &g_outputExecutors[ i ];
+
+		g_mutex_lock(&exec->lock);
+		queued = exec->queuedBytes;
+		g_mutex_unlock(&exec->lock);
+
+		entry = jobject_create();
+		jobject_put(entry, J_CSTR_TO_JVAL("output"),
+		            jstring_create(exec->logFileP->outputName));
+		jobject_put(entry, J_CSTR_TO_JVAL("queued"),
+		            jnumber_create_i64((int64_t) queued));
+		jobject_put(entry, J_CSTR_TO_JVAL("dropped"),
+		            jnumber_create_i32(g_atomic_int_get(
+		                                   &exec->lanes[ OUTPUT_LANE_BULK ].dropped)));
+		jobject_put(entry, J_CSTR_TO_JVAL("urgentDropped"),
+		            jnumber_create_i32(g_atomic_int_get(
+		                                   &exec->lanes[ OUTPUT_LANE_URGENT ].dropped)));
+		jarray_append(outputs, entry);
+	}
+
+	return outputs;
 }
 
 /////////////////////////////////////////////////////////////////
@@ -2400,16 +8318,25 @@ static bool force_rotate_ls(LSHandle *lsHandle, LSMessage *lsMessage, void *wd)
 /**
 @page com_webos_pmlogd com.webos.pmlogd
 @{
-@section com_webos_pmlogd_subscribe_on_rotations subscribeOnRotations
+@section com_webos_pmlogd_getstats getStats
 
-Add client to rotation subscription list
+Get the time spent handling each Luna method, and how late the Luna
+service and heavy operation threads run.  Handlers only validate the
+call and hand the work over; long operations are answered later, so
+their completion time is not included.
 
 @par Returns
 
 Name | Required | Type | Description
 -----|--------|------|----------
 returnValue | yes | Boolean | True on success, false otherwise
-errorText | no | String | Error text
+methods | yes | Array | Objects with "method", "calls", "avgTime" and "maxTime" (microseconds)
+serviceLoopLag | yes | Object | "last" and "max" lateness of the Luna service thread, in ms
+heavyLoopLag | yes | Object | "last" and "max" lateness of the heavy operation thread, in ms
+receiver | yes | Object | "engine" reading the log socket ("epoll" or "io_uring"), "datagrams" and "batches" handed to the main thread, "syscalls" made for it, "rings" of the clients logging through shared memory, "shmRecords" read from them and the "shmBacklog" bytes left in them at the last sweep, "kernelDrops" of datagrams reported by the kernel, the "receiveBuffer" bytes of the sockets, and the "filterLevel" least severe level let through by the filter of the socket (7 for all) and its "filterInstructions" (0 if none)
+ingest | yes | Object | "workers" parsing messages (0 if parsed on the main thread), "relaxedOrder", "parsed" messages per worker, "maxInFlight" messages between receiving and routing, "binary" messages parsed, of which "staleContextIds" had an outdated context id and were looked up by name, "binaryRejected" malformed ones, and the messages "discarded" before formatting as nothing would keep them
+attachments | yes | Object | Files "stored" for the attachments of messages, their "bytes", and the attachments "dropped" as not sealed memfds or too large
+outputs | yes | Array | Objects with the "output" name, the "queued" bytes of messages its thread has yet to write, and the messages "dropped" as it could not keep up, warnings and worse ("urgentDropped") having a reserved share of the queue
 @}
 */
 /////////////////////////////////////////////////////////////////
@@ -2417,63 +8344,53 @@ errorText | no | String | Error text
 //            End of API documentation comment block           //
 //                                                             //
 /////////////////////////////////////////////////////////////////
-static bool subscribe_on_rotations_ls(LSHandle *lsHandle, LSMessage *lsMessage, void *wd)
+static bool get_stats_ls(LSHandle *lsHandle, LSMessage *lsMessage, void *wd)
 {
-	bool result = true;
-	jvalue_ref reply = jobject_create();
+	LunaMethodStats *stats;
+	jvalue_ref       reply;
+	jvalue_ref       methods;
+	jvalue_ref       entry;
+	LSError          lserror;
+	int              i;
 
-	LSError lserror;
-	LSErrorInit(&lserror);
+	methods = jarray_create(NULL);
 
-	if (g_atomic_int_get(&g_haveRotSubscription) != 0)
+	for (i = 0; i < g_numLunaStats; i++)
 	{
-		jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(false));
-		jobject_put(reply, J_CSTR_TO_JVAL("subscribed"), jboolean_create(false));
-		jobject_put(reply, J_CSTR_TO_JVAL("errorText"),
-		            jstring_create("Already have a subscriber. Can't add another one."));
+		stats = &g_lunaStats[ i ];
+		entry = jobject_create();
+		jobject_put(entry, J_CSTR_TO_JVAL("method"), jstring_create(stats->name));
+		jobject_put(entry, J_CSTR_TO_JVAL("calls"),
+		            jnumber_create_i64((int64_t) stats->calls));
+		jobject_put(entry, J_CSTR_TO_JVAL("avgTime"),
+		            jnumber_create_i64(stats->calls ? stats->totalTime / stats->calls : 0));
+		jobject_put(entry, J_CSTR_TO_JVAL("maxTime"),
+		            jnumber_create_i64(stats->maxTime));
+		jarray_append(methods, entry);
 	}
-	else if (!LSSubscriptionAdd(lsHandle, ROTATION_SUBSCRIPTION_KEY, lsMessage, &lserror))
-	{
-		jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(false));
-		jobject_put(reply, J_CSTR_TO_JVAL("subscribed"), jboolean_create(false));
-		jobject_put(reply, J_CSTR_TO_JVAL("errorText"),
-		            jstring_create("Internal error. Can't add subscription"));
-
-		LSErrorLog(g_context, "LSSUBADD_ERROR", &lserror);
-		LSErrorFree(&lserror);
 
-		result = false;
-	}
-	else
-	{
-		g_atomic_int_inc(&g_haveRotSubscription);
+	reply = jobject_create();
+	jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
+	jobject_put(reply, J_CSTR_TO_JVAL("methods"), methods);
+	jobject_put(reply, J_CSTR_TO_JVAL("serviceLoopLag"),
+	            MakeLoopLagStats(&lunaServiceThread));
+	jobject_put(reply, J_CSTR_TO_JVAL("heavyLoopLag"),
+	            MakeLoopLagStats(&heavyOperationThread));
+	jobject_put(reply, J_CSTR_TO_JVAL("receiver"), MakeReceiverStats());
+	jobject_put(reply, J_CSTR_TO_JVAL("ingest"), MakeIngestStats());
+	jobject_put(reply, J_CSTR_TO_JVAL("attachments"), MakeAttachmentStats());
+	jobject_put(reply, J_CSTR_TO_JVAL("outputs"), MakeOutputStats());
 
-		jobject_put(reply, J_CSTR_TO_JVAL("returnValue"), jboolean_create(true));
-		jobject_put(reply, J_CSTR_TO_JVAL("subscribed"), jboolean_create(true));
-	}
+	LSErrorInit(&lserror);
 
-	if (!LSMessageReply(lsHandle, lsMessage,
-	                    jvalue_tostring_simple(reply),
+	if (!LSMessageReply(lsHandle, lsMessage, jvalue_tostring_simple(reply),
 	                    &lserror))
-
 	{
-		LSErrorLog(g_context, "LSSUBREPLY_ERROR", &lserror);
+		LSErrorLog(g_context, "LSREPLY_ERROR", &lserror);
 		LSErrorFree(&lserror);
-
-		result = false;
 	}
 
-	DbgPrint("%s called\n", __FUNCTION__);
-
 	j_release(&reply);
-	return result;
-}
-
-static bool sub_cancel_func(LSHandle *sh, LSMessage *reply, void *ctx)
-{
-	g_atomic_int_dec_and_test(&g_haveRotSubscription);
-
-	DbgPrint("%s called\n", __FUNCTION__);
 
 	return true;
 }
@@ -2483,6 +8400,10 @@ static LSMethod lsMethod_public[] =
 	{ "forcerotate", force_rotate_ls },
 	{ "backuplogs", backup_logs_ls },
 	{ "subscribeOnRotations", subscribe_on_rotations_ls },
+	{ "ackRotation", ack_rotation_ls },
+	{ "dumpRing", dump_ring_ls },
+	{ "setContextConf", set_context_conf_ls },
+	{ "getStats", get_stats_ls },
 	{},
 };
 
@@ -2490,6 +8411,7 @@ static bool register_luna_service(GMainLoop *mainLoop)
 {
 
 	bool result;
+	int i;
 	LSErrorInit(&g_lsError);
 
 	result = LSRegister(PMLOGD_APP_ID, &g_lsServiceHandle, &g_lsError);
@@ -2499,6 +8421,16 @@ static bool register_luna_service(GMainLoop *mainLoop)
 		return false;
 	}
 
+	/* route every method through LunaDispatch, for the stats */
+	for (i = 0; lsMethod_public[ i ].name && (i < LUNA_MAX_METHODS); i++)
+	{
+		g_lunaStats[ i ].name = lsMethod_public[ i ].name;
+		g_lunaStats[ i ].function = lsMethod_public[ i ].function;
+		lsMethod_public[ i ].function = LunaDispatch;
+	}
+
+	g_numLunaStats = i;
+
 	result = LSRegisterCategory(g_lsServiceHandle, "/", lsMethod_public, NULL, NULL,
 	                            &g_lsError);
 	if (!result)
@@ -2525,14 +8457,70 @@ static bool register_luna_service(GMainLoop *mainLoop)
 	return true;
 }
 
+/**
+ * @brief InitializeShmListener
+ *
+ * Listen for the clients asking to log through shared memory.  They
+ * keep logging to /dev/log if this fails.
+ */
+static void InitializeShmListener(void)
+{
+	struct sockaddr_un  sunx;
+	int                 sock_fd = g_handover.fds[ PMLOG_HANDOVER_FD_SHM ];
+
+	/* taken over, already listening */
+	if (sock_fd >= 0)
+	{
+		goto add;
+	}
+
+	memset(&sunx, 0, sizeof(sunx));
+	sunx.sun_family = AF_UNIX;
+	(void) strncpy(sunx.sun_path, PMLOG_SHM_SOCKET_PATH, sizeof(sunx.sun_path) - 1);
+
+	sock_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+
+	if (sock_fd < 0)
+	{
+		ErrPrint("%s: socket error: %s\n", __FUNCTION__, strerror(errno));
+		return;
+	}
+
+	if ((bind(sock_fd, (struct sockaddr *) &sunx, sizeof(sunx)) < 0) ||
+	        (chmod(PMLOG_SHM_SOCKET_PATH, 0666) < 0) ||
+	        (listen(sock_fd, 16) < 0))
+	{
+		ErrPrint("%s: error: %s\n", __FUNCTION__, strerror(errno));
+		close(sock_fd);
+		return;
+	}
+
+add:
+
+	if (!ReceiverAddShmListener(g_receiver, sock_fd))
+	{
+		close(sock_fd);
+		sock_fd = -1;
+	}
+
+	g_handover.fds[ PMLOG_HANDOVER_FD_SHM ] = sock_fd;
+}
+
 gboolean InitializeSysLogReader(gpointer user_data)
 {
     struct sockaddr_un  sunx;
 	int                 sock_fd;
 	int                 result;
-	GIOChannel         *gioch;
 	GMainLoop          *mainLoop = (GMainLoop *)user_data;
 
+	sock_fd = g_handover.fds[ PMLOG_HANDOVER_FD_LOG ];
+
+	/* taken over, already bound */
+	if (sock_fd >= 0)
+	{
+		goto add;
+	}
+
     /* create socket listener */
 	memset(&sunx, 0, sizeof(sunx));
 	sunx.sun_family = AF_UNIX;
@@ -2567,18 +8555,22 @@ gboolean InitializeSysLogReader(gpointer user_data)
 		return FALSE;
 	}
 
-	gioch = g_io_channel_unix_new(sock_fd);
+add:
 
-	if (gioch == NULL)
+	if (!ReceiverAddSocket(g_receiver, sock_fd))
 	{
-		DbgPrint("%s: channel error using fd: %d\n", __FUNCTION__, sock_fd);
+		DbgPrint("%s: receiver error using fd: %d\n", __FUNCTION__, sock_fd);
 		close(sock_fd);
+		g_handover.fds[ PMLOG_HANDOVER_FD_LOG ] = -1;
 		g_main_loop_quit(mainLoop);
 		return FALSE;
 	}
 
-	g_io_add_watch(gioch, G_IO_IN, HandleNewLog, NULL);
-	g_io_channel_unref(gioch);
+	g_handover.fds[ PMLOG_HANDOVER_FD_LOG ] = sock_fd;
+	g_logFilter.sockFd = sock_fd;
+	UpdateLogFilter();
+
+	InitializeShmListener();
 
     return FALSE;
 }
@@ -2595,11 +8587,24 @@ gboolean InitializeSysLogReader(gpointer user_data)
 static int RunSysLogD(void)
 {
 	PmLogFile_t        *logFileP;
+	sigset_t            quitSignals;
 	int                 i;
 
-	(void) signal(SIGINT, QuitSysLogD);
-	(void) signal(SIGTERM, QuitSysLogD);
-	(void) signal(SIGQUIT, QuitSysLogD);
+	(void) sigemptyset(&quitSignals);
+	(void) sigaddset(&quitSignals, SIGINT);
+	(void) sigaddset(&quitSignals, SIGTERM);
+	(void) sigaddset(&quitSignals, SIGQUIT);
+
+	/* read by the main loop; blocked before any thread is created, as
+	 * they inherit the mask */
+	(void) pthread_sigmask(SIG_BLOCK, &quitSignals, NULL);
+	g_shutdown.signalFd = signalfd(-1, &quitSignals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+	if (g_shutdown.signalFd < 0)
+	{
+		ErrPrint("%s: signalfd error: %s\n", __FUNCTION__, strerror(errno));
+		(void) pthread_sigmask(SIG_UNBLOCK, &quitSignals, NULL);
+	}
 
 	(void) signal(SIGHUP, SIG_IGN);
 	(void) signal(SIGCHLD, SIG_IGN);
@@ -2610,8 +8615,16 @@ static int RunSysLogD(void)
 		LogFileInit(logFileP, &g_outputConfs[ i ]);
 	}
 
-	/* clean up before start */
-	(void) unlink(g_pathLog);
+	/* clean up before start, unless taken over */
+	if (g_handover.fds[ PMLOG_HANDOVER_FD_LOG ] < 0)
+	{
+		(void) unlink(g_pathLog);
+	}
+
+	if (g_handover.fds[ PMLOG_HANDOVER_FD_SHM ] < 0)
+	{
+		(void) unlink(PMLOG_SHM_SOCKET_PATH);
+	}
 
 	if (!CreateHeavyOperationThread(&heavyOperationThread))
 	{
@@ -2619,6 +8632,46 @@ static int RunSysLogD(void)
 		goto error;
 	}
 
+	AttachmentsInit();
+
+	if (!StartOutputExecutors())
+	{
+		StopOutputExecutors();
+		DestroyHeavyOperationThread(&heavyOperationThread);
+		goto error;
+	}
+
+	if (!StartIngestPipeline())
+	{
+		StopIngestPipeline();
+		StopOutputExecutors();
+		DestroyHeavyOperationThread(&heavyOperationThread);
+		goto error;
+	}
+
+	if (!StartReceiver())
+	{
+		StopIngestPipeline();
+		StopOutputExecutors();
+		DestroyHeavyOperationThread(&heavyOperationThread);
+		goto error;
+	}
+
+	if (!CreateLunaServiceThread(&lunaServiceThread))
+	{
+		ErrPrint("Failed to create Luna Service Line");
+		StopReceiver();
+		StopIngestPipeline();
+		StopOutputExecutors();
+		DestroyHeavyOperationThread(&heavyOperationThread);
+		goto error;
+	}
+
+	/* clients skip formatting what would be dropped */
+	AssignContextIds();
+	g_levelPage = LevelPageNew(PMLOG_LEVEL_PAGE_PATH, g_contextEpoch);
+	PublishContextLevels();
+
 	mainLoop = g_main_loop_new(NULL, FALSE);
 
 	if (mainLoop == NULL)
@@ -2636,14 +8689,44 @@ static int RunSysLogD(void)
 
 	g_timeout_add(0, InitializeSysLogReader, mainLoop);
 
+	if (g_shutdown.signalFd >= 0)
+	{
+		(void) g_unix_fd_add(g_shutdown.signalFd, G_IO_IN, QuitSysLogD, NULL);
+	}
+
+	g_handover.listenFd = HandoverListen(PMLOG_HANDOVER_SOCKET_PATH);
+
+	if (g_handover.listenFd >= 0)
+	{
+		(void) g_unix_fd_add(g_handover.listenFd, G_IO_IN, HandleHandoverRequest, NULL);
+	}
+
 	g_main_loop_run(mainLoop);
 	g_main_loop_unref(mainLoop);
 
+	DestroyHeavyOperationThread(&lunaServiceThread);
+	LevelPageFree(g_levelPage);
+	g_levelPage = NULL;
+	StopReceiver();
+	StopIngestPipeline();
+	SaveRings();
+	StopOutputExecutors();
 	DestroyHeavyOperationThread(&heavyOperationThread);
 
 error:
 
-	(void) unlink(g_pathLog);
+	if (g_handover.listenFd >= 0)
+	{
+		close(g_handover.listenFd);
+		(void) unlink(PMLOG_HANDOVER_SOCKET_PATH);
+	}
+
+	/* the instance taking over reads them on */
+	if (!g_handover.handedOver)
+	{
+		(void) unlink(g_pathLog);
+		(void) unlink(PMLOG_SHM_SOCKET_PATH);
+	}
 
 	/* Clean up our pid file.  Not necessary, but nice to have */
 	UnlockProcess();
@@ -2701,6 +8784,18 @@ static int ParseParams(int argc, char *argv[])
 			"monotonic", 'm', 0, G_OPTION_ARG_NONE, &g_timeStampMonotonic,
 			"Include monotonic seconds in timestamp", NULL
 		},
+		{
+			"workers", 'w', 0, G_OPTION_ARG_INT, &g_ingestWorkers,
+			"Parse messages on N worker threads (0..16)", "N"
+		},
+		{
+			"relaxed-order", 'r', 0, G_OPTION_ARG_NONE, &g_ingestRelaxedOrder,
+			"Only keep the order of the messages of each program", NULL
+		},
+		{
+			"take-over", 'H', 0, G_OPTION_ARG_NONE, &g_takeOver,
+			"Take over the sockets and ring buffers of the running daemon", NULL
+		},
 		{ NULL }
 	};
 	GError *error = NULL;
@@ -2741,11 +8836,21 @@ static void InitConfig(void)
 	g_numContexts = 0;
 
 	memset(&g_outputConfs, 0, sizeof(g_outputConfs));
-	g_contextConfs = g_tree_new_full(char_array_comp_func, NULL, g_free, free);
+	g_contextConfs = g_tree_new_full(char_array_comp_func, NULL, g_free,
+	                                 DestroyContextConf);
 
 	/* TODO : Validation for result of PmLogReadConfigs() */
+	PmLogPrvReadConfigs(ParseJsonBufferPool);
+	PmLogPrvReadConfigs(ParseJsonRdxReporting);
+	PmLogPrvReadConfigs(ParseJsonReceiveBuffer);
 	PmLogPrvReadConfigs(ParseJsonOutputs);
 	PmLogPrvReadConfigs(ParseJsonContexts);
+
+	RBPoolInit(g_rbPoolBudget, g_rbPoolChunkSize);
+
+#ifdef RDX_LOG_REPORTING
+	RdxReporterInit();
+#endif
 }
 
 /**
@@ -2817,6 +8922,7 @@ static gboolean LoadWhitelist(const char *filename, GError **error)
 int main(int argc, char *argv[])
 {
 	int           result;
+	bool          takenOver = false;
 
 	PmLogGetContext(PMLODAEMON_CONTEXT, &g_context);
 
@@ -2849,8 +8955,15 @@ int main(int argc, char *argv[])
         }
 #endif
 
-	/* make sure we aren't already running */
-	if (!LockProcess("PmLogDaemon"))
+	/* wait for the running daemon to hand over and exit */
+	if (g_takeOver)
+	{
+		takenOver = TakeOver();
+	}
+
+	/* make sure we aren't already running; once the sockets are ours,
+	 * the daemon we took over from is exiting and nobody else reads them */
+	if (!LockProcess("PmLogDaemon", takenOver))
 	{
 		exit(EXIT_FAILURE);
 	}
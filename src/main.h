@@ -80,10 +80,11 @@ bool ParseKeyValue(const char *arg, char *keyBuff, size_t keyBuffSize,
 /**
  * @brief LockProcess
  *
- * Acquire the process lock (by getting an file lock on our pid file).
+ * Acquire the process lock (by getting an file lock on our pid file),
+ * waiting for the process holding it to exit if wait is true.
  * Return true on success, false if failed.
  */
-bool LockProcess(const char *component);
+bool LockProcess(const char *component, bool wait);
 
 
 /**
@@ -175,12 +176,42 @@ typedef struct
 PmLogFile_t;
 
 
+/* runtime changes to a context made over Luna, reverted on expiry */
+typedef struct
+{
+	/* true while any of the values below is in effect */
+	bool        active;
+
+	/* effective level, replacing the level of the context rules */
+	bool        hasLevel;
+	int         level;
+
+	/* true to output each message directly instead of buffering it */
+	bool        bypassRB;
+
+	/* RB settings from the configuration, restored on revert */
+	bool        hasRBConf;
+	bool        hadRB;
+	int         bufferSize;
+	int         flushLevel;
+
+	/* timeout source reverting the changes, 0 if none */
+	guint       expireSource;
+}
+PmLogContextOverride_t;
+
+
 typedef struct
 {
 	gchar  *contextName;
+
+	/* for binary messages, see AssignContextIds */
+	int         id;
+
 	PmLogRingBuffer_t *rb;
 	int         numRules;
 	PmLogRule_t rules[ PMLOG_CONTEXT_MAX_NUM_RULES ];
+	PmLogContextOverride_t override;
 }
 PmLogContextConf_t;
 
@@ -193,6 +224,29 @@ extern PmLogFile_t  g_outputConfs[ PMLOG_MAX_NUM_OUTPUTS ];
 extern int          g_numContexts;
 extern GTree        *g_contextConfs;
 
+/* global ring buffer pool settings, in bytes */
+extern int          g_rbPoolBudget;
+extern int          g_rbPoolChunkSize;
+
+/* receive buffer bounds, in bytes as SO_RCVBUF reports them */
+#define RECEIVE_BUFFER_DEFAULT_MIN      (256 * 1024)
+#define RECEIVE_BUFFER_DEFAULT_MAX      (4 * 1024 * 1024)
+
+/* receive buffer settings, see ParseJsonReceiveBuffer */
+extern int          g_receiveBufferMin;
+extern int          g_receiveBufferMax;
+
+/* RDX reporting defaults */
+#define RDX_DEFAULT_DEDUP_WINDOW        600
+#define RDX_DEFAULT_REPORTS_PER_HOUR    10
+#define RDX_DEFAULT_CONTEXT_LINES       20
+
+/* RDX reporting settings, see ParseJsonRdxReporting */
+extern GHashTable  *g_rdxBlacklist;
+extern int          g_rdxDedupWindow;
+extern int          g_rdxReportsPerHour;
+extern int          g_rdxContextLines;
+
 /**
  * @brief ParseRuleFacility
  *
@@ -213,6 +267,14 @@ bool ParseJsonOutputs(const char *file_name);
 
 bool ParseJsonContexts(const char *file_name);
 
+bool ParseJsonBufferPool(const char *file_name);
+
+bool ParseJsonRdxReporting(const char *file_name);
+
+bool ParseJsonReceiveBuffer(const char *file_name);
+
+void DestroyContextConf(gpointer data);
+
 void SetDefaultConf(void);
 
 gint char_array_comp_func(gconstpointer a, gconstpointer b, gpointer user_data);
@@ -0,0 +1,210 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2007-2014 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+/**
+ *************************************************************************
+ * @file pool.c
+ *
+ * @brief This file contains the chunk pool shared by all ring buffers.
+ *
+ * Ring buffers draw fixed-size chunks from the pool on demand instead
+ * of allocating their full bufferSize up front.  Freed chunks are kept
+ * for reuse, so the memory used for buffering never exceeds the
+ * configured budget (0 = unlimited).
+ *
+ *************************************************************************
+ */
+
+#include "pool.h"
+
+typedef struct
+{
+	/* maximum number of bytes allocated for chunks, 0 = unlimited */
+	int     budget;
+	int     chunkSize;
+
+	/* bytes allocated for chunks, either in use or on the free list */
+	int     allocated;
+	int     inUse;
+	int     peak;
+
+	PmLogRBChunk_t *freeChunks;
+}
+PmLogRBPool_t;
+
+static PmLogRBPool_t g_rbPool =
+{
+	0, RB_POOL_DEFAULT_CHUNK_SIZE, 0, 0, 0, NULL
+};
+
+
+/**
+ * @brief RBPoolInit
+ *
+ * Configure the pool.  Must be called before any chunk is allocated.
+ *
+ * @param budget maximum bytes for all ring buffers, 0 for unlimited
+ * @param chunkSize size of each chunk in bytes, 0 for the default
+ */
+void RBPoolInit(int budget, int chunkSize)
+{
+	g_assert(g_rbPool.allocated == 0);
+
+	if (chunkSize <= 0)
+	{
+		chunkSize = RB_POOL_DEFAULT_CHUNK_SIZE;
+	}
+	else if (chunkSize < RB_POOL_MIN_CHUNK_SIZE)
+	{
+		DbgPrint("%s: chunkSize must be at least %d bytes.\n", __FUNCTION__,
+		         RB_POOL_MIN_CHUNK_SIZE);
+		chunkSize = RB_POOL_MIN_CHUNK_SIZE;
+	}
+	else if (chunkSize > RB_POOL_MAX_CHUNK_SIZE)
+	{
+		DbgPrint("%s: chunkSize must be at most %d bytes.\n", __FUNCTION__,
+		         RB_POOL_MAX_CHUNK_SIZE);
+		chunkSize = RB_POOL_MAX_CHUNK_SIZE;
+	}
+
+	if (budget < 0)
+	{
+		budget = 0;
+	}
+	else if (budget > 0 && budget < chunkSize)
+	{
+		DbgPrint("%s: budget must hold at least one chunk.\n", __FUNCTION__);
+		budget = chunkSize;
+	}
+
+	g_rbPool.budget = budget;
+	g_rbPool.chunkSize = chunkSize;
+}
+
+/**
+ * @brief RBPoolChunkSize
+ *
+ * @return the size of a chunk including its header
+ */
+int RBPoolChunkSize(void)
+{
+	return g_rbPool.chunkSize;
+}
+
+/**
+ * @brief RBPoolChunkCapacity
+ *
+ * @return the number of data bytes a chunk can hold
+ */
+int RBPoolChunkCapacity(void)
+{
+	return g_rbPool.chunkSize - (int) sizeof(PmLogRBChunk_t);
+}
+
+/**
+ * @brief RBPoolAlloc
+ *
+ * Take a chunk from the pool.
+ *
+ * @return the chunk, or NULL if the budget is exhausted
+ */
+PmLogRBChunk_t *RBPoolAlloc(void)
+{
+	PmLogRBChunk_t *chunk;
+
+	if (g_rbPool.freeChunks)
+	{
+		chunk = g_rbPool.freeChunks;
+		g_rbPool.freeChunks = chunk->next;
+	}
+	else
+	{
+		if ((g_rbPool.budget > 0) &&
+		        (g_rbPool.allocated + g_rbPool.chunkSize > g_rbPool.budget))
+		{
+			return NULL;
+		}
+
+		chunk = g_malloc(g_rbPool.chunkSize);
+		g_rbPool.allocated += g_rbPool.chunkSize;
+
+		if (g_rbPool.allocated > g_rbPool.peak)
+		{
+			g_rbPool.peak = g_rbPool.allocated;
+		}
+	}
+
+	g_rbPool.inUse += g_rbPool.chunkSize;
+
+	chunk->next = NULL;
+	chunk->used = 0;
+	chunk->rawBytes = 0;
+
+	return chunk;
+}
+
+/**
+ * @brief RBPoolFree
+ *
+ * Return a chunk to the pool for reuse.
+ *
+ * @param chunk
+ */
+void RBPoolFree(PmLogRBChunk_t *chunk)
+{
+	if (chunk)
+	{
+		RBPoolFreeList(chunk, chunk, 1);
+	}
+}
+
+/**
+ * @brief RBPoolFreeList
+ *
+ * Return a linked list of chunks to the pool in constant time.
+ *
+ * @param first first chunk of the list
+ * @param last last chunk of the list
+ * @param count number of chunks in the list
+ */
+void RBPoolFreeList(PmLogRBChunk_t *first, PmLogRBChunk_t *last, int count)
+{
+	if (first)
+	{
+		g_assert(last);
+		g_rbPool.inUse -= count * g_rbPool.chunkSize;
+		last->next = g_rbPool.freeChunks;
+		g_rbPool.freeChunks = first;
+	}
+}
+
+/**
+ * @brief RBPoolGetUsage
+ *
+ * @param allocatedP set to the bytes allocated for chunks
+ * @param inUseP set to the bytes of chunks held by ring buffers
+ * @param peakP set to the highest value allocatedP has reached
+ * @param budgetP set to the configured budget, 0 for unlimited
+ */
+void RBPoolGetUsage(int *allocatedP, int *inUseP, int *peakP, int *budgetP)
+{
+	*allocatedP = g_rbPool.allocated;
+	*inUseP = g_rbPool.inUse;
+	*peakP = g_rbPool.peak;
+	*budgetP = g_rbPool.budget;
+}
@@ -0,0 +1,68 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2007-2014 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+/**
+ ***********************************************************************
+ * @file pool.h
+ *
+ * @brief This file contains definition of the chunk pool shared by all
+ * ring buffers.
+ *
+ ***********************************************************************
+ */
+
+
+#ifndef PMLOGDAEMON_POOL_H
+#define PMLOGDAEMON_POOL_H
+
+#include <stdbool.h>
+#include <glib.h>
+#include "print.h"
+
+typedef struct _PmLogRBChunk
+{
+	/* next (newer) chunk of the same ring buffer, or on the free list */
+	struct _PmLogRBChunk *next;
+
+	/* bytes of data in use, i.e. the write offset */
+	int used;
+
+	/* bytes of log records held, may exceed used if compressed */
+	int rawBytes;
+
+	char data[];
+}
+PmLogRBChunk_t;
+
+/* default and allowed chunk sizes, including the chunk header */
+#define RB_POOL_DEFAULT_CHUNK_SIZE  (4 * 1024)
+#define RB_POOL_MIN_CHUNK_SIZE      (2 * 1024)
+#define RB_POOL_MAX_CHUNK_SIZE      (64 * 1024)
+
+void RBPoolInit(int budget, int chunkSize);
+
+int RBPoolChunkSize(void);
+int RBPoolChunkCapacity(void);
+
+PmLogRBChunk_t *RBPoolAlloc(void);
+void RBPoolFree(PmLogRBChunk_t *chunk);
+void RBPoolFreeList(PmLogRBChunk_t *first, PmLogRBChunk_t *last, int count);
+
+void RBPoolGetUsage(int *allocatedP, int *inUseP, int *peakP, int *budgetP);
+
+#endif
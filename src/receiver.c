@@ -0,0 +1,1722 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2007-2014 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+/**
+ *************************************************************************
+ * @file receiver.c
+ *
+ * @brief Receiver thread.
+ *
+ * The log sockets are read on a dedicated thread running an
+ * edge-triggered epoll loop, draining every socket until it would
+ * block.  Datagrams are handed over to the main thread in batches:
+ * a batch is handed over when it is full or when the timerfd started
+ * by its first datagram expires, and the main thread is woken through
+ * an eventfd, once per batch rather than once per datagram.
+ *
+ * When built with io_uring support and the kernel allows it, sockets
+ * are read instead with multishot receives into a ring of provided
+ * buffers, so a single io_uring_enter reaps any number of datagrams.
+ *
+ * A datagram may come with a descriptor passed as SCM_RIGHTS, handed
+ * over along with it; any other one is closed.
+ *
+ * Sockets report the datagrams the kernel dropped with SO_RXQ_OVFL, and
+ * their receive buffers follow the bursts and drops seen (see
+ * ReceiverTune).  Datagrams are stamped by the kernel on arrival
+ * (SO_TIMESTAMPNS), however late they are read.
+ *
+ * Clients may also log through shared memory rings (see shmring.h),
+ * registered and drained on this thread.  Their descriptors are watched
+ * by a second epoll set, itself watched by either engine.
+ *
+ *************************************************************************
+ */
+
+#define _GNU_SOURCE
+
+#include "receiver.h"
+#include "shmring.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#ifdef HAVE_IO_URING
+#include <poll.h>
+#include <liburing.h>
+#endif
+
+/* datagrams in a batch */
+#define RECEIVER_BATCH_MAX          256
+
+/* how long the first datagram of a batch may wait for others, in ns */
+#define RECEIVER_HANDOFF_DELAY      (2 * 1000 * 1000)
+
+/* datagrams handed over but not taken yet, beyond which sockets are
+ * left to the kernel buffers until the main thread catches up */
+#define RECEIVER_MAX_QUEUED         4096
+
+#define RECEIVER_MAX_EVENTS         16
+
+#define RECEIVER_MAX_SOCKETS        8
+
+/* descriptors received along with a datagram, all but the first are
+ * closed; then the drop counter and the arrival time */
+#define RECEIVER_MAX_FDS            4
+#define RECEIVER_CONTROL_LEN        (CMSG_SPACE(RECEIVER_MAX_FDS * sizeof(int)) + \
+                                     CMSG_SPACE(sizeof(uint32_t)) + \
+                                     CMSG_SPACE(sizeof(struct timespec)))
+
+/* how often the receive buffers are resized, in us */
+#define RECEIVER_TUNE_INTERVAL      (1000 * 1000)
+
+/* intervals with small bursts before a receive buffer is halved */
+#define RECEIVER_SHRINK_INTERVALS   60
+
+/* clients logging through shared memory, and the bytes of their rings */
+#define RECEIVER_MAX_RINGS          32
+#define RECEIVER_RING_SIZE          (256 * 1024)
+
+/* how often the rings are drained if their watermark isn't reached, in ns */
+#define RECEIVER_SWEEP_INTERVAL     (50 * 1000 * 1000)
+
+/* what a descriptor watched by shmEpollFd is, with the slot of its
+ * client in the low 32 bits */
+#define RECEIVER_SHM_LISTEN         (1ULL << 32)
+#define RECEIVER_SHM_SWEEP          (2ULL << 32)
+#define RECEIVER_SHM_WAKE           (3ULL << 32)
+#define RECEIVER_SHM_CONN           (4ULL << 32)
+
+#ifdef HAVE_IO_URING
+#define RECEIVER_URING_ENTRIES      64
+
+/* provided receive buffers, a power of 2 */
+#define RECEIVER_URING_BUFFERS      256
+#define RECEIVER_URING_GROUP        0
+
+/* user data of the requests other than the socket receives, which use
+ * the index of the socket */
+#define RECEIVER_TAG_TIMER          (RECEIVER_MAX_SOCKETS)
+#define RECEIVER_TAG_WAKE           (RECEIVER_MAX_SOCKETS + 1)
+#define RECEIVER_TAG_CANCEL         (RECEIVER_MAX_SOCKETS + 2)
+#define RECEIVER_TAG_SHM            (RECEIVER_MAX_SOCKETS + 3)
+#endif
+
+/* a client logging through shared memory */
+typedef struct
+{
+	int                 connFd;
+	PmLogShmRing_t     *ring;
+} ReceiverShmClient;
+
+/* what the kernel buffered and dropped for a socket */
+typedef struct
+{
+	/* last value of the drop counter, and at the last tuning */
+	guint32             overflow;
+	guint32             tunedOverflow;
+
+	/* bytes read since the socket was last empty, and the most since
+	 * the last tuning */
+	gsize               burst;
+	gsize               peakBurst;
+
+	/* as reported by SO_RCVBUF */
+	int                 rcvBuf;
+	int                 quietIntervals;
+} ReceiverSocketLoad;
+
+struct _PmLogReceiver
+{
+	GThread        *thrd;
+	int             maxLen;
+
+	int             epollFd;
+	int             timerFd;
+
+	/* written by the main thread to resume reading or to quit */
+	int             wakeFd;
+
+	/* written by the receiver when batches are handed over */
+	int             handoffFd;
+
+	/* sockets read, added by the main thread */
+	int             sockets[ RECEIVER_MAX_SOCKETS ];
+	gint            numSockets;
+
+	/* only used by the receiver thread, once a socket is added */
+	ReceiverSocketLoad  loads[ RECEIVER_MAX_SOCKETS ];
+	gint64              lastTune;
+
+	/* bounds of the receive buffers, 0 to leave them alone */
+	int             rcvBufMin;
+	int             rcvBufMax;
+
+	/* shared memory registrations, rings and sweep timer */
+	int                 shmEpollFd;
+	int                 shmListenFd;
+	int                 sweepFd;
+	ReceiverShmClient   clients[ RECEIVER_MAX_RINGS ];
+	gint                numRings;
+	gint                shmBacklog;
+
+	/* batch being filled, only used by the receiver thread */
+	GPtrArray      *batch;
+	bool            timerArmed;
+
+	/* batches handed over */
+	GAsyncQueue    *batches;
+	gint            queued;
+
+	gint            stalled;
+	gint            quit;
+
+	/* see PmLogReceiverStats_t */
+	gint            numDatagrams;
+	gint            numBatches;
+	gint            numSyscalls;
+	gint            numShmRecords;
+	gint            numKernelDrops;
+	gint            rcvBufTotal;
+
+#ifdef HAVE_IO_URING
+	bool                        uring;
+	struct io_uring             ring;
+	struct io_uring_buf_ring   *bufRing;
+	char                       *bufs;
+
+	/* size of the provided buffers: recvmsg header, control and payload */
+	gsize                       bufLen;
+
+	/* template of the multishot receives */
+	struct msghdr               msg;
+
+	/* sockets with a multishot receive in flight */
+	bool                        armed[ RECEIVER_MAX_SOCKETS ];
+#endif
+};
+
+/**
+ * @brief ReceiverDatagramFree
+ *
+ * @param data the PmLogDatagram_t
+ */
+static void ReceiverDatagramFree(gpointer data)
+{
+	PmLogDatagram_t *dgram = data;
+
+	if (dgram->attachFd >= 0)
+	{
+		close(dgram->attachFd);
+	}
+
+	g_free(dgram);
+}
+
+/**
+ * @brief ReceiverControl
+ *
+ * Keep the first descriptor passed with a datagram, close the others,
+ * count the datagrams the kernel dropped before it, and get its arrival
+ * time.
+ *
+ * @param rx
+ * @param slot of the socket
+ * @param cmsg control message of the datagram
+ * @param fdP the descriptor kept, -1 if none yet
+ * @param timeP set to the arrival time, tv_sec left -1 if none
+ */
+static void ReceiverControl(PmLogReceiver_t *rx, int slot, struct cmsghdr *cmsg,
+                            int *fdP, struct timeval *timeP)
+{
+	ReceiverSocketLoad *load = &rx->loads[ slot ];
+	struct timespec     stamp;
+	guint32             overflow;
+	int                 fd;
+	size_t              i;
+
+	if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_TIMESTAMPNS))
+	{
+		memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+		timeP->tv_sec = stamp.tv_sec;
+		timeP->tv_usec = stamp.tv_nsec / 1000;
+		return;
+	}
+
+	if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SO_RXQ_OVFL))
+	{
+		/* cumulative, wrapping around */
+		memcpy(&overflow, CMSG_DATA(cmsg), sizeof(overflow));
+		g_atomic_int_add(&rx->numKernelDrops, (gint)(overflow - load->overflow));
+		load->overflow = overflow;
+		return;
+	}
+
+	if ((cmsg->cmsg_level != SOL_SOCKET) || (cmsg->cmsg_type != SCM_RIGHTS))
+	{
+		return;
+	}
+
+	for (i = 0; i < (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int); i++)
+	{
+		memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+
+		if (*fdP < 0)
+		{
+			*fdP = fd;
+		}
+		else
+		{
+			close(fd);
+		}
+	}
+}
+
+/**
+ * @brief ReceiverHandoff
+ *
+ * Hand the current batch over to the main thread.
+ *
+ * @param rx
+ */
+static void ReceiverHandoff(PmLogReceiver_t *rx)
+{
+	struct itimerspec   disarm;
+	uint64_t            one = 1;
+
+	if (rx->timerArmed)
+	{
+		memset(&disarm, 0, sizeof(disarm));
+		(void) timerfd_settime(rx->timerFd, 0, &disarm, NULL);
+		g_atomic_int_inc(&rx->numSyscalls);
+		rx->timerArmed = false;
+	}
+
+	if (rx->batch->len == 0)
+	{
+		return;
+	}
+
+	g_atomic_int_add(&rx->queued, rx->batch->len);
+	g_atomic_int_add(&rx->numDatagrams, rx->batch->len);
+	g_atomic_int_inc(&rx->numBatches);
+	g_async_queue_push(rx->batches, rx->batch);
+	rx->batch = g_ptr_array_new_with_free_func(ReceiverDatagramFree);
+
+	if (write(rx->handoffFd, &one, sizeof(one)) != sizeof(one))
+	{
+		ErrPrint("%s: eventfd write error: %s\n", __FUNCTION__, strerror(errno));
+	}
+
+	g_atomic_int_inc(&rx->numSyscalls);
+}
+
+/**
+ * @brief ReceiverQueue
+ *
+ * Add a datagram to the current batch.
+ *
+ * @param rx
+ * @param data
+ * @param bytes
+ * @param time when it was logged, NULL for now
+ * @param attachFd passed with it, -1 if none
+ */
+static void ReceiverQueue(PmLogReceiver_t *rx, const char *data, size_t bytes,
+                          const struct timeval *time, int attachFd)
+{
+	PmLogDatagram_t    *dgram;
+	struct itimerspec   deadline;
+
+	dgram = g_malloc(sizeof(PmLogDatagram_t) + bytes + 1);
+
+	if (time)
+	{
+		dgram->time = *time;
+	}
+	else
+	{
+		(void) gettimeofday(&dgram->time, NULL);
+	}
+
+	dgram->len = (int) bytes;
+	dgram->attachFd = attachFd;
+	memcpy(dgram->buff, data, bytes);
+	dgram->buff[ bytes ] = '\0';
+	g_ptr_array_add(rx->batch, dgram);
+
+	if (rx->batch->len >= RECEIVER_BATCH_MAX)
+	{
+		ReceiverHandoff(rx);
+	}
+	else if (!rx->timerArmed)
+	{
+		memset(&deadline, 0, sizeof(deadline));
+		deadline.it_value.tv_nsec = RECEIVER_HANDOFF_DELAY;
+		(void) timerfd_settime(rx->timerFd, 0, &deadline, NULL);
+		g_atomic_int_inc(&rx->numSyscalls);
+		rx->timerArmed = true;
+	}
+}
+
+/**
+ * @brief ReceiverStall
+ *
+ * @param rx
+ *
+ * @return true if the main thread is too far behind: reading stops
+ * until it resumes it from ReceiverTakeBatch
+ */
+static bool ReceiverStall(PmLogReceiver_t *rx)
+{
+	if (g_atomic_int_get(&rx->queued) < RECEIVER_MAX_QUEUED)
+	{
+		return false;
+	}
+
+	g_atomic_int_set(&rx->stalled, 1);
+
+	/* the main thread may have caught up meanwhile */
+	if (g_atomic_int_get(&rx->queued) >= RECEIVER_MAX_QUEUED)
+	{
+		return true;
+	}
+
+	g_atomic_int_set(&rx->stalled, 0);
+
+	return false;
+}
+
+/**
+ * @brief ReceiverBurstEnd
+ *
+ * The socket was read empty: what was read since then was a burst.
+ *
+ * @param rx
+ * @param slot
+ */
+static void ReceiverBurstEnd(PmLogReceiver_t *rx, int slot)
+{
+	ReceiverSocketLoad *load = &rx->loads[ slot ];
+
+	load->peakBurst = MAX(load->peakBurst, load->burst);
+	load->burst = 0;
+}
+
+/**
+ * @brief ReceiverSetRcvBuf
+ *
+ * @param fd
+ * @param size as SO_RCVBUF reports it, twice what is set
+ *
+ * @return the size now reported, -1 on failure
+ */
+static int ReceiverSetRcvBuf(int fd, int size)
+{
+	socklen_t   len = sizeof(size);
+	int         half = size / 2;
+
+	/* beyond net.core.rmem_max with CAP_NET_ADMIN */
+	if ((setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &half, sizeof(half)) != 0) &&
+	        (setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &half, sizeof(half)) != 0))
+	{
+		ErrPrint("%s: setsockopt error: %s\n", __FUNCTION__, strerror(errno));
+	}
+
+	if (getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, &len) != 0)
+	{
+		return -1;
+	}
+
+	return size;
+}
+
+/**
+ * @brief ReceiverTune
+ *
+ * Every RECEIVER_TUNE_INTERVAL, double the receive buffer of a socket
+ * that dropped datagrams or had a burst more than half its size.  Halve
+ * it after RECEIVER_SHRINK_INTERVALS with bursts under an eighth.
+ *
+ * @param rx
+ */
+static void ReceiverTune(PmLogReceiver_t *rx)
+{
+	ReceiverSocketLoad *load;
+	gint64              now;
+	int                 total = 0;
+	int                 size;
+	int                 i;
+
+	if (rx->rcvBufMax <= 0)
+	{
+		return;
+	}
+
+	now = g_get_monotonic_time();
+
+	if (now - rx->lastTune < RECEIVER_TUNE_INTERVAL)
+	{
+		return;
+	}
+
+	rx->lastTune = now;
+
+	for (i = 0; i < g_atomic_int_get(&rx->numSockets); i++)
+	{
+		load = &rx->loads[ i ];
+		size = load->rcvBuf;
+
+		if ((load->overflow != load->tunedOverflow) ||
+		        (load->peakBurst * 2 > (gsize) load->rcvBuf))
+		{
+			size = load->rcvBuf * 2;
+			load->quietIntervals = 0;
+		}
+		else if (load->peakBurst * 8 >= (gsize) load->rcvBuf)
+		{
+			/* shrink only after consecutive quiet intervals */
+			load->quietIntervals = 0;
+		}
+		else if (++load->quietIntervals >= RECEIVER_SHRINK_INTERVALS)
+		{
+			size = load->rcvBuf / 2;
+			load->quietIntervals = 0;
+		}
+
+		size = CLAMP(size, rx->rcvBufMin, rx->rcvBufMax);
+
+		if ((size != load->rcvBuf) &&
+		        ((size = ReceiverSetRcvBuf(rx->sockets[ i ], size)) > 0))
+		{
+			load->rcvBuf = size;
+		}
+
+		load->tunedOverflow = load->overflow;
+		load->peakBurst = 0;
+		total += load->rcvBuf;
+	}
+
+	g_atomic_int_set(&rx->rcvBufTotal, total);
+}
+
+/**
+ * @brief ReceiverDrain
+ *
+ * Read a socket until it would block, or until the main thread is too
+ * far behind.
+ *
+ * @param rx
+ * @param slot of the socket
+ * @param buff
+ *
+ * @return false if reading was stopped before the socket was empty
+ */
+static bool ReceiverDrain(PmLogReceiver_t *rx, int slot, char *buff)
+{
+	int                 fd = rx->sockets[ slot ];
+	char                control[ RECEIVER_CONTROL_LEN ];
+	struct msghdr       msg;
+	struct iovec        iov;
+	struct cmsghdr     *cmsg;
+	struct timeval      time;
+	ssize_t             bytes;
+	int                 attachFd;
+
+	for (;;)
+	{
+		if (ReceiverStall(rx))
+		{
+			return false;
+		}
+
+		memset(&msg, 0, sizeof(msg));
+		iov.iov_base = buff;
+		iov.iov_len = rx->maxLen;
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		bytes = recvmsg(fd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+		g_atomic_int_inc(&rx->numSyscalls);
+
+		if (bytes < 0)
+		{
+			if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+			{
+				ErrPrint("%s: recv error: %s\n", __FUNCTION__, strerror(errno));
+			}
+
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			ReceiverBurstEnd(rx, slot);
+
+			return true;
+		}
+
+		attachFd = -1;
+		time.tv_sec = -1;
+		rx->loads[ slot ].burst += (gsize) bytes;
+
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+		{
+			ReceiverControl(rx, slot, cmsg, &attachFd, &time);
+		}
+
+		if (bytes == 0)
+		{
+			if (attachFd >= 0)
+			{
+				close(attachFd);
+			}
+
+			continue;
+		}
+
+		ReceiverQueue(rx, buff, (size_t) bytes, (time.tv_sec >= 0) ? &time : NULL,
+		              attachFd);
+	}
+}
+
+/**
+ * @brief ReceiverShmRecord
+ *
+ * @param msg
+ * @param len
+ * @param time
+ * @param data the PmLogReceiver_t
+ *
+ * @return false once the main thread is too far behind, unless
+ * quitting: the rings are emptied then
+ */
+static bool ReceiverShmRecord(const char *msg, size_t len,
+                              const struct timeval *time, gpointer data)
+{
+	PmLogReceiver_t *rx = data;
+
+	ReceiverQueue(rx, msg, len, time, -1);
+
+	return g_atomic_int_get(&rx->quit) || !ReceiverStall(rx);
+}
+
+/**
+ * @brief ReceiverShmWatch
+ *
+ * @param rx
+ * @param fd
+ * @param flags epoll event flags
+ * @param tag
+ *
+ * @return true on success
+ */
+static bool ReceiverShmWatch(PmLogReceiver_t *rx, int fd, uint32_t flags,
+                             uint64_t tag)
+{
+	struct epoll_event event;
+
+	memset(&event, 0, sizeof(event));
+	event.events = flags;
+	event.data.u64 = tag;
+
+	if (epoll_ctl(rx->shmEpollFd, EPOLL_CTL_ADD, fd, &event) != 0)
+	{
+		ErrPrint("%s: epoll_ctl error: %s\n", __FUNCTION__, strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief ReceiverSweep
+ *
+ * Start the sweep timer with the first ring, stop it with the last.
+ *
+ * @param rx
+ */
+static void ReceiverSweep(PmLogReceiver_t *rx)
+{
+	struct itimerspec interval;
+
+	memset(&interval, 0, sizeof(interval));
+
+	if (g_atomic_int_get(&rx->numRings) > 0)
+	{
+		interval.it_value.tv_nsec = RECEIVER_SWEEP_INTERVAL;
+		interval.it_interval.tv_nsec = RECEIVER_SWEEP_INTERVAL;
+	}
+
+	(void) timerfd_settime(rx->sweepFd, 0, &interval, NULL);
+}
+
+/**
+ * @brief ReceiverShmClose
+ *
+ * Drain the ring of a client one last time and release it.
+ *
+ * @param rx
+ * @param slot
+ */
+static void ReceiverShmClose(PmLogReceiver_t *rx, guint slot)
+{
+	ReceiverShmClient *client = &rx->clients[ slot ];
+
+	if (!client->ring)
+	{
+		return;
+	}
+
+	(void) ShmRingDrain(client->ring, ReceiverShmRecord, rx);
+
+	/* closing the descriptors removes them from shmEpollFd */
+	close(client->connFd);
+	ShmRingFree(client->ring);
+	client->connFd = -1;
+	client->ring = NULL;
+
+	if (g_atomic_int_dec_and_test(&rx->numRings))
+	{
+		ReceiverSweep(rx);
+	}
+}
+
+/**
+ * @brief ReceiverShmDrain
+ *
+ * @param rx
+ * @param slot
+ */
+static void ReceiverShmDrain(PmLogReceiver_t *rx, guint slot)
+{
+	ReceiverShmClient  *client = &rx->clients[ slot ];
+	int                 count;
+
+	if (!client->ring ||
+	        (g_atomic_int_get(&rx->stalled) && !g_atomic_int_get(&rx->quit)))
+	{
+		return;
+	}
+
+	count = ShmRingDrain(client->ring, ReceiverShmRecord, rx);
+
+	if (count < 0)
+	{
+		ErrPrint("%s: dropping corrupt ring\n", __FUNCTION__);
+		ReceiverShmClose(rx, slot);
+		return;
+	}
+
+	g_atomic_int_add(&rx->numShmRecords, count);
+}
+
+/**
+ * @brief ReceiverShmAccept
+ *
+ * Hand a ring over to a newly connected client, or disconnect it if
+ * there are too many: it keeps logging to the socket then.
+ *
+ * @param rx
+ * @param connFd
+ */
+static void ReceiverShmAccept(PmLogReceiver_t *rx, int connFd)
+{
+	ReceiverShmClient  *client = NULL;
+	PmLogShmRing_t     *ring;
+	struct msghdr       msg;
+	struct iovec        iov;
+	struct cmsghdr     *cmsg;
+	char                control[ CMSG_SPACE(2 * sizeof(int)) ];
+	int                 fds[ 2 ];
+	char                version = PMLOG_SHM_VERSION;
+	guint               slot;
+
+	for (slot = 0; slot < RECEIVER_MAX_RINGS; slot++)
+	{
+		if (!rx->clients[ slot ].ring)
+		{
+			client = &rx->clients[ slot ];
+			break;
+		}
+	}
+
+	if (!client || !(ring = ShmRingNew(RECEIVER_RING_SIZE, (guint32) rx->maxLen)))
+	{
+		close(connFd);
+		return;
+	}
+
+	fds[ 0 ] = ShmRingMemFd(ring);
+	fds[ 1 ] = ShmRingEventFd(ring);
+
+	memset(&msg, 0, sizeof(msg));
+	memset(control, 0, sizeof(control));
+	iov.iov_base = &version;
+	iov.iov_len = sizeof(version);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+	if ((sendmsg(connFd, &msg, MSG_NOSIGNAL) != (ssize_t) sizeof(version)) ||
+	        !ReceiverShmWatch(rx, fds[ 1 ], EPOLLIN, RECEIVER_SHM_WAKE | slot) ||
+	        !ReceiverShmWatch(rx, connFd, EPOLLIN | EPOLLRDHUP,
+	                          RECEIVER_SHM_CONN | slot))
+	{
+		ErrPrint("%s: failed to hand the ring over: %s\n", __FUNCTION__,
+		         strerror(errno));
+		close(connFd);
+		ShmRingFree(ring);
+		return;
+	}
+
+	g_atomic_int_add(&rx->numSyscalls, 3);
+
+	ShmRingCloseMemFd(ring);
+	client->connFd = connFd;
+	client->ring = ring;
+
+	if (g_atomic_int_add(&rx->numRings, 1) == 0)
+	{
+		ReceiverSweep(rx);
+	}
+}
+
+/**
+ * @brief ReceiverShmDrainAll
+ *
+ * @param rx
+ */
+static void ReceiverShmDrainAll(PmLogReceiver_t *rx)
+{
+	guint   slot;
+	guint   backlog = 0;
+
+	for (slot = 0; slot < RECEIVER_MAX_RINGS; slot++)
+	{
+		ReceiverShmDrain(rx, slot);
+
+		if (rx->clients[ slot ].ring)
+		{
+			backlog += ShmRingUsed(rx->clients[ slot ].ring);
+		}
+	}
+
+	g_atomic_int_set(&rx->shmBacklog, (gint) backlog);
+}
+
+/**
+ * @brief ReceiverShmEvents
+ *
+ * Handle what is pending on shmEpollFd: registrations, wakeups,
+ * disconnections and sweeps.
+ *
+ * @param rx
+ */
+static void ReceiverShmEvents(PmLogReceiver_t *rx)
+{
+	struct epoll_event  events[ RECEIVER_MAX_EVENTS ];
+	uint64_t            count;
+	guint               slot;
+	char                byte;
+	int                 fd;
+	int                 n;
+	int                 i;
+
+	do
+	{
+		n = epoll_wait(rx->shmEpollFd, events, RECEIVER_MAX_EVENTS, 0);
+		g_atomic_int_inc(&rx->numSyscalls);
+
+		for (i = 0; i < n; i++)
+		{
+			slot = (guint)(events[ i ].data.u64 & G_MAXUINT32);
+
+			switch (events[ i ].data.u64 & ~(uint64_t) G_MAXUINT32)
+			{
+				case RECEIVER_SHM_LISTEN:
+					while ((fd = accept4(rx->shmListenFd, NULL, NULL,
+					                     SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+					{
+						ReceiverShmAccept(rx, fd);
+					}
+
+					break;
+
+				case RECEIVER_SHM_SWEEP:
+					(void) read(rx->sweepFd, &count, sizeof(count));
+					ReceiverShmDrainAll(rx);
+					break;
+
+				case RECEIVER_SHM_WAKE:
+					if (rx->clients[ slot ].ring)
+					{
+						(void) read(ShmRingEventFd(rx->clients[ slot ].ring), &count,
+						            sizeof(count));
+						ReceiverShmDrain(rx, slot);
+					}
+
+					break;
+
+				case RECEIVER_SHM_CONN:
+					/* clients aren't expected to send anything */
+					if (rx->clients[ slot ].ring &&
+					        ((recv(rx->clients[ slot ].connFd, &byte, sizeof(byte),
+					               MSG_DONTWAIT) != -1) || (errno != EAGAIN)))
+					{
+						ReceiverShmClose(rx, slot);
+					}
+
+					break;
+			}
+		}
+	}
+	while (n == RECEIVER_MAX_EVENTS);
+}
+
+/**
+ * @brief ReceiverDrainAll
+ *
+ * @param rx
+ * @param buff
+ */
+static void ReceiverDrainAll(PmLogReceiver_t *rx, char *buff)
+{
+	int i;
+
+	for (i = 0; i < g_atomic_int_get(&rx->numSockets); i++)
+	{
+		if (!ReceiverDrain(rx, i, buff))
+		{
+			break;
+		}
+	}
+
+	ReceiverShmDrainAll(rx);
+}
+
+/**
+ * @brief ReceiverSocketSlot
+ *
+ * @param rx
+ * @param fd a socket read
+ *
+ * @return its slot
+ */
+static int ReceiverSocketSlot(PmLogReceiver_t *rx, int fd)
+{
+	int i;
+
+	for (i = 0; i < g_atomic_int_get(&rx->numSockets) - 1; i++)
+	{
+		if (rx->sockets[ i ] == fd)
+		{
+			break;
+		}
+	}
+
+	return i;
+}
+
+/**
+ * @brief ReceiverEpollLoop
+ *
+ * @param rx
+ */
+static void ReceiverEpollLoop(PmLogReceiver_t *rx)
+{
+	struct epoll_event  events[ RECEIVER_MAX_EVENTS ];
+	char               *buff = g_malloc(rx->maxLen);
+	uint64_t            count;
+	int                 n;
+	int                 i;
+
+	while (!g_atomic_int_get(&rx->quit))
+	{
+		n = epoll_wait(rx->epollFd, events, RECEIVER_MAX_EVENTS, -1);
+		g_atomic_int_inc(&rx->numSyscalls);
+
+		if (n < 0)
+		{
+			if (errno != EINTR)
+			{
+				ErrPrint("%s: epoll_wait error: %s\n", __FUNCTION__, strerror(errno));
+				break;
+			}
+
+			continue;
+		}
+
+		for (i = 0; i < n; i++)
+		{
+			if (events[ i ].data.fd == rx->timerFd)
+			{
+				(void) read(rx->timerFd, &count, sizeof(count));
+				g_atomic_int_inc(&rx->numSyscalls);
+				rx->timerArmed = false;
+				ReceiverHandoff(rx);
+			}
+			else if (events[ i ].data.fd == rx->wakeFd)
+			{
+				(void) read(rx->wakeFd, &count, sizeof(count));
+				g_atomic_int_inc(&rx->numSyscalls);
+
+				/* resuming: edge-triggered sockets won't signal what they hold */
+				ReceiverDrainAll(rx, buff);
+			}
+			else if (events[ i ].data.fd == rx->shmEpollFd)
+			{
+				ReceiverShmEvents(rx);
+			}
+			else if (!g_atomic_int_get(&rx->stalled))
+			{
+				(void) ReceiverDrain(rx, ReceiverSocketSlot(rx, events[ i ].data.fd), buff);
+			}
+		}
+
+		ReceiverTune(rx);
+	}
+
+	g_free(buff);
+}
+
+#ifdef HAVE_IO_URING
+/**
+ * @brief ReceiverUringInit
+ *
+ * Set up the ring and the provided buffers.
+ *
+ * @param rx
+ *
+ * @return false if io_uring can't be used, e.g. on older kernels
+ */
+static bool ReceiverUringInit(PmLogReceiver_t *rx)
+{
+	int ret;
+	int i;
+
+	ret = io_uring_queue_init(RECEIVER_URING_ENTRIES, &rx->ring, 0);
+
+	if (ret < 0)
+	{
+		ErrPrint("%s: io_uring_queue_init error: %s\n", __FUNCTION__,
+		         strerror(-ret));
+		return false;
+	}
+
+	rx->bufRing = io_uring_setup_buf_ring(&rx->ring, RECEIVER_URING_BUFFERS,
+	                                      RECEIVER_URING_GROUP, 0, &ret);
+
+	if (!rx->bufRing)
+	{
+		ErrPrint("%s: io_uring_setup_buf_ring error: %s\n", __FUNCTION__,
+		         strerror(-ret));
+		io_uring_queue_exit(&rx->ring);
+		return false;
+	}
+
+	rx->bufLen = sizeof(struct io_uring_recvmsg_out) + RECEIVER_CONTROL_LEN +
+	             (gsize) rx->maxLen;
+	rx->bufs = g_malloc(RECEIVER_URING_BUFFERS * rx->bufLen);
+
+	for (i = 0; i < RECEIVER_URING_BUFFERS; i++)
+	{
+		io_uring_buf_ring_add(rx->bufRing, rx->bufs + (gsize) i * rx->bufLen,
+		                      (unsigned int) rx->bufLen, i,
+		                      io_uring_buf_ring_mask(RECEIVER_URING_BUFFERS), i);
+	}
+
+	memset(&rx->msg, 0, sizeof(rx->msg));
+	rx->msg.msg_controllen = RECEIVER_CONTROL_LEN;
+
+	io_uring_buf_ring_advance(rx->bufRing, RECEIVER_URING_BUFFERS);
+
+	rx->uring = true;
+
+	return true;
+}
+
+/**
+ * @brief ReceiverUringExit
+ *
+ * @param rx
+ */
+static void ReceiverUringExit(PmLogReceiver_t *rx)
+{
+	if (!rx->uring)
+	{
+		return;
+	}
+
+	io_uring_free_buf_ring(&rx->ring, rx->bufRing, RECEIVER_URING_BUFFERS,
+	                       RECEIVER_URING_GROUP);
+	io_uring_queue_exit(&rx->ring);
+	g_free(rx->bufs);
+	rx->uring = false;
+}
+
+/**
+ * @brief ReceiverUringPrep
+ *
+ * @param rx
+ * @param tag user data of the request
+ *
+ * @return a submission entry, NULL if the ring is full
+ */
+static struct io_uring_sqe *ReceiverUringPrep(PmLogReceiver_t *rx, uint64_t tag)
+{
+	struct io_uring_sqe *sqe = io_uring_get_sqe(&rx->ring);
+
+	if (!sqe)
+	{
+		ErrPrint("%s: submission queue full\n", __FUNCTION__);
+		return NULL;
+	}
+
+	io_uring_sqe_set_data64(sqe, tag);
+
+	return sqe;
+}
+
+/**
+ * @brief ReceiverUringRecv
+ *
+ * Queue the datagram held in a provided buffer.
+ *
+ * @param rx
+ * @param slot of the socket
+ * @param buf
+ * @param res result of the receive
+ */
+static void ReceiverUringRecv(PmLogReceiver_t *rx, int slot, char *buf, int res)
+{
+	struct io_uring_recvmsg_out    *out;
+	struct cmsghdr                 *cmsg;
+	struct timeval                  time = { -1, 0 };
+	unsigned int                    bytes;
+	int                             attachFd = -1;
+
+	out = io_uring_recvmsg_validate(buf, res, &rx->msg);
+
+	if (!out)
+	{
+		return;
+	}
+
+	for (cmsg = io_uring_recvmsg_cmsg_firsthdr(out, &rx->msg); cmsg;
+	        cmsg = io_uring_recvmsg_cmsg_nexthdr(out, &rx->msg, cmsg))
+	{
+		ReceiverControl(rx, slot, cmsg, &attachFd, &time);
+	}
+
+	bytes = io_uring_recvmsg_payload_length(out, res, &rx->msg);
+	rx->loads[ slot ].burst += bytes;
+
+	if (bytes == 0)
+	{
+		if (attachFd >= 0)
+		{
+			close(attachFd);
+		}
+
+		return;
+	}
+
+	ReceiverQueue(rx, io_uring_recvmsg_payload(out, &rx->msg), bytes,
+	              (time.tv_sec >= 0) ? &time : NULL, attachFd);
+}
+
+/**
+ * @brief ReceiverUringLoop
+ *
+ * @param rx
+ */
+static void ReceiverUringLoop(PmLogReceiver_t *rx)
+{
+	struct io_uring_sqe    *sqe;
+	struct io_uring_cqe    *cqe;
+	unsigned                head;
+	unsigned                seen;
+	unsigned                bid;
+	int                     recycled;
+	uint64_t                tag;
+	uint64_t                count;
+	int                     ret;
+	int                     i;
+
+	if ((sqe = ReceiverUringPrep(rx, RECEIVER_TAG_TIMER)) != NULL)
+	{
+		io_uring_prep_poll_multishot(sqe, rx->timerFd, POLLIN);
+	}
+
+	if ((sqe = ReceiverUringPrep(rx, RECEIVER_TAG_WAKE)) != NULL)
+	{
+		io_uring_prep_poll_multishot(sqe, rx->wakeFd, POLLIN);
+	}
+
+	if ((sqe = ReceiverUringPrep(rx, RECEIVER_TAG_SHM)) != NULL)
+	{
+		io_uring_prep_poll_multishot(sqe, rx->shmEpollFd, POLLIN);
+	}
+
+	while (!g_atomic_int_get(&rx->quit))
+	{
+		/* (re)arm the receives, ended by a stall, a lack of buffers or
+		 * a new socket */
+		for (i = 0; !g_atomic_int_get(&rx->stalled) &&
+		        (i < g_atomic_int_get(&rx->numSockets)); i++)
+		{
+			if (!rx->armed[ i ] && ((sqe = ReceiverUringPrep(rx, i)) != NULL))
+			{
+				io_uring_prep_recvmsg_multishot(sqe, rx->sockets[ i ], &rx->msg,
+				                                MSG_CMSG_CLOEXEC);
+				sqe->flags |= IOSQE_BUFFER_SELECT;
+				sqe->buf_group = RECEIVER_URING_GROUP;
+				rx->armed[ i ] = true;
+			}
+		}
+
+		ret = io_uring_submit_and_wait(&rx->ring, 1);
+		g_atomic_int_inc(&rx->numSyscalls);
+
+		if ((ret < 0) && (ret != -EINTR))
+		{
+			ErrPrint("%s: io_uring_submit_and_wait error: %s\n", __FUNCTION__,
+			         strerror(-ret));
+			break;
+		}
+
+		seen = 0;
+		recycled = 0;
+
+		io_uring_for_each_cqe(&rx->ring, head, cqe)
+		{
+			seen++;
+			tag = io_uring_cqe_get_data64(cqe);
+
+			if ((tag == RECEIVER_TAG_TIMER) || (tag == RECEIVER_TAG_WAKE))
+			{
+				(void) read((tag == RECEIVER_TAG_TIMER) ? rx->timerFd : rx->wakeFd,
+				            &count, sizeof(count));
+				g_atomic_int_inc(&rx->numSyscalls);
+
+				if (tag == RECEIVER_TAG_TIMER)
+				{
+					rx->timerArmed = false;
+					ReceiverHandoff(rx);
+				}
+				else
+				{
+					/* resuming: the rings aren't polled */
+					ReceiverShmDrainAll(rx);
+				}
+
+				if (!(cqe->flags & IORING_CQE_F_MORE) &&
+				        ((sqe = ReceiverUringPrep(rx, tag)) != NULL))
+				{
+					io_uring_prep_poll_multishot(sqe, (tag == RECEIVER_TAG_TIMER) ?
+					                             rx->timerFd : rx->wakeFd, POLLIN);
+				}
+			}
+			else if (tag == RECEIVER_TAG_SHM)
+			{
+				ReceiverShmEvents(rx);
+
+				if (!(cqe->flags & IORING_CQE_F_MORE) &&
+				        ((sqe = ReceiverUringPrep(rx, tag)) != NULL))
+				{
+					io_uring_prep_poll_multishot(sqe, rx->shmEpollFd, POLLIN);
+				}
+			}
+			else if (tag < RECEIVER_MAX_SOCKETS)
+			{
+				if (cqe->flags & IORING_CQE_F_BUFFER)
+				{
+					bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+
+					if (cqe->res > 0)
+					{
+						ReceiverUringRecv(rx, (int) tag, rx->bufs + (gsize) bid * rx->bufLen,
+						                  cqe->res);
+					}
+
+					io_uring_buf_ring_add(rx->bufRing,
+					                      rx->bufs + (gsize) bid * rx->bufLen,
+					                      (unsigned int) rx->bufLen, bid,
+					                      io_uring_buf_ring_mask(RECEIVER_URING_BUFFERS),
+					                      recycled++);
+				}
+				else if ((cqe->res < 0) && (cqe->res != -ENOBUFS) &&
+				         (cqe->res != -ECANCELED))
+				{
+					ErrPrint("%s: recv error: %s\n", __FUNCTION__, strerror(-cqe->res));
+				}
+
+				if (!(cqe->flags & IORING_CQE_F_MORE))
+				{
+					rx->armed[ tag ] = false;
+				}
+			}
+		}
+
+		io_uring_cq_advance(&rx->ring, seen);
+
+		if (recycled)
+		{
+			io_uring_buf_ring_advance(rx->bufRing, recycled);
+		}
+
+		/* no telling when a socket is empty: a burst is what a wakeup reaps */
+		for (i = 0; i < g_atomic_int_get(&rx->numSockets); i++)
+		{
+			ReceiverBurstEnd(rx, i);
+		}
+
+		ReceiverTune(rx);
+
+		/* leave the datagrams to the kernel buffers until resumed */
+		if (!g_atomic_int_get(&rx->stalled) && ReceiverStall(rx))
+		{
+			for (i = 0; i < g_atomic_int_get(&rx->numSockets); i++)
+			{
+				if (rx->armed[ i ] &&
+				        ((sqe = ReceiverUringPrep(rx, RECEIVER_TAG_CANCEL)) != NULL))
+				{
+					io_uring_prep_cancel64(sqe, i, 0);
+				}
+			}
+		}
+	}
+}
+#endif
+
+/**
+ * @brief ReceiverThreadFunc
+ *
+ * @param user_data the PmLogReceiver_t
+ *
+ * @return NULL
+ */
+static gpointer ReceiverThreadFunc(gpointer user_data)
+{
+	PmLogReceiver_t *rx = user_data;
+
+#ifdef HAVE_IO_URING
+	if (rx->uring)
+	{
+		ReceiverUringLoop(rx);
+	}
+	else
+#endif
+	{
+		ReceiverEpollLoop(rx);
+	}
+
+	/* quit is set: the rings are emptied whatever the backlog */
+	ReceiverShmDrainAll(rx);
+	ReceiverHandoff(rx);
+
+	return NULL;
+}
+
+/**
+ * @brief ReceiverWatch
+ *
+ * @param rx
+ * @param fd
+ * @param flags epoll event flags
+ *
+ * @return true on success
+ */
+static bool ReceiverWatch(PmLogReceiver_t *rx, int fd, uint32_t flags)
+{
+	struct epoll_event event;
+
+	memset(&event, 0, sizeof(event));
+	event.events = flags;
+	event.data.fd = fd;
+
+	if (epoll_ctl(rx->epollFd, EPOLL_CTL_ADD, fd, &event) != 0)
+	{
+		ErrPrint("%s: epoll_ctl error: %s\n", __FUNCTION__, strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief ReceiverFree
+ *
+ * Free a stopped receiver, dropping the batches not taken.  The sockets
+ * are not closed, the connections of the shared memory clients are.
+ *
+ * @param rx
+ */
+void ReceiverFree(PmLogReceiver_t *rx)
+{
+	GPtrArray  *batch;
+	guint       slot;
+
+#ifdef HAVE_IO_URING
+	ReceiverUringExit(rx);
+#endif
+
+	for (slot = 0; slot < RECEIVER_MAX_RINGS; slot++)
+	{
+		if (rx->clients[ slot ].ring)
+		{
+			close(rx->clients[ slot ].connFd);
+			ShmRingFree(rx->clients[ slot ].ring);
+		}
+	}
+
+	if (rx->shmEpollFd >= 0)
+	{
+		close(rx->shmEpollFd);
+	}
+
+	if (rx->sweepFd >= 0)
+	{
+		close(rx->sweepFd);
+	}
+
+	if (rx->epollFd >= 0)
+	{
+		close(rx->epollFd);
+	}
+
+	if (rx->timerFd >= 0)
+	{
+		close(rx->timerFd);
+	}
+
+	if (rx->wakeFd >= 0)
+	{
+		close(rx->wakeFd);
+	}
+
+	if (rx->handoffFd >= 0)
+	{
+		close(rx->handoffFd);
+	}
+
+	if (rx->batches)
+	{
+		while ((batch = g_async_queue_try_pop(rx->batches)) != NULL)
+		{
+			g_ptr_array_unref(batch);
+		}
+
+		g_async_queue_unref(rx->batches);
+	}
+
+	if (rx->batch)
+	{
+		g_ptr_array_unref(rx->batch);
+	}
+
+	g_free(rx);
+}
+
+/**
+ * @brief ReceiverStart
+ *
+ * Start the receiver thread, with no socket yet.
+ *
+ * @param maxLen longest datagram, longer ones are truncated
+ *
+ * @return the receiver, NULL on failure
+ */
+PmLogReceiver_t *ReceiverStart(int maxLen)
+{
+	PmLogReceiver_t *rx = g_new0(PmLogReceiver_t, 1);
+	GError          *gerr = NULL;
+
+	rx->maxLen = maxLen;
+	rx->epollFd = epoll_create1(EPOLL_CLOEXEC);
+	rx->timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	rx->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	rx->handoffFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	rx->shmEpollFd = epoll_create1(EPOLL_CLOEXEC);
+	rx->shmListenFd = -1;
+	rx->sweepFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	rx->batch = g_ptr_array_new_with_free_func(ReceiverDatagramFree);
+	rx->batches = g_async_queue_new();
+
+	if ((rx->epollFd < 0) || (rx->timerFd < 0) || (rx->wakeFd < 0) ||
+	        (rx->handoffFd < 0) || (rx->shmEpollFd < 0) || (rx->sweepFd < 0))
+	{
+		ErrPrint("%s: failed to create descriptors: %s\n", __FUNCTION__,
+		         strerror(errno));
+		ReceiverFree(rx);
+		return NULL;
+	}
+
+	if (!ReceiverWatch(rx, rx->timerFd, EPOLLIN) ||
+	        !ReceiverWatch(rx, rx->wakeFd, EPOLLIN) ||
+	        !ReceiverWatch(rx, rx->shmEpollFd, EPOLLIN) ||
+	        !ReceiverShmWatch(rx, rx->sweepFd, EPOLLIN, RECEIVER_SHM_SWEEP))
+	{
+		ReceiverFree(rx);
+		return NULL;
+	}
+
+#ifdef HAVE_IO_URING
+	/* else fall back to epoll */
+	(void) ReceiverUringInit(rx);
+#endif
+
+	rx->thrd = g_thread_try_new("Receiver", ReceiverThreadFunc, rx, &gerr);
+
+	if (!rx->thrd)
+	{
+		ErrPrint("%s: failed to create thread: %s\n", __FUNCTION__,
+		         gerr->message);
+		g_error_free(gerr);
+		ReceiverFree(rx);
+		return NULL;
+	}
+
+	return rx;
+}
+
+/**
+ * @brief ReceiverAddSocket
+ *
+ * Read a datagram socket on the receiver thread.  Main thread only.
+ *
+ * @param rx
+ * @param fd made non-blocking
+ *
+ * @return true on success
+ */
+bool ReceiverAddSocket(PmLogReceiver_t *rx, int fd)
+{
+	ReceiverSocketLoad *load = &rx->loads[ rx->numSockets ];
+	socklen_t           len = sizeof(load->rcvBuf);
+	uint64_t            one = 1;
+	int                 on = 1;
+	int                 flags = fcntl(fd, F_GETFL);
+
+	if (rx->numSockets >= RECEIVER_MAX_SOCKETS)
+	{
+		ErrPrint("%s: too many sockets\n", __FUNCTION__);
+		return false;
+	}
+
+	if ((flags < 0) || (fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0))
+	{
+		ErrPrint("%s: fcntl error: %s\n", __FUNCTION__, strerror(errno));
+		return false;
+	}
+
+	/* not all socket families count their drops */
+	(void) setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on));
+
+	/* else datagrams are stamped when read */
+	(void) setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+
+	memset(load, 0, sizeof(*load));
+
+	if (getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &load->rcvBuf, &len) != 0)
+	{
+		load->rcvBuf = 0;
+	}
+
+	if ((rx->rcvBufMax > 0) &&
+	        ((load->rcvBuf < rx->rcvBufMin) || (load->rcvBuf > rx->rcvBufMax)))
+	{
+		load->rcvBuf = MAX(ReceiverSetRcvBuf(fd, CLAMP(load->rcvBuf, rx->rcvBufMin,
+		                                     rx->rcvBufMax)), 0);
+	}
+
+	g_atomic_int_add(&rx->rcvBufTotal, load->rcvBuf);
+
+	/* the io_uring engine arms its receives when woken up below */
+	if (!ReceiverWatch(rx, fd, EPOLLIN | EPOLLET))
+	{
+		return false;
+	}
+
+	/* published after the slot is written */
+	rx->sockets[ rx->numSockets ] = fd;
+	g_atomic_int_inc(&rx->numSockets);
+
+	/* pick up what arrived before the socket was watched */
+	if (write(rx->wakeFd, &one, sizeof(one)) != sizeof(one))
+	{
+		ErrPrint("%s: eventfd write error: %s\n", __FUNCTION__, strerror(errno));
+	}
+
+	return true;
+}
+
+/**
+ * @brief ReceiverAddShmListener
+ *
+ * Hand rings over to the clients connecting to a SOCK_SEQPACKET socket.
+ * Main thread only, once.
+ *
+ * @param rx
+ * @param fd listening socket, made non-blocking
+ *
+ * @return true on success
+ */
+bool ReceiverAddShmListener(PmLogReceiver_t *rx, int fd)
+{
+	int flags = fcntl(fd, F_GETFL);
+
+	if ((flags < 0) || (fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0))
+	{
+		ErrPrint("%s: fcntl error: %s\n", __FUNCTION__, strerror(errno));
+		return false;
+	}
+
+	/* set before the receiver thread may see it */
+	rx->shmListenFd = fd;
+
+	return ReceiverShmWatch(rx, fd, EPOLLIN, RECEIVER_SHM_LISTEN);
+}
+
+/**
+ * @brief ReceiverHandoffFd
+ *
+ * @param rx
+ *
+ * @return descriptor readable when batches are waiting, to watch from
+ * the main loop
+ */
+int ReceiverHandoffFd(const PmLogReceiver_t *rx)
+{
+	return rx->handoffFd;
+}
+
+/**
+ * @brief ReceiverTakeBatch
+ *
+ * Main thread: take the next batch of datagrams, in the order received.
+ *
+ * @param rx
+ *
+ * @return array of PmLogDatagram_t to unref, NULL once there are none
+ */
+GPtrArray *ReceiverTakeBatch(PmLogReceiver_t *rx)
+{
+	GPtrArray *batch;
+	uint64_t   count;
+	uint64_t   one = 1;
+
+	(void) read(rx->handoffFd, &count, sizeof(count));
+
+	batch = g_async_queue_try_pop(rx->batches);
+
+	if (!batch)
+	{
+		return NULL;
+	}
+
+	g_atomic_int_add(&rx->queued, -(gint) batch->len);
+
+	if (g_atomic_int_compare_and_exchange(&rx->stalled, 1, 0))
+	{
+		if (write(rx->wakeFd, &one, sizeof(one)) != sizeof(one))
+		{
+			ErrPrint("%s: eventfd write error: %s\n", __FUNCTION__, strerror(errno));
+		}
+	}
+
+	return batch;
+}
+
+/**
+ * @brief ReceiverGetStats
+ *
+ * @param rx
+ * @param stats
+ */
+void ReceiverGetStats(PmLogReceiver_t *rx, PmLogReceiverStats_t *stats)
+{
+#ifdef HAVE_IO_URING
+	stats->engine = rx->uring ? "io_uring" : "epoll";
+#else
+	stats->engine = "epoll";
+#endif
+	stats->datagrams = (guint) g_atomic_int_get(&rx->numDatagrams);
+	stats->batches = (guint) g_atomic_int_get(&rx->numBatches);
+	stats->syscalls = (guint) g_atomic_int_get(&rx->numSyscalls);
+	stats->rings = (guint) g_atomic_int_get(&rx->numRings);
+	stats->shmRecords = (guint) g_atomic_int_get(&rx->numShmRecords);
+	stats->shmBacklog = (guint) g_atomic_int_get(&rx->shmBacklog);
+	stats->kernelDrops = (guint) g_atomic_int_get(&rx->numKernelDrops);
+	stats->receiveBuffer = g_atomic_int_get(&rx->rcvBufTotal);
+}
+
+/**
+ * @brief ReceiverSetBufferBounds
+ *
+ * Let the receive buffers of the sockets added next grow and shrink
+ * within bounds.  Main thread only, before adding sockets.
+ *
+ * @param rx
+ * @param min bytes, as SO_RCVBUF reports them
+ * @param max bytes, 0 to leave the buffers alone
+ */
+void ReceiverSetBufferBounds(PmLogReceiver_t *rx, int min, int max)
+{
+	rx->rcvBufMin = MIN(min, max);
+	rx->rcvBufMax = max;
+}
+
+/**
+ * @brief ReceiverStop
+ *
+ * Stop the receiver thread, handing over the batch it was filling and
+ * what is left in the rings of the shared memory clients.
+ * What was handed over can still be taken before ReceiverFree.
+ *
+ * @param rx
+ */
+void ReceiverStop(PmLogReceiver_t *rx)
+{
+	uint64_t one = 1;
+
+	g_atomic_int_set(&rx->quit, 1);
+
+	if (write(rx->wakeFd, &one, sizeof(one)) != sizeof(one))
+	{
+		ErrPrint("%s: eventfd write error: %s\n", __FUNCTION__, strerror(errno));
+	}
+
+	g_thread_join(rx->thrd);
+	rx->thrd = NULL;
+}
@@ -0,0 +1,91 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2007-2014 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+/**
+ ***********************************************************************
+ * @file receiver.h
+ *
+ * @brief This file contains definition of the receiver thread, reading
+ * the log sockets outside of the GLib main loop.
+ *
+ ***********************************************************************
+ */
+
+
+#ifndef PMLOGDAEMON_RECEIVER_H
+#define PMLOGDAEMON_RECEIVER_H
+
+#include <stdbool.h>
+#include <sys/time.h>
+#include <glib.h>
+#include "print.h"
+
+/* a datagram as received */
+typedef struct
+{
+	/* when it arrived, or when it was written to a ring */
+	struct timeval  time;
+	int             len;
+
+	/* descriptor passed along with SCM_RIGHTS, -1 if none; closed when
+	 * the datagram is freed unless reset by whoever takes it */
+	int             attachFd;
+
+	/* null-terminated */
+	char            buff[];
+} PmLogDatagram_t;
+
+typedef struct _PmLogReceiver PmLogReceiver_t;
+
+/* counters to compare the receive engines */
+typedef struct
+{
+	/* "epoll" or "io_uring" */
+	const char     *engine;
+
+	guint           datagrams;
+	guint           batches;
+
+	/* system calls made to receive and hand over */
+	guint           syscalls;
+
+	/* clients logging through shared memory, and records read from
+	 * their rings, also counted in datagrams */
+	guint           rings;
+	guint           shmRecords;
+
+	/* bytes left in the rings at the last sweep */
+	guint           shmBacklog;
+
+	/* datagrams the kernel reported dropping, and the bytes of the
+	 * receive buffers of the sockets */
+	guint           kernelDrops;
+	int             receiveBuffer;
+} PmLogReceiverStats_t;
+
+PmLogReceiver_t *ReceiverStart(int maxLen);
+bool ReceiverAddSocket(PmLogReceiver_t *rx, int fd);
+bool ReceiverAddShmListener(PmLogReceiver_t *rx, int fd);
+int ReceiverHandoffFd(const PmLogReceiver_t *rx);
+GPtrArray *ReceiverTakeBatch(PmLogReceiver_t *rx);
+void ReceiverGetStats(PmLogReceiver_t *rx, PmLogReceiverStats_t *stats);
+void ReceiverSetBufferBounds(PmLogReceiver_t *rx, int min, int max);
+void ReceiverStop(PmLogReceiver_t *rx);
+void ReceiverFree(PmLogReceiver_t *rx);
+
+#endif
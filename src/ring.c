@@ -27,15 +27,91 @@
 
 #include "ring.h"
 
+#include <zlib.h>
+
+struct _PmLogRBSnapshot
+{
+	bool compress;
+
+	/* copies of the chunks, linked like those of the RB */
+	PmLogRBChunk_t *head;
+	PmLogRBChunk_t *staging;
+};
+
+/* all ring buffers, so a chunk can be taken back from another one */
+static GList *g_rbRings = NULL;
+
+/* incremented on each write, to find the least recently written RB */
+static guint64 g_rbWriteSeq = 0;
+
+/**
+ * @brief RBNumChunks
+ *
+ * @param rb pointer to the RB object
+ *
+ * @return the number of pool chunks the RB holds
+ */
+static int RBNumChunks(const PmLogRingBuffer_t *rb)
+{
+	return rb->numChunks + (rb->staging ? 1 : 0);
+}
+
+/**
+ * @brief RBMaxChunks
+ *
+ * @param rb pointer to the RB object
+ *
+ * @return the maximum share of the pool for the RB, in chunks
+ */
+static int RBMaxChunks(const PmLogRingBuffer_t *rb)
+{
+	int n = rb->bufferSize / RBPoolChunkSize();
+
+	/* compressed RBs need the staging chunk plus one for blocks */
+	return MAX(n, rb->compress ? 2 : 1);
+}
+
+/**
+ * @brief RBMinChunks
+ *
+ * @param rb pointer to the RB object
+ *
+ * @return the minimum share of the pool for the RB, in chunks
+ */
+static int RBMinChunks(const PmLogRingBuffer_t *rb)
+{
+	int chunkSize = RBPoolChunkSize();
+
+	return MIN((rb->minSize + chunkSize - 1) / chunkSize, RBMaxChunks(rb));
+}
+
+static void RBUpdateEmpty(PmLogRingBuffer_t *rb)
+{
+	rb->isEmpty = (rb->rawBytes == 0);
+}
+
+/**
+ * @brief RBClear
+ *
+ * Empty the RB.  The chunk list is handed back to the pool as a whole,
+ * so this takes constant time whatever the buffer size.
+ *
+ * @param rb pointer to the RB object
+ */
 static void RBClear(PmLogRingBuffer_t *rb)
 {
 	if (rb)
 	{
+		RBPoolFreeList(rb->head, rb->tail, rb->numChunks);
+		rb->head = NULL;
+		rb->tail = NULL;
+		rb->numChunks = 0;
+
+		RBPoolFree(rb->staging);
+		rb->staging = NULL;
+
+		rb->rawBytes = 0;
 		rb->isEmpty = true;
-		rb->nextWritePos = rb->buff;
-		g_assert(rb->buff);
-		g_assert(rb->bufferSize >= RBMinBufferSize);
-		memset(rb->buff, 0, rb->bufferSize);
 	}
 }
 
@@ -45,14 +121,18 @@ static void RBClear(PmLogRingBuffer_t *rb)
  *
  * Constructor for a new Ring Buffer object
  *
- * @param bufferSize
+ * @param bufferSize maximum share of the chunk pool
+ * @param minSize minimum share of the chunk pool
  * @param flushLevel
+ * @param compress true to keep full blocks deflated in memory
  *
  * @return
  */
-PmLogRingBuffer_t *RBNew(int bufferSize, int flushLevel)
+PmLogRingBuffer_t *RBNew(int bufferSize, int minSize, int flushLevel,
+                         bool compress)
 {
-	DbgPrint("%s: called with bs %d fl %d\n", __FUNCTION__, bufferSize, flushLevel);
+	DbgPrint("%s: called with bs %d ms %d fl %d c %d\n", __FUNCTION__,
+	         bufferSize, minSize, flushLevel, compress);
 	PmLogRingBuffer_t *ret = NULL;
 
 	if ((bufferSize <= 0) && (flushLevel <= 0))
@@ -76,22 +156,33 @@ PmLogRingBuffer_t *RBNew(int bufferSize, int flushLevel)
 				ret->bufferSize = bufferSize;
 			}
 
+			ret->minSize = MIN(MAX(minSize, 0), ret->bufferSize);
 			ret->flushLevel = flushLevel;
-			ret->buff = NULL;
 			ret->isEmpty = true;
+			ret->compress = compress;
+
+			g_rbRings = g_list_prepend(g_rbRings, ret);
 		}
 	}
 
 	return ret;
 }
 
-static inline bool RBValidPos(PmLogRingBuffer_t *rb, const char *p)
+/**
+ * @brief RBFree
+ *
+ * Destructor for a Ring Buffer object; its chunks go back to the pool.
+ *
+ * @param rb pointer to the RB object
+ */
+void RBFree(PmLogRingBuffer_t *rb)
 {
-	g_assert(rb);
-	g_assert(rb->bufferSize > 0);
-	g_assert(rb->isEmpty || rb->buff);
-	const char *rbEnd = rb->buff + rb->bufferSize;
-	return ((p < rbEnd) && (p >= rb->buff));
+	if (rb)
+	{
+		RBClear(rb);
+		g_rbRings = g_list_remove(g_rbRings, rb);
+		g_free(rb);
+	}
 }
 
 /**
@@ -118,94 +209,508 @@ static bool RBValid(PmLogRingBuffer_t *rb)
 		return false;
 	}
 
-	if (!rb->isEmpty && !(rb->buff))
+	if (RBNumChunks(rb) > RBMaxChunks(rb))
 	{
-		DbgPrint("%s: buff is missing.\n", __FUNCTION__);
+		DbgPrint("%s: holds more than its share of chunks\n", __FUNCTION__);
 		return false;
 	}
 
-	if (!RBValidPos(rb, rb->nextWritePos))
+	return true;
+}
+
+/**
+ * @brief RBEvictOldest
+ *
+ * Take the oldest chunk out of the RB, dropping the records in it.
+ *
+ * @param rb pointer to the RB object
+ *
+ * @return the chunk, or NULL if the RB has none
+ */
+static PmLogRBChunk_t *RBEvictOldest(PmLogRingBuffer_t *rb)
+{
+	PmLogRBChunk_t *chunk = rb->head;
+
+	if (chunk)
 	{
-		DbgPrint("%s: end nextWritePos out of range/n", __FUNCTION__);
-		return false;
+		rb->head = chunk->next;
+		rb->numChunks--;
+
+		if (rb->head == NULL)
+		{
+			rb->tail = NULL;
+		}
+
+		chunk->next = NULL;
+		rb->rawBytes -= chunk->rawBytes;
+		RBUpdateEmpty(rb);
+		chunk->used = 0;
+		chunk->rawBytes = 0;
 	}
 
-	return true;
+	return chunk;
+}
+
+/**
+ * @brief RBResize
+ *
+ * Change the maximum share of the chunk pool of the RB.  When shrinking,
+ * the oldest chunks beyond the new share go back to the pool.
+ *
+ * @param rb pointer to the RB object
+ * @param bufferSize new maximum share of the chunk pool
+ */
+void RBResize(PmLogRingBuffer_t *rb, int bufferSize)
+{
+	if (rb)
+	{
+		rb->bufferSize = MAX(bufferSize, RBMinBufferSize);
+		rb->minSize = MIN(rb->minSize, rb->bufferSize);
+
+		while ((RBNumChunks(rb) > RBMaxChunks(rb)) && (rb->head != NULL))
+		{
+			RBPoolFree(RBEvictOldest(rb));
+		}
+	}
 }
 
-static char *RBStep(const PmLogRingBuffer_t *rb, char *p)
+/**
+ * @brief RBFindVictim
+ *
+ * Find the least recently written RB, other than the given one, that
+ * holds more than its minimum share of chunks.
+ *
+ * @param rb pointer to the RB object that needs a chunk
+ *
+ * @return the RB to take a chunk from, or NULL if none
+ */
+static PmLogRingBuffer_t *RBFindVictim(const PmLogRingBuffer_t *rb)
 {
-	p++;
+	PmLogRingBuffer_t *victim = NULL;
+	PmLogRingBuffer_t *other;
+	GList             *l;
 
-	if (p >= (rb->buff + rb->bufferSize))
+	for (l = g_rbRings; l != NULL; l = l->next)
 	{
-		p = rb->buff;
+		other = l->data;
+
+		if ((other == rb) || (other->head == NULL) ||
+		        (RBNumChunks(other) <= RBMinChunks(other)))
+		{
+			continue;
+		}
+
+		if ((victim == NULL) || (other->lastWrite < victim->lastWrite))
+		{
+			victim = other;
+		}
 	}
 
-	return p;
+	return victim;
 }
 
 /**
- * @brief RBAllocBuff
+ * @brief RBNewChunk
  *
- * Allocate memory for buff in rb
+ * Get an empty chunk for the RB.  If the RB already holds its maximum
+ * share, or the pool budget is exhausted and no other RB can give a
+ * chunk back, the oldest chunk of the RB is reused.
  *
  * @param rb pointer to the RB object
  *
+ * @return the chunk (not yet linked into the RB), or NULL if none
  */
-void RBAllocBuff(PmLogRingBuffer_t *rb)
+static PmLogRBChunk_t *RBNewChunk(PmLogRingBuffer_t *rb)
 {
-	/* Lazy allocation for buffer, only when actual write happens */
-	if (!rb->buff)
+	PmLogRBChunk_t    *chunk = NULL;
+	PmLogRingBuffer_t *victim;
+
+	if (RBNumChunks(rb) < RBMaxChunks(rb))
 	{
-		rb->buff = (char *) g_malloc(rb->bufferSize);
-		RBClear(rb);
+		chunk = RBPoolAlloc();
+
+		if (chunk == NULL)
+		{
+			victim = RBFindVictim(rb);
+
+			if (victim)
+			{
+				DbgPrint("%s: pool exhausted, taking a chunk back\n", __FUNCTION__);
+				chunk = RBEvictOldest(victim);
+			}
+		}
+	}
+
+	if (chunk == NULL)
+	{
+		chunk = RBEvictOldest(rb);
 	}
+
+	return chunk;
 }
 
 /**
- * @brief RBWrite
+ * @brief RBReserve
+ *
+ * Find room for numBytes at the end of the RB, starting a new chunk if
+ * the newest one is full.
+ *
+ * @param rb pointer to the RB object
+ * @param numBytes
+ *
+ * @return the chunk to append to, or NULL if no room could be made
+ */
+static PmLogRBChunk_t *RBReserve(PmLogRingBuffer_t *rb, int numBytes)
+{
+	PmLogRBChunk_t *chunk = rb->tail;
+
+	if (chunk && (RBPoolChunkCapacity() - chunk->used >= numBytes))
+	{
+		return chunk;
+	}
+
+	chunk = RBNewChunk(rb);
+
+	if (chunk)
+	{
+		if (rb->tail)
+		{
+			rb->tail->next = chunk;
+		}
+		else
+		{
+			rb->head = chunk;
+		}
+
+		rb->tail = chunk;
+		rb->numChunks++;
+	}
+
+	return chunk;
+}
+
+/**
+ * @brief RBSealStaging
  *
- * Add a new entry to the ring buffer
+ * Deflate the staging chunk into a new compressed block at the end of
+ * the RB.  The staging chunk is emptied.
  *
  * @param rb pointer to the RB object
- * @param buffMsg  message to add to the RB
- * @param numBytes length of message
  */
-void RBWrite(PmLogRingBuffer_t *rb, const char *buffMsg, int numBytes)
+static void RBSealStaging(PmLogRingBuffer_t *rb)
 {
-	DbgPrint("%s: called with buffMsg %s\n", __FUNCTION__, buffMsg);
+	PmLogRBChunk_t    *staging = rb->staging;
+	PmLogRBChunk_t    *chunk;
+	PmLogRBBlock_t     block;
+	Bytef             *comp;
+	uLongf             compLen;
+	int                result;
+	const char        *data;
+	int                dataLen;
+
+	if (staging == NULL || staging->used == 0)
+	{
+		return;
+	}
+
+	compLen = compressBound((uLong) staging->used);
+	comp = g_malloc(compLen);
+	result = compress2(comp, &compLen, (const Bytef *) staging->data,
+	                   (uLong) staging->used, Z_DEFAULT_COMPRESSION);
 
-	if (!rb->buff)
+	block.rawLen = staging->used;
+
+	if ((result == Z_OK) && (compLen < (uLongf) staging->used))
+	{
+		block.compLen = (int) compLen;
+		data = (const char *) comp;
+		dataLen = block.compLen;
+	}
+	else
+	{
+		/* did not compress, store the block raw */
+		block.compLen = 0;
+		data = staging->data;
+		dataLen = staging->used;
+	}
+
+	/* the staging chunk keeps its slot while the block is placed */
+	chunk = RBReserve(rb, (int) sizeof(block) + dataLen);
+
+	if (chunk)
 	{
-		RBAllocBuff(rb);
+		memcpy(chunk->data + chunk->used, &block, sizeof(block));
+		memcpy(chunk->data + chunk->used + sizeof(block), data, dataLen);
+		chunk->used += (int) sizeof(block) + dataLen;
+		chunk->rawBytes += staging->rawBytes;
 	}
+	else
+	{
+		DbgPrint("%s: no room for block, dropping it\n", __FUNCTION__);
+		rb->rawBytes -= staging->rawBytes;
+	}
+
+	staging->used = 0;
+	staging->rawBytes = 0;
+	RBUpdateEmpty(rb);
+
+	g_free(comp);
+}
+
+/**
+ * @brief RBPutRecord
+ *
+ * Frame a record into the given chunk, which must have room for it.
+ *
+ * @param chunk
+ * @param time
+ * @param pri
+ * @param programName
+ * @param programLen
+ * @param msg
+ * @param msgLen
+ *
+ * @return the number of bytes written
+ */
+static int RBPutRecord(PmLogRBChunk_t *chunk, gint64 time, int pri,
+                       const char *programName, int programLen,
+                       const char *msg, int msgLen)
+{
+	PmLogRBRecord_t  record;
+	char            *p = chunk->data + chunk->used;
+
+	record.len = (guint16)(programLen + 1 + msgLen + 1);
+	record.programLen = (guint16) programLen;
+	record.pri = pri;
+	record.time = time;
+
+	memcpy(p, &record, sizeof(record));
+	p += sizeof(record);
+	memcpy(p, programName, programLen);
+	p[programLen] = '\0';
+	p += programLen + 1;
+	memcpy(p, msg, msgLen);
+	p[msgLen] = '\0';
+
+	chunk->used += (int) sizeof(record) + record.len;
+	chunk->rawBytes += (int) sizeof(record) + record.len;
+
+	return (int) sizeof(record) + record.len;
+}
+
+/**
+ * @brief RBWrite
+ *
+ * Add a new entry to the ring buffer.  The cost is proportional to the
+ * size of the entry.
+ *
+ * @param rb pointer to the RB object
+ * @param time time the message was logged, microseconds since the epoch
+ * @param pri priority of the message
+ * @param programName program that logged the message
+ * @param msg message to add to the RB
+ * @param msgLen length of message, excluding the terminator
+ */
+void RBWrite(PmLogRingBuffer_t *rb, gint64 time, int pri,
+             const char *programName, const char *msg, int msgLen)
+{
+	DbgPrint("%s: called with msg %s\n", __FUNCTION__, msg);
+
+	PmLogRBChunk_t *chunk;
+	int             capacity;
+	int             programLen;
+	int             numBytes;
 
 	g_assert(RBValid(rb));
-	g_assert(numBytes <= (strlen(buffMsg) + 1));
 
-	char *n = rb->nextWritePos;
-	char *b = rb->buff;
-	const int buffSize = rb->bufferSize;
-	const char *rbEnd = b + (buffSize - 1);
-	const int tailLen = rbEnd - n + 1;
+	rb->lastWrite = ++g_rbWriteSeq;
+
+	/* a block stored raw must still fit in a chunk with its header */
+	capacity = RBPoolChunkCapacity();
+
+	if (rb->compress)
+	{
+		capacity -= (int) sizeof(PmLogRBBlock_t);
+	}
+
+	/* records never span chunks or blocks, truncate oversized ones */
+	programLen = MIN((int) strlen(programName), RB_MAX_PROGRAM_LEN);
+	numBytes = (int) sizeof(PmLogRBRecord_t) + programLen + 1 + msgLen + 1;
+
+	if (numBytes > capacity)
+	{
+		msgLen -= numBytes - capacity;
+		numBytes = capacity;
+	}
 
-	/* write, depending on wether we wrap or not */
-	if (numBytes > tailLen)
+	if (rb->compress)
 	{
-		memcpy(n, buffMsg, tailLen);
-		int remain = numBytes - tailLen;
-		memcpy(b, buffMsg + tailLen, remain);
-		n = b + remain;
+		if (rb->staging && (rb->staging->used + numBytes > capacity))
+		{
+			RBSealStaging(rb);
+		}
+
+		if (rb->staging == NULL)
+		{
+			rb->staging = RBNewChunk(rb);
+		}
+
+		chunk = rb->staging;
 	}
 	else
 	{
-		memcpy(n, buffMsg, numBytes);
-		n = RBStep(rb, n + (numBytes - 1));
+		chunk = RBReserve(rb, numBytes);
+	}
+
+	if (chunk == NULL)
+	{
+		DbgPrint("%s: no chunk available, dropping record\n", __FUNCTION__);
+		return;
 	}
 
+	rb->rawBytes += RBPutRecord(chunk, time, pri, programName, programLen, msg,
+	                            msgLen);
 	rb->isEmpty = false;
-	rb->nextWritePos = n;
+}
+
+/**
+ * @brief RBFlushRecords
+ *
+ * Call flushMsgFunc on each record in a raw block.
+ *
+ * @param p start of the raw block
+ * @param len length of the raw block
+ * @param flushMsgFunc
+ * @param data
+ */
+static void RBFlushRecords(const char *p, int len, RBTraversalFunc flushMsgFunc,
+                           gpointer data)
+{
+	const char      *end = p + len;
+	PmLogRBRecord_t  record;
+
+	while (p + sizeof(record) <= end)
+	{
+		memcpy(&record, p, sizeof(record));
+		p += sizeof(record);
+
+		if (p + record.len > end)
+		{
+			DbgPrint("%s: truncated record\n", __FUNCTION__);
+			break;
+		}
+
+		flushMsgFunc(record.time, record.pri, p, p + record.programLen + 1, data);
+		p += record.len;
+	}
+}
+
+/**
+ * @brief RBFlushBlocks
+ *
+ * Inflate each compressed block in a chunk in order and flush its
+ * records.
+ *
+ * @param chunk chunk holding compressed blocks
+ * @param raw buffer for the inflated block, one chunk in size
+ * @param flushMsgFunc
+ * @param data
+ */
+static void RBFlushBlocks(const PmLogRBChunk_t *chunk, char *raw,
+                          RBTraversalFunc flushMsgFunc, gpointer data)
+{
+	const char     *p = chunk->data;
+	const char     *end = chunk->data + chunk->used;
+	PmLogRBBlock_t  block;
+	uLongf          rawLen;
+	int             result;
+
+	while (p + sizeof(block) <= end)
+	{
+		memcpy(&block, p, sizeof(block));
+		p += sizeof(block);
+
+		if (block.compLen == 0)
+		{
+			RBFlushRecords(p, block.rawLen, flushMsgFunc, data);
+			p += block.rawLen;
+			continue;
+		}
+
+		rawLen = (uLongf) RBPoolChunkCapacity();
+		result = uncompress((Bytef *) raw, &rawLen, (const Bytef *) p,
+		                    (uLong) block.compLen);
+		p += block.compLen;
+
+		if (result != Z_OK || rawLen != (uLongf) block.rawLen)
+		{
+			DbgPrint("%s: uncompress failed: %d\n", __FUNCTION__, result);
+			continue;
+		}
+
+		RBFlushRecords(raw, (int) rawLen, flushMsgFunc, data);
+	}
+}
+
+/**
+ * @brief RBGetUsage
+ *
+ * Report how much log history the RB holds and how much memory it
+ * takes to hold it.  For compressed buffers rawBytes / storedBytes is
+ * the effective history per byte of RAM.
+ *
+ * @param rb pointer to the RB object
+ * @param rawBytesP set to the number of bytes of records held
+ * @param storedBytesP set to the number of bytes used to hold them
+ */
+void RBGetUsage(const PmLogRingBuffer_t *rb, int *rawBytesP, int *storedBytesP)
+{
+	*rawBytesP = rb->rawBytes;
+	*storedBytesP = RBNumChunks(rb) * RBPoolChunkSize();
+}
+
+
+/**
+ * @brief RBTraverse
+ *
+ * Call func on each record of a chunk list, oldest first.
+ *
+ * @param head oldest chunk
+ * @param staging staging chunk, or NULL
+ * @param compress true if the chunks hold compressed blocks
+ * @param func
+ * @param data
+ */
+static void RBTraverse(const PmLogRBChunk_t *head,
+                       const PmLogRBChunk_t *staging, bool compress,
+                       RBTraversalFunc func, gpointer data)
+{
+	const PmLogRBChunk_t *chunk;
+	char                 *raw = NULL;
+
+	if (compress && head)
+	{
+		raw = g_malloc(RBPoolChunkCapacity());
+	}
+
+	for (chunk = head; chunk != NULL; chunk = chunk->next)
+	{
+		if (compress)
+		{
+			RBFlushBlocks(chunk, raw, func, data);
+		}
+		else
+		{
+			RBFlushRecords(chunk->data, chunk->used, func, data);
+		}
+	}
+
+	if (staging)
+	{
+		RBFlushRecords(staging->data, staging->used, func, data);
+	}
+
+	g_free(raw);
 }
 
 
@@ -226,45 +731,109 @@ bool RBFlush(PmLogRingBuffer_t *rb, RBTraversalFunc flushMsgFunc,
 	DbgPrint("%s flush called on rb with bs %d and fl %d\n", __FUNCTION__,
 	         rb->bufferSize, rb->flushLevel);
 
-	if (!rb->buff)
-	{
-		RBAllocBuff(rb);
-	}
-
 	g_assert(RBValid(rb));
 
-	/* have RB, need to flush */
-	char msg[rb->bufferSize];
-	int j = 0;
-	int i = 0;
-	char *n = rb->nextWritePos;
-	int buffSize = rb->bufferSize;
+	RBTraverse(rb->head, rb->staging, rb->compress, flushMsgFunc, data);
+
+	RBClear(rb);
+	return true;
+}
+
+/**
+ * @brief RBCopyChunk
+ *
+ * @param chunk
+ *
+ * @return a copy of the used part of the chunk, outside of the pool
+ */
+static PmLogRBChunk_t *RBCopyChunk(const PmLogRBChunk_t *chunk)
+{
+	PmLogRBChunk_t *copy = g_malloc(sizeof(PmLogRBChunk_t) + chunk->used);
+
+	memcpy(copy, chunk, sizeof(PmLogRBChunk_t) + chunk->used);
+	copy->next = NULL;
+
+	return copy;
+}
+
+/**
+ * @brief RBSnapshot
+ *
+ * Copy the contents of the RB, so they can be read from another thread
+ * while the RB keeps being written.  The copy takes time proportional
+ * to the memory used by the RB; nothing is inflated or parsed.
+ *
+ * @param rb pointer to the RB object
+ *
+ * @return the snapshot, to be freed with RBSnapshotFree
+ */
+PmLogRBSnapshot_t *RBSnapshot(const PmLogRingBuffer_t *rb)
+{
+	PmLogRBSnapshot_t    *snapshot = g_new0(PmLogRBSnapshot_t, 1);
+	const PmLogRBChunk_t *chunk;
+	PmLogRBChunk_t       *tail = NULL;
+	PmLogRBChunk_t       *copy;
+
+	snapshot->compress = rb->compress;
 
-	for (i = 0; i < buffSize; i++)
+	for (chunk = rb->head; chunk != NULL; chunk = chunk->next)
 	{
-		msg[j] = *n;
-		n = RBStep(rb, n);
+		copy = RBCopyChunk(chunk);
 
-		if (msg[j] == '\0')
+		if (tail)
 		{
-			if (j != 0)
-			{
-				flushMsgFunc(msg, data);
-			}
-
-			j = 0;
+			tail->next = copy;
 		}
 		else
 		{
-			j++;
+			snapshot->head = copy;
 		}
 
-		if (n == rb->nextWritePos)
+		tail = copy;
+	}
+
+	if (rb->staging)
+	{
+		snapshot->staging = RBCopyChunk(rb->staging);
+	}
+
+	return snapshot;
+}
+
+/**
+ * @brief RBSnapshotForeach
+ *
+ * Call func on each record of the snapshot, oldest first.
+ *
+ * @param snapshot
+ * @param func
+ * @param data
+ */
+void RBSnapshotForeach(const PmLogRBSnapshot_t *snapshot,
+                       RBTraversalFunc func, gpointer data)
+{
+	RBTraverse(snapshot->head, snapshot->staging, snapshot->compress, func, data);
+}
+
+/**
+ * @brief RBSnapshotFree
+ *
+ * @param snapshot
+ */
+void RBSnapshotFree(PmLogRBSnapshot_t *snapshot)
+{
+	PmLogRBChunk_t *chunk;
+
+	if (snapshot)
+	{
+		while (snapshot->head)
 		{
-			break;
+			chunk = snapshot->head;
+			snapshot->head = chunk->next;
+			g_free(chunk);
 		}
-	}
 
-	RBClear(rb);
-	return true;
+		g_free(snapshot->staging);
+		g_free(snapshot);
+	}
 }
@@ -33,26 +33,90 @@
 #include <stdlib.h>
 #include <glib.h>
 #include <string.h>
+#include "pool.h"
 #include "print.h"
 
+/*
+ * A compressed block holds the deflated contents of one full staging
+ * chunk.  Records never span blocks, so each block can be inflated on
+ * its own.  Blocks are packed into chunks; compLen is 0 if the block
+ * did not compress and is stored raw.
+ */
+typedef struct
+{
+	int rawLen;
+	int compLen;
+}
+PmLogRBBlock_t;
+
+/*
+ * Each record is framed by this header, followed by the program name
+ * and the message, both NUL terminated.  len counts the bytes after
+ * the header.  Records never span chunks or blocks.
+ */
+typedef struct
+{
+	guint16 len;
+	guint16 programLen;
+	gint32  pri;
+
+	/* time the message was logged, microseconds since the epoch */
+	gint64  time;
+}
+PmLogRBRecord_t;
+
 typedef struct
 {
 	bool isEmpty;
+
+	/* maximum and minimum share of the chunk pool, in bytes */
 	int bufferSize;
+	int minSize;
+
 	int flushLevel;
-	char *buff;
-	char *nextWritePos;
+
+	/* chunks of records (or compressed blocks), head is the oldest */
+	PmLogRBChunk_t *head;
+	PmLogRBChunk_t *tail;
+	int numChunks;
+
+	/* compressed mode: records are staged raw until the chunk is full */
+	bool compress;
+	PmLogRBChunk_t *staging;
+
+	/* bytes of records held */
+	int rawBytes;
+
+	/* value of the write sequence at the last write */
+	guint64 lastWrite;
 }
 PmLogRingBuffer_t;
 
 static const int RBMinBufferSize = 2048; /* Minimum is 2K */
 
-typedef void (*RBTraversalFunc)(const char *msg, gpointer data);
+/* longer program names are truncated in RB records */
+#define RB_MAX_PROGRAM_LEN      255
+
+typedef void (*RBTraversalFunc)(gint64 time, int pri, const char *programName,
+                                const char *msg, gpointer data);
 
-PmLogRingBuffer_t *RBNew(int bufferSize, int flushLevel);
+/* a point-in-time copy of the contents of a RB */
+typedef struct _PmLogRBSnapshot PmLogRBSnapshot_t;
+
+PmLogRingBuffer_t *RBNew(int bufferSize, int minSize, int flushLevel,
+                         bool compress);
+void RBFree(PmLogRingBuffer_t *rb);
+void RBResize(PmLogRingBuffer_t *rb, int bufferSize);
 
 bool RBFlush(PmLogRingBuffer_t *rb, RBTraversalFunc flushMsgFunc,
              gpointer data);
-void RBWrite(PmLogRingBuffer_t *rb, const char *buffMsg, int numBytes);
+void RBWrite(PmLogRingBuffer_t *rb, gint64 time, int pri,
+             const char *programName, const char *msg, int msgLen);
+void RBGetUsage(const PmLogRingBuffer_t *rb, int *rawBytesP, int *storedBytesP);
+
+PmLogRBSnapshot_t *RBSnapshot(const PmLogRingBuffer_t *rb);
+void RBSnapshotForeach(const PmLogRBSnapshot_t *snapshot,
+                       RBTraversalFunc func, gpointer data);
+void RBSnapshotFree(PmLogRBSnapshot_t *snapshot);
 
 #endif
@@ -0,0 +1,271 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2007-2014 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+/**
+ *************************************************************************
+ * @file shmring.c
+ *
+ * @brief Daemon side of the shared memory rings.
+ *
+ * The ring lives in a memfd sealed against resizing, so that a client
+ * can't make the daemon fault by truncating it.  Everything read from
+ * the ring is validated: a client corrupting its ring only loses it.
+ *
+ *************************************************************************
+ */
+
+#define _GNU_SOURCE
+
+#include "shmring.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+
+/* how far ahead of ours the clock of a record may be, in seconds */
+#define SHM_RING_MAX_CLOCK_SKEW     (24 * 60 * 60)
+
+struct _PmLogShmRing
+{
+	PmLogShmHeader_t   *header;
+	char               *data;
+	gsize               mapLen;
+
+	/* only kept until handed over to the client */
+	int                 memFd;
+
+	int                 eventFd;
+
+	/* copies of the header, the client may change it */
+	guint32             size;
+	guint32             maxLen;
+};
+
+/**
+ * @brief ShmRingFree
+ *
+ * @param ring
+ */
+void ShmRingFree(PmLogShmRing_t *ring)
+{
+	if (ring->header)
+	{
+		(void) munmap(ring->header, ring->mapLen);
+	}
+
+	ShmRingCloseMemFd(ring);
+
+	if (ring->eventFd >= 0)
+	{
+		close(ring->eventFd);
+	}
+
+	g_free(ring);
+}
+
+/**
+ * @brief ShmRingNew
+ *
+ * @param size bytes of the ring, a power of 2
+ * @param maxLen longest message
+ *
+ * @return the ring, NULL on failure
+ */
+PmLogShmRing_t *ShmRingNew(guint32 size, guint32 maxLen)
+{
+	PmLogShmRing_t *ring = g_new0(PmLogShmRing_t, 1);
+	void           *map;
+
+	g_assert((size & (size - 1)) == 0);
+
+	ring->size = size;
+	ring->maxLen = maxLen;
+	ring->mapLen = sizeof(PmLogShmHeader_t) + size;
+	ring->memFd = memfd_create("pmlogd-shm", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	ring->eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	if ((ring->memFd < 0) || (ring->eventFd < 0))
+	{
+		ErrPrint("%s: failed to create descriptors: %s\n", __FUNCTION__,
+		         strerror(errno));
+		ShmRingFree(ring);
+		return NULL;
+	}
+
+	if ((ftruncate(ring->memFd, (off_t) ring->mapLen) != 0) ||
+	        (fcntl(ring->memFd, F_ADD_SEALS,
+	               F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0))
+	{
+		ErrPrint("%s: failed to size memfd: %s\n", __FUNCTION__, strerror(errno));
+		ShmRingFree(ring);
+		return NULL;
+	}
+
+	map = mmap(NULL, ring->mapLen, PROT_READ | PROT_WRITE, MAP_SHARED,
+	           ring->memFd, 0);
+
+	if (map == MAP_FAILED)
+	{
+		ErrPrint("%s: mmap error: %s\n", __FUNCTION__, strerror(errno));
+		ShmRingFree(ring);
+		return NULL;
+	}
+
+	ring->header = map;
+	ring->data = (char *) map + sizeof(PmLogShmHeader_t);
+
+	ring->header->magic = PMLOG_SHM_MAGIC;
+	ring->header->version = PMLOG_SHM_VERSION;
+	ring->header->size = size;
+	ring->header->watermark = size / 4;
+	ring->header->maxLen = maxLen;
+
+	return ring;
+}
+
+/**
+ * @brief ShmRingMemFd
+ *
+ * @param ring
+ *
+ * @return the memfd to hand over to the client
+ */
+int ShmRingMemFd(const PmLogShmRing_t *ring)
+{
+	return ring->memFd;
+}
+
+/**
+ * @brief ShmRingEventFd
+ *
+ * @param ring
+ *
+ * @return the eventfd written by the client at the watermark
+ */
+int ShmRingEventFd(const PmLogShmRing_t *ring)
+{
+	return ring->eventFd;
+}
+
+/**
+ * @brief ShmRingUsed
+ *
+ * @param ring
+ *
+ * @return bytes written by the client and not drained yet
+ */
+guint32 ShmRingUsed(const PmLogShmRing_t *ring)
+{
+	guint32 used = (guint32)(g_atomic_int_get(&ring->header->head) -
+	                         g_atomic_int_get(&ring->header->tail));
+
+	/* the client may have written anything */
+	return MIN(used, ring->size);
+}
+
+/**
+ * @brief ShmRingCloseMemFd
+ *
+ * Close the memfd once handed over, the mapping stays.
+ *
+ * @param ring
+ */
+void ShmRingCloseMemFd(PmLogShmRing_t *ring)
+{
+	if (ring->memFd >= 0)
+	{
+		close(ring->memFd);
+		ring->memFd = -1;
+	}
+}
+
+/**
+ * @brief ShmRingDrain
+ *
+ * Pass the records written by the client to func, oldest first.
+ *
+ * @param ring
+ * @param func
+ * @param data
+ *
+ * @return number of records read, -1 if the ring is corrupt
+ */
+int ShmRingDrain(PmLogShmRing_t *ring, ShmRingRecordFunc func, gpointer data)
+{
+	const PmLogShmRecord_t *rec;
+	PmLogShmRecord_t        hdr;
+	struct timeval          time;
+	gint64                  maxSec = (gint64) g_get_real_time() / G_USEC_PER_SEC +
+	                                 SHM_RING_MAX_CLOCK_SKEW;
+	guint32                 head = (guint32) g_atomic_int_get(&ring->header->head);
+	guint32                 tail = (guint32) g_atomic_int_get(&ring->header->tail);
+	guint32                 off;
+	guint32                 len;
+	gsize                   need;
+	int                     count = 0;
+	bool                    more = true;
+
+	while (more && (tail != head))
+	{
+		off = tail & (ring->size - 1);
+
+		if (((guint32)(head - tail) > ring->size) || (off % PMLOG_SHM_ALIGN))
+		{
+			return -1;
+		}
+
+		rec = (const PmLogShmRecord_t *)(ring->data + off);
+
+		/* read once, the client may be rewriting it: only the copy is
+		 * checked and used */
+		hdr.len = __atomic_load_n(&rec->len, __ATOMIC_ACQUIRE);
+		hdr.usec = __atomic_load_n(&rec->usec, __ATOMIC_RELAXED);
+		hdr.sec = __atomic_load_n(&rec->sec, __ATOMIC_RELAXED);
+		len = hdr.len;
+
+		if (len == PMLOG_SHM_PAD)
+		{
+			tail += ring->size - off;
+			continue;
+		}
+
+		need = PMLOG_SHM_RECORD_SIZE(len);
+
+		if ((len > ring->maxLen) || (off + need > ring->size) ||
+		        (need > (guint32)(head - tail)) ||
+		        (hdr.sec < 0) || (hdr.sec > maxSec) || (hdr.usec >= 1000000))
+		{
+			return -1;
+		}
+
+		time.tv_sec = (time_t) hdr.sec;
+		time.tv_usec = (suseconds_t) hdr.usec;
+
+		more = func((const char *)(rec + 1), len, &time, data);
+		tail += (guint32) need;
+		count++;
+	}
+
+	g_atomic_int_set(&ring->header->tail, (gint) tail);
+
+	return count;
+}
@@ -0,0 +1,119 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2007-2014 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+/**
+ ***********************************************************************
+ * @file shmring.h
+ *
+ * @brief This file contains definition of the shared memory rings
+ * clients may log through instead of the /dev/log socket.
+ *
+ * A client connects to PMLOG_SHM_SOCKET_PATH (SOCK_SEQPACKET) and
+ * receives one message carrying, as SCM_RIGHTS, a sealed memfd holding
+ * a PmLogShmHeader_t followed by the ring, and an eventfd.  The ring is
+ * released when the client closes the connection.
+ *
+ * The client is the only producer:
+ *  - used = head - tail, need = PMLOG_SHM_RECORD_SIZE(len)
+ *  - a record doesn't wrap: if fewer than need bytes are left before
+ *    the end of the ring, a record of len PMLOG_SHM_PAD fills them
+ *  - if the message is longer than maxLen or doesn't fit, it is sent to
+ *    the socket instead
+ *  - the record is written at head modulo size, then head is advanced
+ *  - if used was below watermark and now reaches it, the eventfd is
+ *    written; else the daemon will find the record on its next sweep
+ *
+ ***********************************************************************
+ */
+
+
+#ifndef PMLOGDAEMON_SHMRING_H
+#define PMLOGDAEMON_SHMRING_H
+
+#include <stdbool.h>
+#include <sys/time.h>
+#include <glib.h>
+#include "print.h"
+
+#define PMLOG_SHM_SOCKET_PATH   "/var/run/pmlogd-shm"
+
+#define PMLOG_SHM_MAGIC         0x524c4d50      /* "PMLR" */
+#define PMLOG_SHM_VERSION       1
+
+/* records are aligned on it */
+#define PMLOG_SHM_ALIGN         16
+
+/* len of a record telling to skip to the start of the ring */
+#define PMLOG_SHM_PAD           0xffffffffu
+
+#define PMLOG_SHM_RECORD_SIZE(len) \
+	((sizeof(PmLogShmRecord_t) + (len) + PMLOG_SHM_ALIGN - 1) & \
+	 ~((gsize) PMLOG_SHM_ALIGN - 1))
+
+typedef struct
+{
+	guint32 magic;
+	guint32 version;
+
+	/* bytes of the ring following the header, a power of 2 */
+	guint32 size;
+
+	/* bytes used from which the daemon is woken up */
+	guint32 watermark;
+
+	/* longest message */
+	guint32 maxLen;
+
+	/* free-running byte counters: head is only written by the client,
+	 * tail by the daemon */
+	volatile gint head __attribute__((aligned(64)));
+	volatile gint tail __attribute__((aligned(64)));
+}
+__attribute__((aligned(64))) PmLogShmHeader_t;
+
+/*
+ * Each record is followed by the message as it would be sent to the
+ * socket, not NUL terminated.
+ */
+typedef struct
+{
+	/* bytes of the message, or PMLOG_SHM_PAD */
+	guint32 len;
+	guint32 usec;
+
+	/* time the message was logged, usec below 1000000; a ring with a
+	 * negative or far future time is dropped as corrupt */
+	gint64  sec;
+}
+PmLogShmRecord_t;
+
+typedef struct _PmLogShmRing PmLogShmRing_t;
+
+/* return false to stop draining */
+typedef bool (*ShmRingRecordFunc)(const char *msg, size_t len,
+                                  const struct timeval *time, gpointer data);
+
+PmLogShmRing_t *ShmRingNew(guint32 size, guint32 maxLen);
+int ShmRingMemFd(const PmLogShmRing_t *ring);
+int ShmRingEventFd(const PmLogShmRing_t *ring);
+guint32 ShmRingUsed(const PmLogShmRing_t *ring);
+void ShmRingCloseMemFd(PmLogShmRing_t *ring);
+int ShmRingDrain(PmLogShmRing_t *ring, ShmRingRecordFunc func, gpointer data);
+void ShmRingFree(PmLogShmRing_t *ring);
+
+#endif
@@ -0,0 +1,196 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2007-2014 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+/**
+ *************************************************************************
+ * @file sockfilter.c
+ *
+ * @brief Generation of the classic BPF program of the socket filter.
+ *
+ * Classic BPF has no loops and only jumps forward, by 255 instructions
+ * at most, so the priority digits and the search for "!log" are
+ * unrolled, each step ending where it can return.  A load past the end
+ * of the message would drop it, so the length is checked first.
+ *
+ *************************************************************************
+ */
+
+#include "sockfilter.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/syslog.h>
+#include <linux/filter.h>
+#include <glib.h>
+#include "print.h"
+
+#define SOCK_FILTER_ACCEPT      0xffffffff
+#define SOCK_FILTER_DROP        0
+
+/* "!log" loaded as a word, in network order */
+#define SOCK_FILTER_COMMAND     (('!' << 24) | ('l' << 16) | ('o' << 8) | 'g')
+
+/* "<", up to 3 digits and ">" */
+#define SOCK_FILTER_MIN_LEN     5
+
+/**
+ * @brief SockFilterAdd
+ *
+ * @param prog
+ * @param code
+ * @param k
+ * @param jt
+ * @param jf
+ *
+ * @return index of the instruction
+ */
+static guint SockFilterAdd(GArray *prog, guint16 code, guint32 k, guint8 jt, guint8 jf)
+{
+	struct sock_filter insn = { code, jt, jf, k };
+
+	g_array_append_val(prog, insn);
+
+	return prog->len - 1;
+}
+
+/**
+ * @brief SockFilterBuild
+ *
+ * @param prog to append to
+ * @param maxLevel least severe level accepted, -1 for none
+ */
+static void SockFilterBuild(GArray *prog, int maxLevel)
+{
+	guint   gotPri[ 2 ];
+	guint   i;
+	int     p;
+
+	/* too short to hold a priority */
+	SockFilterAdd(prog, BPF_LD | BPF_W | BPF_LEN, 0, 0, 0);
+	SockFilterAdd(prog, BPF_JMP | BPF_JGE | BPF_K, SOCK_FILTER_MIN_LEN, 1, 0);
+	SockFilterAdd(prog, BPF_RET | BPF_K, SOCK_FILTER_ACCEPT, 0, 0);
+
+	SockFilterAdd(prog, BPF_LD | BPF_B | BPF_ABS, 0, 0, 0);
+	SockFilterAdd(prog, BPF_JMP | BPF_JEQ | BPF_K, '<', 1, 0);
+	SockFilterAdd(prog, BPF_RET | BPF_K, SOCK_FILTER_ACCEPT, 0, 0);
+
+	/* M[0] = pri, a digit at a time */
+	SockFilterAdd(prog, BPF_LD | BPF_IMM, 0, 0, 0);
+	SockFilterAdd(prog, BPF_ST, 0, 0, 0);
+
+	for (p = 1; p <= 3; p++)
+	{
+		SockFilterAdd(prog, BPF_LD | BPF_B | BPF_ABS, (guint32) p, 0, 0);
+
+		if (p > 1)
+		{
+			gotPri[ p - 2 ] = SockFilterAdd(prog, BPF_JMP | BPF_JEQ | BPF_K, '>', 0, 0);
+		}
+
+		/* below '0' wraps around */
+		SockFilterAdd(prog, BPF_ALU | BPF_SUB | BPF_K, '0', 0, 0);
+		SockFilterAdd(prog, BPF_JMP | BPF_JGT | BPF_K, 9, 0, 1);
+		SockFilterAdd(prog, BPF_RET | BPF_K, SOCK_FILTER_ACCEPT, 0, 0);
+		SockFilterAdd(prog, BPF_MISC | BPF_TAX, 0, 0, 0);
+		SockFilterAdd(prog, BPF_LD | BPF_MEM, 0, 0, 0);
+		SockFilterAdd(prog, BPF_ALU | BPF_MUL | BPF_K, 10, 0, 0);
+		SockFilterAdd(prog, BPF_ALU | BPF_ADD | BPF_X, 0, 0, 0);
+		SockFilterAdd(prog, BPF_ST, 0, 0, 0);
+	}
+
+	SockFilterAdd(prog, BPF_LD | BPF_B | BPF_ABS, 4, 0, 0);
+	SockFilterAdd(prog, BPF_JMP | BPF_JEQ | BPF_K, '>', 1, 0);
+	SockFilterAdd(prog, BPF_RET | BPF_K, SOCK_FILTER_ACCEPT, 0, 0);
+
+	/* the level, accepted unless less severe than maxLevel */
+	for (p = 0; p < 2; p++)
+	{
+		g_array_index(prog, struct sock_filter, gotPri[ p ]).jt =
+		    (guint8)(prog->len - gotPri[ p ] - 1);
+	}
+
+	SockFilterAdd(prog, BPF_LD | BPF_MEM, 0, 0, 0);
+	SockFilterAdd(prog, BPF_ALU | BPF_AND | BPF_K, LOG_PRIMASK, 0, 0);
+	SockFilterAdd(prog, BPF_JMP | BPF_JGE | BPF_K, (guint32)(maxLevel + 1), 1, 0);
+	SockFilterAdd(prog, BPF_RET | BPF_K, SOCK_FILTER_ACCEPT, 0, 0);
+
+	/* unwanted, unless it is a command */
+	SockFilterAdd(prog, BPF_LDX | BPF_W | BPF_LEN, 0, 0, 0);
+
+	for (i = 1; i + 4 <= SOCK_FILTER_SCAN_LEN; i++)
+	{
+		SockFilterAdd(prog, BPF_MISC | BPF_TXA, 0, 0, 0);
+		SockFilterAdd(prog, BPF_JMP | BPF_JGE | BPF_K, i + 4, 1, 0);
+		SockFilterAdd(prog, BPF_RET | BPF_K, SOCK_FILTER_DROP, 0, 0);
+		SockFilterAdd(prog, BPF_LD | BPF_W | BPF_ABS, i, 0, 0);
+		SockFilterAdd(prog, BPF_JMP | BPF_JEQ | BPF_K, SOCK_FILTER_COMMAND, 0, 1);
+		SockFilterAdd(prog, BPF_RET | BPF_K, SOCK_FILTER_ACCEPT, 0, 0);
+	}
+
+	SockFilterAdd(prog, BPF_RET | BPF_K, SOCK_FILTER_DROP, 0, 0);
+}
+
+/**
+ * @brief SockFilterSet
+ *
+ * Attach to the socket a filter dropping the messages less severe than
+ * maxLevel, replacing any previous one.
+ *
+ * @param fd datagram socket
+ * @param maxLevel least severe level accepted, -1 for none
+ *
+ * @return number of instructions of the filter, 0 if none is needed,
+ * -1 on failure
+ */
+int SockFilterSet(int fd, int maxLevel)
+{
+	struct sock_fprog   fprog;
+	GArray             *prog;
+	int                 len;
+	int                 unused = 0;
+
+	if (maxLevel >= LOG_DEBUG)
+	{
+		if ((setsockopt(fd, SOL_SOCKET, SO_DETACH_FILTER, &unused, sizeof(unused)) != 0) &&
+		        (errno != ENOENT))
+		{
+			ErrPrint("%s: detach error: %s\n", __FUNCTION__, strerror(errno));
+			return -1;
+		}
+
+		return 0;
+	}
+
+	prog = g_array_new(FALSE, FALSE, sizeof(struct sock_filter));
+	SockFilterBuild(prog, MAX(maxLevel, -1));
+
+	fprog.len = (unsigned short) prog->len;
+	fprog.filter = (struct sock_filter *) prog->data;
+	len = (int) prog->len;
+
+	if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog)) != 0)
+	{
+		ErrPrint("%s: attach error: %s\n", __FUNCTION__, strerror(errno));
+		len = -1;
+	}
+
+	g_array_free(prog, TRUE);
+
+	return len;
+}
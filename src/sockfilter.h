@@ -0,0 +1,43 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2007-2014 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+/**
+ ***********************************************************************
+ * @file sockfilter.h
+ *
+ * @brief This file contains definition of the socket filter dropping in
+ * the kernel the messages of /dev/log no context would log.
+ *
+ * The filter reads the "<pri>" prefix of text messages: those of a
+ * level less severe than the given one are dropped, unless "!log"
+ * appears in their first SOCK_FILTER_SCAN_LEN bytes, as log commands
+ * are run whatever their level.  Other messages are all accepted.
+ *
+ ***********************************************************************
+ */
+
+
+#ifndef PMLOGDAEMON_SOCKFILTER_H
+#define PMLOGDAEMON_SOCKFILTER_H
+
+/* bytes searched for a log command */
+#define SOCK_FILTER_SCAN_LEN    128
+
+int SockFilterSet(int fd, int maxLevel);
+
+#endif
@@ -48,16 +48,39 @@ LockFile;
 static LockFile g_processLock;
 
 
+/**
+ * @brief LockFileCurrent
+ *
+ * @param fd
+ * @param path
+ *
+ * @return true if fd is still the file at path
+ */
+static bool LockFileCurrent(int fd, const char *path)
+{
+	struct stat fdStat;
+	struct stat pathStat;
+
+	if ((fstat(fd, &fdStat) != 0) || (stat(path, &pathStat) != 0))
+	{
+		return false;
+	}
+
+	return (fdStat.st_dev == pathStat.st_dev) && (fdStat.st_ino == pathStat.st_ino);
+}
+
+
 /**
  * @brief LockProcess
  *
  * Acquire the process lock (by getting an file lock on our pid file).
  *
  * @param component
+ * @param wait true to wait for the process holding it to exit
  *
  * @return true on success, false if failed.
  */
-bool LockProcess(const char *component)
+bool LockProcess(const char *component, bool wait)
 {
 	const char *locksDirPath = WEBOS_INSTALL_LOCALSTATEDIR "/run";
 
@@ -78,6 +101,7 @@ bool LockProcess(const char *component)
 	snprintf(lock->path, sizeof(lock->path), "%s/%s.pid", locksDirPath,
 	         component);
 
+retry:
 	/* open or create the lock file */
 	fd = open(lock->path, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
 
@@ -90,7 +114,18 @@ bool LockProcess(const char *component)
 	}
 
 	/* use a POSIX advisory file lock as a mutex */
-	result = lockf(fd, F_TLOCK, 0);
+	do
+	{
+		result = lockf(fd, wait ? F_LOCK : F_TLOCK, 0);
+	}
+	while (wait && (result < 0) && (errno == EINTR));
+
+	/* the process we waited for removes the file as it exits */
+	if (wait && (result == 0) && !LockFileCurrent(fd, lock->path))
+	{
+		close(fd);
+		goto retry;
+	}
 
 	if (result < 0)
 	{